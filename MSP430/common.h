@@ -19,16 +19,25 @@
 #define BCD_LEN  1
 #define BCD_DEC  2
 
+//Digits are packed two per byte, first digit in the high nibble
+#define BCD_BYTES(x) (((x)+1)>>1)
+
 #define STACK_SIZE 10
 
-#define MATH_CELL_SIZE 260
-#define MATH_ENTRY_SIZE 37
+#define MATH_CELL_SIZE 132
+#define MATH_MAX_DIGITS 255
+#define MATH_ENTRY_SIZE 20
 #define MATH_LOG_TABLE 114
 #define MATH_TRIG_TABLE 113
 
+//Run CORDIC over half of the tables and finish with one linear step
+#define CORDIC_TAIL
+#define CORDIC_TAIL_EXTRA 2
+
 #define K "0.60725293500888125616944675250493"
 #define log10_factor  "2.30258509299404568401799145468437"
 #define pi            "3.1415926535897932384626433832795"
+#define two_pi        "6.283185307179586476925286766559006"
 #define pi2           "1.57079632679489661923132169163975"
 #define rad_factor    "0.01745329251994329576923690768489"
 #define deg_factor    "57.29577951308232087679815481410522"
@@ -41,7 +50,26 @@ enum SlaveCommands {SlaveRAM_Read,SlaveRAM_Write,SlaveSync,SlaveAnswer,SlaveMake
                     SlaveAdd,SlaveSubtract,SlaveBuffer,SlaveMultiply,SlaveDivide,SlaveShrink,
                     SlaveFullShrink,SlavePad,SlaveIsZero,SlaveCopy,SlaveLn,SlaveExp,SlaveRol,
                     SlaveRor,SlavePow,SlaveTan,SlaveAcos,SlaveAsin,SlaveAtan,SlaveCalcTan,
-                    SlaveCompVar,SlaveTrigPrep,SlaveSettings,SlaveSetDecPlaces};
+                    SlaveCompVar,SlaveTrigPrep,SlaveSettings,SlaveSetDecPlaces,SlaveSqrt,
+                    SlaveRAM_ReadBlock,SlaveRAM_WriteBlock,SlaveRAM_Copy};
+
+//Position of the first non-zero digit of each entry in the tables MakeTables builds.
+//The master uses these to find where the tables run out at the current precision
+//without reading the entries back from the slave.
+static const unsigned char log_lead[MATH_LOG_TABLE]={
+   0, 0, 0, 0, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5, 5, 5,
+   5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 8, 9, 9, 9,10,10,10,11,11,11,
+  11,12,12,12,13,13,13,14,14,14,14,15,15,15,16,16,16,17,17,17,
+  17,18,18,18,19,19,19,20,20,20,20,21,21,21,22,22,22,23,23,23,
+  23,24,24,24,25,25,25,26,26,26,26,27,27,27,28,28,28,29,29,29,
+  29,30,30,30,31,31,31,32,32,32,32,33,33,33};
+static const unsigned char trig_lead[MATH_TRIG_TABLE]={
+   0, 0, 0, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5, 5, 5, 5,
+   6, 6, 6, 7, 7, 7, 8, 8, 8, 8, 9, 9, 9,10,10,10,11,11,11,11,
+  12,12,12,13,13,13,14,14,14,14,15,15,15,16,16,16,17,17,17,18,
+  18,18,18,19,19,19,20,20,20,21,21,21,21,22,22,22,23,23,23,24,
+  24,24,24,25,25,25,26,26,26,27,27,27,27,28,28,28,29,29,29,30,
+  30,30,30,31,31,31,32,32,32,33,33,33,33};
 
 struct SettingsType
 {
@@ -72,6 +72,9 @@ static unsigned char GetKey();
 
 static unsigned char RAM_Read(const unsigned char *a1);
 static void RAM_Write(const unsigned char *a1, const unsigned char byte);
+static void RAM_ReadBlock(unsigned char *dest, const unsigned char *a1, unsigned int count);
+static void RAM_WriteBlock(unsigned char *a1, const unsigned char *src, unsigned int count);
+static void RAM_Copy(unsigned char *dest, const unsigned char *src, unsigned int count);
 
 static void AddBCD(unsigned char *result, const unsigned char *n1, const unsigned char *n2);
 static void SubBCD(unsigned char *result, const unsigned char *n1, unsigned char *n2);
@@ -84,12 +87,16 @@ static void ShrinkBCD(unsigned char *dest,unsigned char *src);
 static void FullShrinkBCD(unsigned char *n1);
 static void PadBCD(unsigned char *n1, int amount);
 static bool IsZero(unsigned char *n1);
+static unsigned char GetDigit(const unsigned char *n1, int digit);
+static void SetDigit(unsigned char *n1, int digit, unsigned char value);
+static unsigned char CellDigit(const unsigned char *n1, int digit);
 static void CopyBCD(unsigned char *dest, unsigned char *src);
 static bool LnBCD(unsigned char *result, unsigned char *arg);
 static void ExpBCD(unsigned char *result, unsigned char *arg);
 static void RolBCD(unsigned char *result, unsigned char *arg, unsigned int amount);
 static void RorBCD(unsigned char *result, unsigned char *arg, unsigned int amount);
-static void PowBCD(unsigned char *result, unsigned char *base, unsigned char *exp);
+static bool PowBCD(unsigned char *result, unsigned char *base, unsigned char *exp);
+static void SqrtBCD(unsigned char *result, unsigned char *arg);
 static void TanBCD(unsigned char *sine_result,unsigned char *cos_result,unsigned char *arg);
 static void AcosBCD(unsigned char *result,unsigned char *arg);
 static void AsinBCD(unsigned char *result,unsigned char *arg);
@@ -112,32 +119,40 @@ static void TestRAM();
 
 #pragma MM_OFFSET 0
 #pragma MM_GLOBALS
-  unsigned char p0[260]; //PowBCD, LnBCD, ExpBCD, TanBCD, AtanBCD, typing,    CompBCD
-  unsigned char p1[260]; //PowBCD, LnBCD, ExpBCD, TanBCD, AtanBCD, DrawStack, CompBCD, CompVarBCD
-  unsigned char p2[260]; //PowBCD, LnBCD, ExpBCD, TanBCD, AtanBCD
-  unsigned char p3[260]; //PowBCD
-  unsigned char p4[260]; //PowBCD
-  unsigned char p5[260];
-  unsigned char p6[260];
-  unsigned char p7[260];
-  unsigned char buffer[260]; //AddBCD
-  unsigned char perm_buff1[260]; //DivBCD, MultBCD
-  unsigned char perm_buff2[260]; //DivBCD
-  unsigned char perm_buff3[260]; //DivBCD
+  unsigned char p0[132]; //PowBCD, LnBCD, ExpBCD, TanBCD, AtanBCD, typing,    CompBCD
+  unsigned char p1[132]; //PowBCD, LnBCD, ExpBCD, TanBCD, AtanBCD
+  unsigned char p2[132]; //PowBCD, LnBCD, ExpBCD, TanBCD, AtanBCD
+  unsigned char p3[132]; //PowBCD
+  unsigned char p4[132]; //PowBCD
+  unsigned char p5[132];
+  unsigned char p6[132];
+  unsigned char p7[132];
+  unsigned char buffer[132]; //AddBCD
+  unsigned char perm_buff1[132]; //DivBCD, MultBCD
+  unsigned char perm_buff2[132]; //DivBCD
+  unsigned char perm_buff3[132]; //DivBCD
   //unsigned char logs[MATH_LOG_TABLE*MATH_ENTRY_SIZE];
-  unsigned char logs[4218];
+  unsigned char logs[2280];
   //unsigned char trig[MATH_TRIG_TABLE*MATH_ENTRY_SIZE];
-  unsigned char trig[4218];
+  unsigned char trig[2260];
   unsigned char perm_zero[4];
-  unsigned char perm_K[36];
-  unsigned char perm_log10[36];
+  unsigned char perm_K[20];
+  unsigned char perm_log10[20];
+  unsigned char perm_one[4];
+  unsigned char perm_ten[4];
+  unsigned char perm_90[4];
+  unsigned char perm_180[5];
+  unsigned char perm_360[5];
+  unsigned char perm_deg[20];
+  unsigned char perm_2pi[20];
   unsigned char BCD_stack[52000];
-  unsigned char stack_buffer[260];
+  unsigned char stack_buffer[132];
 #pragma MM_END
 
 struct SettingsType Settings;
 unsigned int stack_ptr[2];
 unsigned int which_stack;
+unsigned char cell_buff[MATH_CELL_SIZE]; //local copy of a cell for DrawStack, DrawInput, input
 
 int main(void)
 {
@@ -172,7 +187,7 @@ int main(void)
   int key,i=0,j=0,k=0,x=0,y=0;
   bool shift=false, clear_shift=false, redraw=true, input=false;
   bool menu=false, redraw_input=false, do_input=false;
-  int input_ptr=0, input_offset=0;
+  int input_ptr=0, input_offset=0, input_len=0;
   int process_output=0;
   static const char StartInput[]="0123456789.";
 
@@ -224,6 +239,7 @@ int main(void)
           DrawStack(menu,input,stack_ptr[which_stack]);
           input_offset=0;
           input_ptr=1;
+          input_len=1;
           p0[0]=key;
           p0[1]=0;
           redraw_input=true;
@@ -232,12 +248,11 @@ int main(void)
       }
       else
       {
-        if (input_ptr<255)
+        if (input_ptr<(MATH_CELL_SIZE-2))
         {
-          k=0;
-          for (j=input_ptr;p0[j];j++) k++;
-          for (j=k;j>=0;j--) p0[input_ptr+j+1]=p0[input_ptr+j];
+          RAM_Copy(p0+input_ptr+1,p0+input_ptr,input_len-input_ptr+1);
           p0[input_ptr++]=key;
+          input_len++;
 
           if (input_ptr-input_offset==(SCREEN_WIDTH-1))
           {
@@ -267,22 +282,17 @@ int main(void)
               if (input_ptr-input_offset==0) input_offset-=2;
               else if (input_ptr-input_offset<2) input_offset--;
               if (input_offset<0) input_offset=0;
-              j=input_ptr;
-              while (p0[j])
-              {
-                p0[j]=p0[j+1];
-                j++;
-              }
+              RAM_Copy(p0+input_ptr,p0+input_ptr+1,input_len-input_ptr);
+              input_len--;
               redraw_input=true;
             }
             key=0;
             break;
           case KEY_DELETE:
-            j=input_ptr;
-            while (p0[j])
+            if (input_ptr<input_len)
             {
-              p0[j]=p0[j+1];
-              j++;
+              RAM_Copy(p0+input_ptr,p0+input_ptr+1,input_len-input_ptr);
+              input_len--;
             }
             redraw_input=true;
             key=0;
@@ -328,6 +338,7 @@ int main(void)
           case 'z':
             input_ptr=0;
             input_offset=0;
+            input_len=0;
             p0[0]=0;
             redraw_input=true;
             key=0;
@@ -348,9 +359,10 @@ int main(void)
       if (do_input)
       {
         x=0;
-        for (j=0;p0[j];j++)
+        RAM_ReadBlock(cell_buff,p0,input_len);
+        for (j=0;j<input_len;j++)
         {
-          if (p0[j]=='.') x++;
+          if (cell_buff[j]=='.') x++;
           if (x==2) break;
         }
         if (x==2)
@@ -358,7 +370,7 @@ int main(void)
           ErrorMsg("Invalid input");
           redraw_input=true;
         }
-        else if (p0[0]==0)
+        else if (input_len==0)
         {
           SetBlink(false);
           input=false;
@@ -453,8 +465,16 @@ int main(void)
         case '*':
           if (stack_ptr[which_stack]>=2)
           {
-            MultBCD(stack_buffer,BCD_stack+(stack_ptr[which_stack]-2)*MATH_CELL_SIZE,BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE);
-            process_output=2;
+            //The product has to fit in one cell
+            if (BCD_stack[(stack_ptr[which_stack]-2)*MATH_CELL_SIZE+BCD_LEN]+BCD_stack[(stack_ptr[which_stack]-1)*MATH_CELL_SIZE+BCD_LEN]+1>MATH_MAX_DIGITS)
+            {
+              ErrorMsg("Argument\ntoo large");
+            }
+            else
+            {
+              MultBCD(stack_buffer,BCD_stack+(stack_ptr[which_stack]-2)*MATH_CELL_SIZE,BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE);
+              process_output=2;
+            }
             redraw=true;
           }
           break;
@@ -502,10 +522,7 @@ int main(void)
           if (stack_ptr[which_stack]>=2)
           {
             CopyBCD(stack_buffer,BCD_stack);
-            for (i=0;i<(stack_ptr[which_stack]-1);i++)
-            {
-              CopyBCD(BCD_stack+i*MATH_CELL_SIZE,BCD_stack+(i+1)*MATH_CELL_SIZE);
-            }
+            RAM_Copy(BCD_stack,BCD_stack+MATH_CELL_SIZE,(stack_ptr[which_stack]-1)*MATH_CELL_SIZE);
             CopyBCD(BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE,stack_buffer);
             redraw=true;
           }
@@ -514,10 +531,7 @@ int main(void)
           if (stack_ptr[which_stack]>=2)
           {
             CopyBCD(stack_buffer,BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE);
-            for (i=(stack_ptr[which_stack]-1);i>0;i--)
-            {
-              CopyBCD(BCD_stack+(i)*MATH_CELL_SIZE,BCD_stack+(i-1)*MATH_CELL_SIZE);
-            }
+            RAM_Copy(BCD_stack+MATH_CELL_SIZE,BCD_stack,(stack_ptr[which_stack]-1)*MATH_CELL_SIZE);
             CopyBCD(BCD_stack,stack_buffer);
             redraw=true;
           }
@@ -567,7 +581,7 @@ int main(void)
             {
               BCD_stack[(stack_ptr[which_stack]-1)*MATH_CELL_SIZE+BCD_SIGN]=0;
               TrigPrep(stack_ptr[which_stack],&j);
-              if (IsZero(p3)) ImmedBCD("1",stack_buffer);
+              if (IsZero(p3)) CopyBCD(stack_buffer,perm_one);
               else TanBCD(p4,stack_buffer,p3);
               if (j==1) stack_buffer[BCD_SIGN]=1;
               process_output=1;
@@ -579,12 +593,12 @@ int main(void)
             if (stack_ptr[which_stack]>=1)
             {
               process_output=1;
-              i=CompBCD("0",BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE);
-              j=CompBCD("1",BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE);
+              i=CompVarBCD(perm_zero,BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE);
+              j=CompVarBCD(perm_one,BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE);
               k=CompBCD("-1",BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE);
-              if (i==COMP_EQ) ImmedBCD("90",stack_buffer);
-              else if (j==COMP_EQ) ImmedBCD("0",stack_buffer);
-              else if (k==COMP_EQ) ImmedBCD("180",stack_buffer);
+              if (i==COMP_EQ) CopyBCD(stack_buffer,perm_90);
+              else if (j==COMP_EQ) CopyBCD(stack_buffer,perm_zero);
+              else if (k==COMP_EQ) CopyBCD(stack_buffer,perm_180);
               else if ((j==COMP_LT)||(k==COMP_GT))
               {
                 ErrorMsg("Invalid input");
@@ -619,7 +633,7 @@ int main(void)
               x=0;
               j=CompVarBCD(perm_zero,BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE);
 
-              if (j==COMP_EQ) ImmedBCD("1",stack_buffer);
+              if (j==COMP_EQ) CopyBCD(stack_buffer,perm_one);
               else
               {
                 if (j==COMP_GT) j=1;
@@ -637,14 +651,20 @@ int main(void)
                   }
                   else
                   {
-                    i=BCD_stack[(stack_ptr[which_stack]-1)*MATH_CELL_SIZE+3]*100;
-                    i+=BCD_stack[(stack_ptr[which_stack]-1)*MATH_CELL_SIZE+4]*10;
-                    i+=BCD_stack[(stack_ptr[which_stack]-1)*MATH_CELL_SIZE+5];
+                    i=GetDigit(BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE,0)*100;
+                    i+=GetDigit(BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE,1)*10;
+                    i+=GetDigit(BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE,2);
                     if (BCD_stack[(stack_ptr[which_stack]-1)*MATH_CELL_SIZE+BCD_DEC]==2) i/=10;
                     else if (BCD_stack[(stack_ptr[which_stack]-1)*MATH_CELL_SIZE+BCD_DEC]==1) i/=100;
                   }
 
-                  if (i>254)
+                  //A negative power too large to hold is too small to show
+                  if ((i>254)&&(j))
+                  {
+                    CopyBCD(stack_buffer,perm_zero);
+                    j=0;
+                  }
+                  else if (i>254)
                   {
                     ErrorMsg("Invalid input");
                     BCD_stack[(stack_ptr[which_stack]-1)*MATH_CELL_SIZE+BCD_SIGN]=j;
@@ -655,18 +675,31 @@ int main(void)
                     stack_buffer[BCD_SIGN]=0;
                     stack_buffer[BCD_DEC]=i+1;
                     stack_buffer[BCD_LEN]=i+1;
-                    stack_buffer[3]=1;
-                    for (k=0;k<i;k++)
+                    stack_buffer[3]=0x10;
+                    for (k=1;k<BCD_BYTES(i+1);k++)
                     {
-                      stack_buffer[k+4]=0;
+                      stack_buffer[k+3]=0;
                     }
                   }
                 }
                 else
                 {
-                  ImmedBCD("10",p5);
-                  PowBCD(stack_buffer,p5,BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE);
-                  if (stack_buffer[BCD_DEC]>(Settings.DecPlaces)) stack_buffer[BCD_LEN]=stack_buffer[BCD_DEC];
+                  CopyBCD(p5,perm_ten);
+                  if (!PowBCD(stack_buffer,p5,BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE))
+                  {
+                    if (j)
+                    {
+                      CopyBCD(stack_buffer,perm_zero);
+                      j=0;
+                    }
+                    else
+                    {
+                      ErrorMsg("Argument\ntoo large");
+                      BCD_stack[(stack_ptr[which_stack]-1)*MATH_CELL_SIZE+BCD_SIGN]=j;
+                      x=1;
+                    }
+                  }
+                  else if (stack_buffer[BCD_DEC]>(Settings.DecPlaces)) stack_buffer[BCD_LEN]=stack_buffer[BCD_DEC];
                   else if (stack_buffer[BCD_LEN]>(Settings.DecPlaces))
                   {
                     stack_buffer[BCD_LEN]=Settings.DecPlaces;
@@ -675,8 +708,7 @@ int main(void)
 
                 if ((j)&&(x==0))
                 {
-                  ImmedBCD("1",p2);
-                  DivBCD(p3,p2,stack_buffer);
+                  DivBCD(p3,perm_one,stack_buffer);
                   CopyBCD(stack_buffer,p3);
                 }
               }
@@ -726,7 +758,7 @@ int main(void)
               else
               {
                 x=0;
-                if (BCD_stack[(stack_ptr[which_stack]-1)*MATH_CELL_SIZE+3]==1)
+                if (GetDigit(BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE,0)==1)
                 {
                   CopyBCD(p0,BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE);
 
@@ -734,7 +766,7 @@ int main(void)
                   k=p0[BCD_LEN];
                   for (i=k;i>j;i--)
                   {
-                    if (p0[i+2]==0) k--;
+                    if (GetDigit(p0,i-1)==0) k--;
                     else break;
                   }
 
@@ -742,16 +774,15 @@ int main(void)
 
                   if (p0[BCD_LEN]==p0[BCD_DEC])
                   {
-                    p0[3]=0;
+                    SetDigit(p0,0,0);
                     if (IsZero(p0))
                     {
                       stack_buffer[BCD_LEN]=3;
                       stack_buffer[BCD_DEC]=3;
                       stack_buffer[BCD_SIGN]=0;
                       i=p0[BCD_LEN]-1;
-                      stack_buffer[3]=i/100;
-                      stack_buffer[4]=(i%100)/10;
-                      stack_buffer[5]=(i%10);
+                      stack_buffer[3]=((i/100)<<4)|((i%100)/10);
+                      stack_buffer[4]=(i%10)<<4;
                       FullShrinkBCD(stack_buffer);
                       process_output=1;
                       x=1;
@@ -796,8 +827,7 @@ int main(void)
             }
             else
             {
-              ImmedBCD("1",p0);
-              DivBCD(stack_buffer,p0,BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE);
+              DivBCD(stack_buffer,perm_one,BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE);
               process_output=1;
             }
             redraw=true;
@@ -809,10 +839,9 @@ int main(void)
             if (BCD_stack[(stack_ptr[which_stack]-1)*MATH_CELL_SIZE+BCD_LEN]>BCD_stack[(stack_ptr[which_stack]-1)*MATH_CELL_SIZE+BCD_DEC])
             {
               BCD_stack[(stack_ptr[which_stack]-1)*MATH_CELL_SIZE+BCD_LEN]=BCD_stack[(stack_ptr[which_stack]-1)*MATH_CELL_SIZE+BCD_DEC];
-              if (BCD_stack[(stack_ptr[which_stack]-1)*MATH_CELL_SIZE+BCD_stack[(stack_ptr[which_stack]-1)*MATH_CELL_SIZE+BCD_LEN]+3]>4)
+              if (GetDigit(BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE,BCD_stack[(stack_ptr[which_stack]-1)*MATH_CELL_SIZE+BCD_LEN])>4)
               {
-                ImmedBCD("1",p0);
-                AddBCD(stack_buffer,p0,BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE);
+                AddBCD(stack_buffer,perm_one,BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE);
               }
               else CopyBCD(stack_buffer,BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE);
               process_output=1;
@@ -834,8 +863,7 @@ int main(void)
               }
               else
               {
-                ImmedBCD("1",p3);
-                DivBCD(p5,p3,BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE);
+                DivBCD(p5,perm_one,BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE);
               }
             }
             else CopyBCD(p5,BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE);
@@ -858,8 +886,8 @@ int main(void)
                 p5[BCD_SIGN]=0;
               }
 
-              if (k==COMP_EQ) ImmedBCD("0",stack_buffer);
-              else if (j==COMP_EQ) ImmedBCD("1",stack_buffer);
+              if (k==COMP_EQ) CopyBCD(stack_buffer,perm_zero);
+              else if (j==COMP_EQ) CopyBCD(stack_buffer,perm_one);
               else
               {
                 CopyBCD(p2,BCD_stack+(stack_ptr[which_stack]-2)*MATH_CELL_SIZE);
@@ -884,9 +912,24 @@ int main(void)
                   }
                 }
 
+                if ((x==0)&&(!PowBCD(stack_buffer,BCD_stack+(stack_ptr[which_stack]-2)*MATH_CELL_SIZE,p5)))
+                {
+                  //A negative power too large to hold is too small to show
+                  if (y&2)
+                  {
+                    CopyBCD(stack_buffer,perm_zero);
+                    y=0;
+                  }
+                  else
+                  {
+                    ErrorMsg("Argument\ntoo large");
+                    BCD_stack[(stack_ptr[which_stack]-2)*MATH_CELL_SIZE+BCD_SIGN]=(y&1);
+                    x=1;
+                  }
+                }
+
                 if (x==0)
                 {
-                  PowBCD(stack_buffer,BCD_stack+(stack_ptr[which_stack]-2)*MATH_CELL_SIZE,p5);
                   if (stack_buffer[BCD_DEC]>(Settings.DecPlaces))
                   {
                     stack_buffer[BCD_LEN]=stack_buffer[BCD_DEC];
@@ -897,14 +940,13 @@ int main(void)
                   }
                   if (y&2)
                   {
-                    ImmedBCD("1",p2);
-                    DivBCD(p3,p2,stack_buffer);
+                    DivBCD(p3,perm_one,stack_buffer);
                     CopyBCD(stack_buffer,p3);
                   }
 
                   if (y&1)
                   {
-                    if (p5[p5[BCD_DEC]+2]%2==1)
+                    if (GetDigit(p5,p5[BCD_DEC]-1)%2==1)
                     {
                       stack_buffer[BCD_SIGN]=(y&1);
                     }
@@ -921,7 +963,7 @@ int main(void)
           {
             if (IsZero(BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE))
             {
-              ImmedBCD("0",stack_buffer);
+              CopyBCD(stack_buffer,perm_zero);
               process_output=1;
             }
             else if (BCD_stack[(stack_ptr[which_stack]-1)*MATH_CELL_SIZE+BCD_SIGN]==1)
@@ -930,8 +972,7 @@ int main(void)
             }
             else
             {
-              ImmedBCD("0.5",p5);
-              PowBCD(stack_buffer,BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE,p5);
+              SqrtBCD(stack_buffer,BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE);
               if (stack_buffer[BCD_DEC]>(Settings.DecPlaces)) stack_buffer[BCD_LEN]=stack_buffer[BCD_DEC];
               else if (stack_buffer[BCD_LEN]>(Settings.DecPlaces))
               {
@@ -956,14 +997,14 @@ int main(void)
               else j=0;
               j+=TrigPrep(stack_ptr[which_stack],&k);
 
-              if ((key=='t')&&(CompBCD("90",p3)==COMP_EQ))
+              if ((key=='t')&&(CompVarBCD(perm_90,p3)==COMP_EQ))
               {
                 ErrorMsg("Invalid input");
               }
               else
               {
                 TanBCD(stack_buffer,p4,p3);
-                if (CompBCD("90",p3)==COMP_EQ) ImmedBCD("1",stack_buffer);
+                if (CompVarBCD(perm_90,p3)==COMP_EQ) CopyBCD(stack_buffer,perm_one);
                 if (j==1) stack_buffer[BCD_SIGN]=1;
                 if (k==1) p4[BCD_SIGN]=1;
 
@@ -984,11 +1025,11 @@ int main(void)
               if (stack_ptr[which_stack]>=1)
               {
                 process_output=1;
-                i=CompBCD("0",BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE);
-                j=CompBCD("1",BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE);
+                i=CompVarBCD(perm_zero,BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE);
+                j=CompVarBCD(perm_one,BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE);
                 k=CompBCD("-1",BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE);
-                if (i==COMP_EQ) ImmedBCD("0",stack_buffer);
-                else if (j==COMP_EQ) ImmedBCD("90",stack_buffer);
+                if (i==COMP_EQ) CopyBCD(stack_buffer,perm_zero);
+                else if (j==COMP_EQ) CopyBCD(stack_buffer,perm_90);
                 else if (k==COMP_EQ) ImmedBCD("-90",stack_buffer);
                 else if ((j==COMP_LT)||(k==COMP_GT))
                 {
@@ -1159,9 +1200,16 @@ int main(void)
         case 'x'://x^2
           if (stack_ptr[which_stack]>=1)
           {
-            CopyBCD(p0,BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE);
-            MultBCD(stack_buffer,p0,BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE);
-            process_output=1;
+            if (BCD_stack[(stack_ptr[which_stack]-1)*MATH_CELL_SIZE+BCD_LEN]*2+1>MATH_MAX_DIGITS)
+            {
+              ErrorMsg("Argument\ntoo large");
+            }
+            else
+            {
+              CopyBCD(p0,BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE);
+              MultBCD(stack_buffer,p0,BCD_stack+(stack_ptr[which_stack]-1)*MATH_CELL_SIZE);
+              process_output=1;
+            }
             redraw=true;
           }
           break;
@@ -1186,8 +1234,7 @@ int main(void)
           if (process_output>0)
           {
             CopyBCD(p0,stack_buffer);
-            ImmedBCD(deg_factor,p1);
-            DivBCD(stack_buffer,p0,p1);
+            DivBCD(stack_buffer,p0,perm_deg);
           }
         }
       }
@@ -1271,6 +1318,13 @@ static void Init()
   ImmedBCD("0",perm_zero);
   ImmedBCD(K,perm_K);
   ImmedBCD(log10_factor,perm_log10);
+  ImmedBCD("1",perm_one);
+  ImmedBCD("10",perm_ten);
+  ImmedBCD("90",perm_90);
+  ImmedBCD("180",perm_180);
+  ImmedBCD("360",perm_360);
+  ImmedBCD(deg_factor,perm_deg);
+  ImmedBCD(two_pi,perm_2pi);
   UART_Send(SlaveMakeTables,true);
   UART_Receive(true);
   gotoxy(16,1);
@@ -1282,6 +1336,13 @@ static void Init()
   ImmedBCD("0",perm_zero);
   ImmedBCD(K,perm_K);
   ImmedBCD(log10_factor,perm_log10);
+  ImmedBCD("1",perm_one);
+  ImmedBCD("10",perm_ten);
+  ImmedBCD("90",perm_90);
+  ImmedBCD("180",perm_180);
+  ImmedBCD("360",perm_360);
+  ImmedBCD(deg_factor,perm_deg);
+  ImmedBCD(two_pi,perm_2pi);
   UART_Send(SlaveMakeTables,true);
   UART_Receive(true);
   gotoxy(16,2);
@@ -1449,6 +1510,32 @@ static void RAM_Write(const unsigned char *a1, const unsigned char byte)
   UART_Send(byte,true);
 }
 
+static void RAM_ReadBlock(unsigned char *dest, const unsigned char *a1, unsigned int count)
+{
+  unsigned int i;
+  UART_Send(SlaveRAM_ReadBlock,true);
+  UART_SendWord((unsigned int)a1,true);
+  UART_SendWord(count,true);
+  for (i=0;i<count;i++) dest[i]=UART_Receive(false);
+}
+
+static void RAM_WriteBlock(unsigned char *a1, const unsigned char *src, unsigned int count)
+{
+  unsigned int i;
+  UART_Send(SlaveRAM_WriteBlock,true);
+  UART_SendWord((unsigned int)a1,true);
+  UART_SendWord(count,true);
+  for (i=0;i<count;i++) UART_Send(src[i],true);
+}
+
+static void RAM_Copy(unsigned char *dest, const unsigned char *src, unsigned int count)
+{
+  UART_Send(SlaveRAM_Copy,true);
+  UART_SendWord((unsigned int)dest,true);
+  UART_SendWord((unsigned int)src,true);
+  UART_SendWord(count,true);
+}
+
 static void AddBCD(unsigned char *result, const unsigned char *n1, const unsigned char *n2)
 {
   UART_Send(SlaveAdd,true);
@@ -1467,11 +1554,9 @@ static void SubBCD(unsigned char *result, const unsigned char *n1, unsigned char
 
 static void ImmedBCD(const char *text, unsigned char *BCD)
 {
-  int text_ptr=0;
-  do
-  {
-    perm_buff2[text_ptr]=(unsigned char)text[text_ptr];
-  } while(text[text_ptr++]);
+  int text_len=0;
+  while (text[text_len]) text_len++;
+  RAM_WriteBlock(perm_buff2,(const unsigned char *)text,text_len+1);
   BufferBCD(perm_buff2,BCD);
 }
 
@@ -1501,8 +1586,8 @@ static void PrintBCD(const unsigned char *BCD, int dec_point)
   for (BCD_ptr=3;BCD_ptr<BCD_end;BCD_ptr++)
   {
     if (BCD_ptr==BCD[BCD_DEC]+3) putchar('.');
-    if (BCD[BCD_ptr]>9) putchar('x');
-    else putchar('0'+BCD[BCD_ptr]);
+    if (GetDigit(BCD,BCD_ptr-3)>9) putchar('x');
+    else putchar('0'+GetDigit(BCD,BCD_ptr-3));
   }
 }
 
@@ -1550,6 +1635,29 @@ static bool IsZero(unsigned char *n1)
   return false;
 }
 
+static unsigned char GetDigit(const unsigned char *n1, int digit)
+{
+  #pragma MM_VAR n1
+  if (digit&1) return n1[(digit>>1)+3]&0xF;
+  else return n1[(digit>>1)+3]>>4;
+}
+
+static void SetDigit(unsigned char *n1, int digit, unsigned char value)
+{
+  #pragma MM_VAR n1
+  unsigned char b0;
+  b0=n1[(digit>>1)+3];
+  if (digit&1) n1[(digit>>1)+3]=(b0&0xF0)|value;
+  else n1[(digit>>1)+3]=(b0&0x0F)|(value<<4);
+}
+
+//Same as GetDigit but for a cell already copied into cell_buff
+static unsigned char CellDigit(const unsigned char *n1, int digit)
+{
+  if (digit&1) return n1[(digit>>1)+3]&0xF;
+  else return n1[(digit>>1)+3]>>4;
+}
+
 static void CopyBCD(unsigned char *dest, unsigned char *src)
 {
   UART_Send(SlaveCopy,true);
@@ -1589,12 +1697,21 @@ static void RorBCD(unsigned char *result, unsigned char *arg, unsigned int amoun
   UART_SendWord(amount,true);
 }
 
-static void PowBCD(unsigned char *result, unsigned char *base, unsigned char *exp)
+static bool PowBCD(unsigned char *result, unsigned char *base, unsigned char *exp)
 {
   UART_Send(SlavePow,true);
   UART_SendWord((unsigned int)result,true);
   UART_SendWord((unsigned int)base,true);
   UART_SendWord((unsigned int)exp,true);
+  if (UART_Receive(false)) return true;
+  return false;
+}
+
+static void SqrtBCD(unsigned char *result, unsigned char *arg)
+{
+  UART_Send(SlaveSqrt,true);
+  UART_SendWord((unsigned int)result,true);
+  UART_SendWord((unsigned int)arg,true);
 }
 
 static void TanBCD(unsigned char *sine_result,unsigned char *cos_result,unsigned char *arg)
@@ -1672,34 +1789,37 @@ void DrawStack(bool menu, bool input, int stack_pointer)
     putchar(':');
     if ((stack_pointer-j+i)>=0)
     {
-      if (BCD_stack[(stack_pointer-j+i)*MATH_CELL_SIZE+BCD_DEC]==0)
+      RAM_ReadBlock(cell_buff,BCD_stack+(stack_pointer-j+i)*MATH_CELL_SIZE,3);
+      if (cell_buff[BCD_DEC]==0)
       {
         PadBCD(BCD_stack+(stack_pointer-j+i)*MATH_CELL_SIZE,1);
+        RAM_ReadBlock(cell_buff,BCD_stack+(stack_pointer-j+i)*MATH_CELL_SIZE,3);
       }
-      CopyBCD(p1,BCD_stack+(stack_pointer-j+i)*MATH_CELL_SIZE);
+      RAM_ReadBlock(cell_buff+3,BCD_stack+(stack_pointer-j+i)*MATH_CELL_SIZE+3,BCD_BYTES(cell_buff[BCD_LEN]));
 
       if (Settings.SciNot)
       {
-        if (IsZero(p1)) LCD_Text("0.e0");
+        for (l=0;l<cell_buff[BCD_LEN];l++) if (CellDigit(cell_buff,l)) break;
+        if (l==cell_buff[BCD_LEN]) LCD_Text("0.e0");
         else
         {
           k=0;
-          for (l=0;l<p1[BCD_LEN];l++) if (p1[l+3]) k=l;
-          p1[BCD_LEN]=k+1;
+          for (l=0;l<cell_buff[BCD_LEN];l++) if (CellDigit(cell_buff,l)) k=l;
+          cell_buff[BCD_LEN]=k+1;
 
-          for (l=0;l<p1[BCD_LEN];l++) if (p1[l+3]!=0) break;
+          for (l=0;l<cell_buff[BCD_LEN];l++) if (CellDigit(cell_buff,l)!=0) break;
 
           m=0;
-          k=(p1[BCD_DEC]-l-1);//length of e
+          k=(cell_buff[BCD_DEC]-l-1);//length of e
           if (k<0) k=-k;
-          if (p1[BCD_SIGN]) m++;
+          if (cell_buff[BCD_SIGN]) m++;
           if (k>9) m++;
           if (k>99) m++;
-          if ((p1[BCD_DEC]-l-1)<0) m++;
+          if ((cell_buff[BCD_DEC]-l-1)<0) m++;
 
-          if ((16-m)>(p1[BCD_LEN]-l))
+          if ((16-m)>(cell_buff[BCD_LEN]-l))
           {
-            k_end=p1[BCD_LEN]-l;
+            k_end=cell_buff[BCD_LEN]-l;
             m=17-k_end-m;
           }
           else
@@ -1709,15 +1829,15 @@ void DrawStack(bool menu, bool input, int stack_pointer)
           }
 
           gotoxy(m,i);
-          if (p1[BCD_SIGN]) putchar('-');
+          if (cell_buff[BCD_SIGN]) putchar('-');
           for (k=0;k<k_end;k++)
           {
-            putchar(p1[k+l+3]+'0');
+            putchar(CellDigit(cell_buff,k+l)+'0');
             if (k==0) putchar('.');
           }
 
           putchar('e');
-          k=p1[BCD_DEC]-l-1;
+          k=cell_buff[BCD_DEC]-l-1;
           if (k<0)
           {
             putchar('-');
@@ -1731,26 +1851,26 @@ void DrawStack(bool menu, bool input, int stack_pointer)
       }
       else
       {
-        k=p1[BCD_LEN];
+        k=cell_buff[BCD_LEN];
 
-        while ((p1[k+2]==0)&&(k!=p1[BCD_DEC]))
+        while ((CellDigit(cell_buff,k-1)==0)&&(k!=cell_buff[BCD_DEC]))
         {
-          p1[BCD_LEN]-=1;
+          cell_buff[BCD_LEN]-=1;
           k--;
         }
-        k_end=p1[BCD_LEN];
+        k_end=cell_buff[BCD_LEN];
         if (k_end>=18)
         {
           k=0;
           k_end=18;
-          if (p1[BCD_SIGN]) k_end--;
-          if (p1[BCD_DEC]<k_end) k_end--;
+          if (cell_buff[BCD_SIGN]) k_end--;
+          if (cell_buff[BCD_DEC]<k_end) k_end--;
         }
         else if (k_end==17)
         {
           k=1;
-          if (p1[BCD_SIGN]) k=0;
-          if (p1[BCD_DEC]<k_end)
+          if (cell_buff[BCD_SIGN]) k=0;
+          if (cell_buff[BCD_DEC]<k_end)
           {
             if (k==0) k_end--;
             else k=0;
@@ -1759,25 +1879,25 @@ void DrawStack(bool menu, bool input, int stack_pointer)
         else
         {
           k=SCREEN_WIDTH-k_end-2;
-          if (p1[BCD_SIGN]) k--;
-          if (p1[BCD_DEC]<p1[BCD_LEN]) k--;
+          if (cell_buff[BCD_SIGN]) k--;
+          if (cell_buff[BCD_DEC]<cell_buff[BCD_LEN]) k--;
         }
 
         gotoxy(k+2,i);
-        if (p1[BCD_SIGN])
+        if (cell_buff[BCD_SIGN])
         {
           putchar('-');
           k++;
         }
         for (l=3;l<k_end+3;l++)
         {
-          putchar(p1[l]+'0');
-          if (p1[BCD_DEC]==l-2)
+          putchar(CellDigit(cell_buff,l-3)+'0');
+          if (cell_buff[BCD_DEC]==l-2)
           {
             if (l+k<20) putchar('.');
           }
         }
-        if (p1[BCD_DEC]>k_end)
+        if (cell_buff[BCD_DEC]>k_end)
         {
           gotoxy(19,i);
           putchar('>');
@@ -1789,20 +1909,20 @@ void DrawStack(bool menu, bool input, int stack_pointer)
 
 void DrawInput(unsigned char *line, int input_ptr, int offset, bool menu)
 {
-  #pragma MM_VAR line
-
   int i,j=4;
   bool done=false;
 
   if (menu) j--;
   gotoxy(0,j-1);
 
+  RAM_ReadBlock(cell_buff,line+offset,SCREEN_WIDTH+1);
+
   for (i=0;i<SCREEN_WIDTH;i++)
   {
     if ((i==0)&&(offset>0)) putchar('<');
-    else if ((i==SCREEN_WIDTH-1)&&(line[i+offset+1])&&(!done))
+    else if ((i==SCREEN_WIDTH-1)&&(cell_buff[i+1])&&(!done))
     {
-      if (line[i+offset])
+      if (cell_buff[i])
       {
         putchar('>');
       }
@@ -1811,7 +1931,7 @@ void DrawInput(unsigned char *line, int input_ptr, int offset, bool menu)
     {
       if (!done)
       {
-        if (line[i+offset]) putchar(line[i+offset]);
+        if (cell_buff[i]) putchar(cell_buff[i]);
         else
         {
           done=true;
@@ -1911,16 +2031,29 @@ static void SetDecPlaces()
     for (i=0;i<MATH_TRIG_TABLE;i++)
     {
       trig[i*MATH_ENTRY_SIZE+BCD_LEN]=j+Settings.DecPlaces;
-      if (IsZero(trig+i*MATH_ENTRY_SIZE)) break;
+      if (trig_lead[i]>=j+Settings.DecPlaces) break;
     }
     Settings.TrigTableSize=i+1;
     for (i=0;i<MATH_LOG_TABLE;i++)
     {
       logs[i*MATH_ENTRY_SIZE+BCD_LEN]=j+Settings.DecPlaces;
-      if (IsZero(logs+i*MATH_ENTRY_SIZE)) break;
+      if (log_lead[i]>=j+Settings.DecPlaces) break;
     }
     Settings.LogTableSize=i+1;//this was +0 on slave
 
+    #ifdef CORDIC_TAIL
+      //What is left after entry k is below 2^-k and the linear step is off by about its
+      //square. The first 8 log entries are powers of 2 times ln(2) so k starts after them.
+      if (Settings.TrigTableSize/2+CORDIC_TAIL_EXTRA<Settings.TrigTableSize)
+      {
+        Settings.TrigTableSize=Settings.TrigTableSize/2+CORDIC_TAIL_EXTRA;
+      }
+      if ((Settings.LogTableSize+8)/2+CORDIC_TAIL_EXTRA<Settings.LogTableSize)
+      {
+        Settings.LogTableSize=(Settings.LogTableSize+8)/2+CORDIC_TAIL_EXTRA;
+      }
+    #endif
+
     perm_K[BCD_LEN]=1+Settings.DecPlaces;
     perm_log10[BCD_LEN]=1+Settings.DecPlaces;
   }
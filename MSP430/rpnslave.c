@@ -28,6 +28,17 @@
 #define LED             BIT6  //P1.6 LED
 #define ADDRESS_DATA    BIT7  //P1.7 SRAM 595 data
 
+//Most bits RolBCD and RorBCD shift by in one pass over a number. What is carried from
+//one digit to the next needs 4 more bits than this.
+#define SCALE_BITS 28
+
+//Most bits ShiftAddBCD shifts by in one pass. 10*5^SHIFT_ADD_BITS has to fit in the 32 bit
+//accumulator, since 64 bit math is slow on the MSP430. Larger shifts go through RorBCD.
+#define SHIFT_ADD_BITS 12
+
+//Integer exponents with up to this many digits are done by squaring in PowBCD
+#define POW_INT_DIGITS 9
+
 #pragma MM_READ RAM_Read
 #pragma MM_WRITE RAM_Write
 #pragma MM_ON
@@ -36,6 +47,7 @@ static void Init();
 
 static void RAM_Write(const unsigned char *a1, const unsigned char byte);
 static unsigned char RAM_Read(const unsigned char *a1);
+static void RAM_Copy(unsigned char *dest, const unsigned char *src, unsigned int count);
 
 static void MakeTables();
 
@@ -46,16 +58,25 @@ static void BufferBCD(const unsigned char *text, unsigned char *BCD);
 static void PrintBCD(const unsigned char *BCD, int dec_point);
 static void MultBCD(unsigned char *result, const unsigned char *n1, const unsigned char *n2);
 static void DivBCD(unsigned char *result, const unsigned char *n1, const unsigned char *n2);
+static void ModBCD(unsigned char *result, unsigned char *n1, unsigned char *n2);
 static void ShrinkBCD(unsigned char *dest,unsigned char *src);
 static void FullShrinkBCD(unsigned char *n1);
 static void PadBCD(unsigned char *n1, int amount);
 static bool IsZero(unsigned char *n1);
+static int TrailingZeros(const unsigned char *n1);
+static void ShiftDecBCD(unsigned char *n1, int amount);
+static int FracZeros(const unsigned char *n1, int known);
+static unsigned char GetDigit(const unsigned char *n1, int digit);
+static void SetDigit(unsigned char *n1, int digit, unsigned char value);
 static void CopyBCD(unsigned char *dest, unsigned char *src);
 static bool LnBCD(unsigned char *result, unsigned char *arg);
 static void ExpBCD(unsigned char *result, unsigned char *arg);
 static void RolBCD(unsigned char *result, unsigned char *arg, unsigned char amount);
 static void RorBCD(unsigned char *result, unsigned char *arg, unsigned char amount);
-static void PowBCD(unsigned char *result, unsigned char *base, unsigned char *exp);
+static void ShiftAddBCD(unsigned char *result, unsigned char *n1, unsigned char *n2, int amount, bool subtract);
+static bool PowBCD(unsigned char *result, unsigned char *base, unsigned char *exp);
+static unsigned long PowIntBCD(unsigned char *result, unsigned char *base, unsigned long n);
+static void SqrtBCD(unsigned char *result, unsigned char *arg);
 static void TanBCD(unsigned char *sine_result,unsigned char *cos_result,unsigned char *arg);
 static void AcosBCD(unsigned char *result,unsigned char *arg);
 static void AsinBCD(unsigned char *result,unsigned char *arg);
@@ -69,27 +90,34 @@ static void SetDecPlaces();
 
 #pragma MM_OFFSET 0
 #pragma MM_GLOBALS
-  unsigned char p0[260]; //PowBCD, LnBCD, ExpBCD, TanBCD, AtanBCD, typing,    CompBCD
-  unsigned char p1[260]; //PowBCD, LnBCD, ExpBCD, TanBCD, AtanBCD, DrawStack, CompBCD, CompVarBCD
-  unsigned char p2[260]; //PowBCD, LnBCD, ExpBCD, TanBCD, AtanBCD
-  unsigned char p3[260]; //PowBCD
-  unsigned char p4[260]; //PowBCD
-  unsigned char p5[260];
-  unsigned char p6[260];
-  unsigned char p7[260];
-  unsigned char buffer[260]; //AddBCD
-  unsigned char perm_buff1[260]; //DivBCD, MultBCD
-  unsigned char perm_buff2[260]; //DivBCD
-  unsigned char perm_buff3[260]; //DivBCD
+  unsigned char p0[132]; //PowBCD, LnBCD, ExpBCD, TanBCD, AtanBCD, typing,    CompBCD, ModBCD
+  unsigned char p1[132]; //PowBCD, LnBCD, ExpBCD, TanBCD, AtanBCD, DrawStack, ModBCD
+  unsigned char p2[132]; //PowBCD, LnBCD, ExpBCD, TanBCD, AtanBCD
+  unsigned char p3[132]; //PowBCD
+  unsigned char p4[132]; //PowBCD
+  unsigned char p5[132];
+  unsigned char p6[132];
+  unsigned char p7[132];
+  unsigned char buffer[132]; //AddBCD
+  unsigned char perm_buff1[132]; //DivBCD, MultBCD
+  unsigned char perm_buff2[132]; //DivBCD
+  unsigned char perm_buff3[132]; //DivBCD
   //unsigned char logs[MATH_LOG_TABLE*MATH_ENTRY_SIZE];
-  unsigned char logs[4218];
+  unsigned char logs[2280];
   //unsigned char trig[MATH_TRIG_TABLE*MATH_ENTRY_SIZE];
-  unsigned char trig[4218];
+  unsigned char trig[2260];
   unsigned char perm_zero[4];
-  unsigned char perm_K[36];
-  unsigned char perm_log10[36];
+  unsigned char perm_K[20];
+  unsigned char perm_log10[20];
+  unsigned char perm_one[4];
+  unsigned char perm_ten[4];
+  unsigned char perm_90[4];
+  unsigned char perm_180[5];
+  unsigned char perm_360[5];
+  unsigned char perm_deg[20];
+  unsigned char perm_2pi[20];
   unsigned char BCD_stack[52000];
-  unsigned char stack_buffer[260];
+  unsigned char stack_buffer[132];
 #pragma MM_END
 
 struct SettingsType Settings;
@@ -153,6 +181,27 @@ int main(void)
         RAM_Write((unsigned char *)a0,UART_Receive(true));
         UART_Ready();
         break;
+      case SlaveRAM_ReadBlock:
+        a0=UART_ReceiveWord(false);
+        a1=UART_ReceiveWord(false);
+        for (a2=0;a2<a1;a2++) UART_Send(RAM_Read((unsigned char *)(a0+a2)),true);
+        break;
+      case SlaveRAM_WriteBlock:
+        a0=UART_ReceiveWord(false);
+        a1=UART_ReceiveWord(false);
+        for (a2=0;a2<a1;a2++)
+        {
+          RAM_Write((unsigned char *)(a0+a2),UART_Receive(true));
+          UART_Ready();
+        }
+        break;
+      case SlaveRAM_Copy:
+        a0=UART_ReceiveWord(false);
+        a1=UART_ReceiveWord(false);
+        a2=UART_ReceiveWord(true);
+        RAM_Copy((unsigned char *)a0,(unsigned char *)a1,a2);
+        UART_Ready();
+        break;
       case SlaveSync:
         UART_Send(SlaveAnswer,true);
         break;
@@ -251,8 +300,14 @@ int main(void)
       case SlavePow:
         a0=UART_ReceiveWord(false);
         a1=UART_ReceiveWord(false);
-        a2=UART_ReceiveWord(true);
-        PowBCD((unsigned char *)a0,(unsigned char *)a1,(unsigned char *)a2);
+        a2=UART_ReceiveWord(false);
+        if (PowBCD((unsigned char *)a0,(unsigned char *)a1,(unsigned char *)a2)) UART_Send(1,true);
+        else UART_Send(0,true);
+        break;
+      case SlaveSqrt:
+        a0=UART_ReceiveWord(false);
+        a1=UART_ReceiveWord(true);
+        SqrtBCD((unsigned char *)a0,(unsigned char *)a1);
         UART_Ready();
         break;
       case SlaveTan:
@@ -350,8 +405,19 @@ static void RAM_Write(const unsigned char *a1, const unsigned char byte)
   P2DIR=0;
 }
 
+//Overlapping blocks are copied from the far end
+static void RAM_Copy(unsigned char *dest, const unsigned char *src, unsigned int count)
+{
+  #pragma MM_VAR dest
+  #pragma MM_VAR src
+  unsigned int i;
+  if (dest<src) for (i=0;i<count;i++) dest[i]=src[i];
+  else for (i=count;i>0;i--) dest[i-1]=src[i-1];
+}
+
 static void MakeTables()
 {
+  //The first number of every line is the number of BCD bytes that follow it.
   //Log table
   static const unsigned char table[]={
   17 ,0x88,0x72,0x28,0x39,0x11,0x16,0x72,0x99,0x96,0x05,0x40,0x57,0x11,0x54,0x66,0x46,0x60,
@@ -468,6 +534,7 @@ static void MakeTables()
   1 ,0x05,
   1 ,0x02,
   1 ,0x01,
+
   //Trig table
   17 ,0x45,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
   17 ,0x26,0x56,0x50,0x51,0x17,0x70,0x77,0x98,0x93,0x51,0x57,0x21,0x93,0x72,0x04,0x53,0x29,
@@ -584,28 +651,28 @@ static void MakeTables()
   1 ,0x01,
   0};
 
-  int i,i_end;
+  #pragma MM_VAR dest
+
+  //The table is already packed BCD so it is copied as is after the leading zeroes
+  int i,i_end,entry=0;
   int table_ptr=0,log_ptr=0;
+  unsigned char *dest=logs;
   do
   {
-    logs[log_ptr+BCD_SIGN]=0;
-    logs[log_ptr+BCD_DEC]=2;
-    logs[log_ptr+BCD_LEN]=34;
+    if (entry==MATH_LOG_TABLE)
+    {
+      dest=trig;
+      log_ptr=0;
+    }
+    dest[log_ptr+BCD_SIGN]=0;
+    dest[log_ptr+BCD_DEC]=2;
+    dest[log_ptr+BCD_LEN]=34;
     log_ptr+=3;
     i_end=table[table_ptr];
     table_ptr++;
-    for (i=0;i<(17-i_end);i++)
-    {
-      logs[log_ptr++]=0;
-      logs[log_ptr++]=0;
-    }
-    for (i=0;i<i_end;i++)
-    {
-      logs[log_ptr]=table[table_ptr]>>4;
-      logs[log_ptr+1]=table[table_ptr]&0xF;
-      table_ptr++;
-      log_ptr+=2;
-    }
+    for (i=0;i<(17-i_end);i++) dest[log_ptr++]=0;
+    for (i=0;i<i_end;i++) dest[log_ptr++]=table[table_ptr++];
+    entry++;
   } while(table[table_ptr]);
 }
 
@@ -624,6 +691,10 @@ static void AddBCD(unsigned char *result, const unsigned char *n1, const unsigne
   unsigned char carry_number=0;
   bool subtracting=false;
   int t1,t2,d1,d2;
+  //Digits are read and written a byte at a time. These hold the byte last read
+  //from each number and the low digit waiting to be written.
+  int n1_cached=-1, n2_cached=-1;
+  unsigned char n1_byte=0, n2_byte=0, low=0;
 
   t1=n1[BCD_SIGN];
   t2=n2[BCD_SIGN];
@@ -645,14 +716,19 @@ static void AddBCD(unsigned char *result, const unsigned char *n1, const unsigne
     buffer[BCD_DEC]=n2[BCD_DEC];
     buffer[BCD_LEN]=n2[BCD_LEN];
     carry=1;
-    for (BCD_ptr=n2[BCD_LEN]+2;BCD_ptr>=3;BCD_ptr--)
+    BCD_end=n2[BCD_LEN]-1;
+    for (BCD_ptr=BCD_end;BCD_ptr>=0;BCD_ptr--)
     {
-      t1=9-n2[BCD_ptr]+carry;
-      if (t1==10) buffer[BCD_ptr]=0;
+      if ((BCD_ptr&1)||(BCD_ptr==BCD_end)) n2_byte=n2[(BCD_ptr>>1)+3];
+      if (BCD_ptr&1) t1=9-(n2_byte&0xF)+carry;
+      else t1=9-(n2_byte>>4)+carry;
+      if (t1==10) t1=0;
+      else carry=0;
+      if (BCD_ptr&1) low=t1;
       else
       {
-        carry=0;
-        buffer[BCD_ptr]=t1;
+        buffer[(BCD_ptr>>1)+3]=(t1<<4)|low;
+        low=0;
       }
     }
     carry_number=9;
@@ -693,13 +769,33 @@ static void AddBCD(unsigned char *result, const unsigned char *n1, const unsigne
   }
 
   carry=0;
-  BCD_end=result[BCD_LEN]+2;
-  for (BCD_ptr=BCD_end;BCD_ptr>=3;BCD_ptr--)
+  BCD_end=result[BCD_LEN]-1;
+  for (BCD_ptr=BCD_end;BCD_ptr>=0;BCD_ptr--)
   {
     t1=carry;
-    if ((BCD_ptr<=BCD_end-n1_dec)&&(BCD_ptr>n1_whole+2)) t1+=n1[BCD_ptr-n1_whole];
-    if ((BCD_ptr<=BCD_end-n2_dec)&&(BCD_ptr>n2_whole+2)) t1+=n2[BCD_ptr-n2_whole];
-    if (BCD_ptr<=n2_whole+2) t1+=carry_number;
+    if ((BCD_ptr<=BCD_end-n1_dec)&&(BCD_ptr>=n1_whole))
+    {
+      d1=BCD_ptr-n1_whole;
+      if ((d1>>1)!=n1_cached)
+      {
+        n1_cached=d1>>1;
+        n1_byte=n1[n1_cached+3];
+      }
+      if (d1&1) t1+=n1_byte&0xF;
+      else t1+=n1_byte>>4;
+    }
+    if ((BCD_ptr<=BCD_end-n2_dec)&&(BCD_ptr>=n2_whole))
+    {
+      d2=BCD_ptr-n2_whole;
+      if ((d2>>1)!=n2_cached)
+      {
+        n2_cached=d2>>1;
+        n2_byte=n2[n2_cached+3];
+      }
+      if (d2&1) t1+=n2_byte&0xF;
+      else t1+=n2_byte>>4;
+    }
+    if (BCD_ptr<n2_whole) t1+=carry_number;
 
     if (t1>9)
     {
@@ -707,24 +803,38 @@ static void AddBCD(unsigned char *result, const unsigned char *n1, const unsigne
       carry=1;
     }
     else carry=0;
-    result[BCD_ptr]=t1;
+
+    if (BCD_ptr&1) low=t1;
+    else
+    {
+      result[(BCD_ptr>>1)+3]=(t1<<4)|low;
+      low=0;
+    }
   }
 
   if ((carry==1)&&(subtracting==false))
   {
     PadBCD(result,1);
-    result[3]=1;
+    SetDigit(result,0,1);
   }
 
   if ((carry==0)&&(carry_number==9)&&(sign==2))
   {
     carry=1;
-    for (BCD_ptr=result[BCD_LEN]+2;BCD_ptr>=3;BCD_ptr--)
+    BCD_end=result[BCD_LEN]-1;
+    for (BCD_ptr=BCD_end;BCD_ptr>=0;BCD_ptr--)
     {
-      t1=9-result[BCD_ptr]+carry;
+      if ((BCD_ptr&1)||(BCD_ptr==BCD_end)) n1_byte=result[(BCD_ptr>>1)+3];
+      if (BCD_ptr&1) t1=9-(n1_byte&0xF)+carry;
+      else t1=9-(n1_byte>>4)+carry;
       if (t1==10) t1=0;
       else carry=0;
-      result[BCD_ptr]=t1;
+      if (BCD_ptr&1) low=t1;
+      else
+      {
+        result[(BCD_ptr>>1)+3]=(t1<<4)|low;
+        low=0;
+      }
     }
     sign=1;
   }
@@ -758,8 +868,9 @@ static void BufferBCD(const unsigned char *text, unsigned char *BCD)
   #pragma MM_VAR BCD
 
   unsigned char *RAM_ptr;
-  int BCD_ptr=3,text_ptr=0;
+  int BCD_ptr=0,text_ptr=0;
   char found=0;
+  unsigned char high=0;
 
   if (text[0]=='-')
   {
@@ -780,11 +891,13 @@ static void BufferBCD(const unsigned char *text, unsigned char *BCD)
     }
     else
     {
-      BCD[BCD_ptr]=text[text_ptr]-'0';
+      if (BCD_ptr&1) BCD[(BCD_ptr>>1)+3]=high|(text[text_ptr]-'0');
+      else high=(text[text_ptr]-'0')<<4;
       BCD_ptr++;
     }
     text_ptr++;
   }
+  if (BCD_ptr&1) BCD[(BCD_ptr>>1)+3]=high;
   BCD[BCD_LEN]=text_ptr-found;
   if (found==0) BCD[BCD_DEC]=BCD[BCD_LEN];
 }
@@ -794,64 +907,51 @@ static void MultBCD(unsigned char *result, const unsigned char *n1, const unsign
   #pragma MM_VAR result
   #pragma MM_VAR n1
   #pragma MM_VAR n2
-  #pragma MM_VAR temp
-
-  #pragma MM_DECLARE
-    unsigned char temp[5];
-  #pragma MM_END
-
-  unsigned char i,j,k,flip=0;
-  unsigned char i_end, j_end, k_end;
-  //maybe b1,b2 is faster
-  unsigned char b0,b1;
-  CopyBCD(result,perm_zero);
-  CopyBCD(perm_buff1,perm_zero);
-
-  temp[BCD_SIGN]=0;
-  temp[BCD_LEN]=2;
 
-  i_end=n1[BCD_LEN];
-  j_end=n2[BCD_LEN];
-  for (i=0;i<i_end;i++)
+  int i,j,j_start;
+  int i_end,j_end,i_zeros,j_zeros;
+  unsigned int accum=0;
+  unsigned char low=0;
+
+  //Zeroes at the end of whole numbers, like the ones 10^x makes, are left out of the
+  //multiply and put back on the product afterwards
+  i_zeros=TrailingZeros(n1);
+  j_zeros=TrailingZeros(n2);
+  i_end=n1[BCD_LEN]-i_zeros;
+  j_end=n2[BCD_LEN]-j_zeros;
+  if ((i_end==0)||(j_end==0)) CopyBCD(result,perm_zero);
+  else
   {
-    for (j=0;j<j_end;j++)
+    //Each digit of the product is the sum of one column of digit products plus the
+    //carry from the column before, so no intermediate additions are needed
+    result[BCD_SIGN]=0;
+    result[BCD_LEN]=i_end+j_end;
+    result[BCD_DEC]=i_end+j_end;
+    for (i=i_end+j_end-1;i>=0;i--)
     {
-      b0=0;
-      b1=0;
-      k_end=n1[i+3];
-      for (k=0;k<k_end;k++) b0+=n2[j+3];
-      while (b0>9)
+      j_start=i-j_end;
+      if (j_start<0) j_start=0;
+      for (j=j_start;(j<i)&&(j<i_end);j++) accum+=GetDigit(n1,j)*GetDigit(n2,i-1-j);
+
+      if (i&1) low=accum%10;
+      else
       {
-        b1+=1;
-        b0-=10;
+        result[(i>>1)+3]=((accum%10)<<4)|low;
+        low=0;
       }
-      temp[3]=b1;
-      temp[4]=b0;
-
-      temp[BCD_DEC]=2+i_end-i+j_end-j-2;
-      if (flip==0) AddBCD(result,temp,perm_buff1);
-      else AddBCD(perm_buff1,temp,result);
-      flip=!flip;
+      accum/=10;
     }
   }
-
-  if (flip==0)
-  {
-    //Just CopyBCD?
-    i=perm_buff1[BCD_LEN];
-    for (j=0;j<i+3;j++) result[j]=perm_buff1[j];
-  }
-  i=(i_end-n1[BCD_DEC])+(j_end-n2[BCD_DEC]);
+  i=(n1[BCD_LEN]-n1[BCD_DEC])+(n2[BCD_LEN]-n2[BCD_DEC]);
 
   if (i>Settings.DecPlaces)
   {
     result[BCD_LEN]-=(i-Settings.DecPlaces-1);
     result[BCD_DEC]=result[BCD_LEN];
 
-    if (result[result[BCD_LEN]+2]>4)
+    if (GetDigit(result,result[BCD_LEN]-1)>4)
     {
-      ImmedBCD("10",temp);
-      AddBCD(perm_buff1,result,temp);
+      AddBCD(perm_buff1,result,perm_ten);
       CopyBCD(result,perm_buff1);
     }
     result[BCD_LEN]-=1;
@@ -859,6 +959,7 @@ static void MultBCD(unsigned char *result, const unsigned char *n1, const unsign
   }
   result[BCD_DEC]-=i;
   result[BCD_SIGN]=n1[BCD_SIGN]^n2[BCD_SIGN];
+  if (i_zeros+j_zeros) ShiftDecBCD(result,i_zeros+j_zeros);
 
   FullShrinkBCD(result);
 }
@@ -883,7 +984,7 @@ static void DivBCD(unsigned char *result, const unsigned char *n1, const unsigne
 
   result[BCD_LEN]=0;
 
-  result_ptr=3;
+  result_ptr=0;
 
   post_offset=n1[BCD_LEN]-n2[BCD_LEN];
 
@@ -900,7 +1001,7 @@ static void DivBCD(unsigned char *result, const unsigned char *n1, const unsigne
       result[BCD_DEC]=0;
       result_ptr+=pre_offset;
       res_ptr_off+=pre_offset;
-      for (i=3;i<(pre_offset+3);i++) result[i]=0;
+      for (i=0;i<pre_offset;i++) SetDigit(result,i,0);
     }
   }
   else if (post_offset>0)
@@ -921,22 +1022,23 @@ static void DivBCD(unsigned char *result, const unsigned char *n1, const unsigne
   perm_buff1[BCD_SIGN]=0;
   perm_buff1[BCD_LEN]=n2[BCD_LEN]+1;
   perm_buff1[BCD_DEC]=perm_buff1[BCD_LEN];
-  perm_buff1[3]=0;
+  SetDigit(perm_buff1,0,0);
 
-  i_end=n2[BCD_LEN]+3;
-  for (i=3;i<i_end;i++)
+  i_end=n2[BCD_LEN];
+  for (i=0;i<i_end;i++)
   {
     //<=? was <
-    if ((i-3)<post_offset) perm_buff1[i+1]=0;
-    else if ((i-post_offset)>(n1[BCD_LEN]+2)) perm_buff1[i+1]=0;
-    else perm_buff1[i+1]=n1[i-post_offset];
-    perm_buff2[i]=n2[i];
+    if (i<post_offset) SetDigit(perm_buff1,i+1,0);
+    else if ((i-post_offset)>=n1[BCD_LEN]) SetDigit(perm_buff1,i+1,0);
+    else SetDigit(perm_buff1,i+1,GetDigit(n1,i-post_offset));
   }
+  i_end=BCD_BYTES(n2[BCD_LEN])+3;
+  for (i=3;i<i_end;i++) perm_buff2[i]=n2[i];
 
-  n1_ptr=n2[BCD_LEN]+3+post_offset;
+  n1_ptr=n2[BCD_LEN]+post_offset;
   do
   {
-    result[result_ptr]=0;
+    SetDigit(result,result_ptr,0);
     result[BCD_LEN]+=1;
 
     do
@@ -945,47 +1047,53 @@ static void DivBCD(unsigned char *result, const unsigned char *n1, const unsigne
 
       if ((perm_buff3[BCD_SIGN]==0)||(IsZero(perm_buff3)))
       {
-        result[result_ptr]+=1;
-        if (result[result_ptr]==10)
+        j=GetDigit(result,result_ptr)+1;
+        if (j==10)
         {
-          result[result_ptr]=0;
-          for (i=result_ptr-1;i>=3;i--)
+          SetDigit(result,result_ptr,0);
+          for (i=result_ptr-1;i>=0;i--)
           {
-            result[i]+=1;
-            if (result[i]<10) break;
-            else result[i]=0;
+            j=GetDigit(result,i)+1;
+            if (j<10)
+            {
+              SetDigit(result,i,j);
+              break;
+            }
+            else SetDigit(result,i,0);
           }
-          if (i==2)
+          if (i==-1)
           {
-            result[3]=1;
-            for (i=4;i<result_ptr;i++) result[i]=0;
+            SetDigit(result,0,1);
+            for (i=1;i<result_ptr;i++) SetDigit(result,i,0);
             result_ptr++;
             result[BCD_LEN]+=1;
             result[BCD_DEC]+=1;
-            result[result_ptr]=0;
+            SetDigit(result,result_ptr,0);
           }
         }
-        i_end=perm_buff1[BCD_LEN]+3;
+        else SetDigit(result,result_ptr,j);
+        i_end=BCD_BYTES(perm_buff1[BCD_LEN])+3;
         for (i=3;i<i_end;i++) perm_buff1[i]=perm_buff3[i];
       }
     } while ((perm_buff3[BCD_SIGN]==0)&&(!IsZero(perm_buff3)));
 
-    i_end=n2[BCD_LEN]+3;
-    for (i=3;i<i_end;i++) perm_buff1[i]=perm_buff1[i+1];
+    //Shift the remainder left by one digit
+    i_end=BCD_BYTES(perm_buff1[BCD_LEN])+3;
+    for (i=3;i<i_end;i++) perm_buff1[i]=(perm_buff1[i]<<4)|(perm_buff1[i+1]>>4);
 
-    if ((n1_ptr-3)>=n1[BCD_LEN])
+    if (n1_ptr>=n1[BCD_LEN])
     {
-      perm_buff1[i]=0;
+      SetDigit(perm_buff1,n2[BCD_LEN],0);
     }
     else
     {
-      perm_buff1[i]=n1[n1_ptr];
+      SetDigit(perm_buff1,n2[BCD_LEN],GetDigit(n1,n1_ptr));
       n1_ptr++;
     }
     result_ptr++;
 
     //< or <=?
-    if ((result_ptr-3)<(result[BCD_DEC]))
+    if (result_ptr<(result[BCD_DEC]))
     {
       logic=true;
     }
@@ -998,9 +1106,9 @@ static void DivBCD(unsigned char *result, const unsigned char *n1, const unsigne
 
   if ((result[BCD_LEN]-result[BCD_DEC])>max_offset)
   {
-    if (result[result[BCD_LEN]+2]>4)
+    if (GetDigit(result,result[BCD_LEN]-1)>4)
     {
-      i_end=result[BCD_LEN]+2;
+      i_end=BCD_BYTES(result[BCD_LEN]-1)+3;
       for (i=3;i<i_end;i++) perm_buff3[i]=result[i];
       i=result[BCD_LEN];
       j=result[BCD_DEC];
@@ -1010,7 +1118,7 @@ static void DivBCD(unsigned char *result, const unsigned char *n1, const unsigne
       perm_buff1[BCD_SIGN]=0;
       perm_buff1[BCD_LEN]=1;
       perm_buff1[BCD_DEC]=1;
-      perm_buff1[3]=1;
+      perm_buff1[3]=0x10;
       AddBCD(result,perm_buff3,perm_buff1);
       result[BCD_DEC]=j;
       if (result[BCD_LEN]==i) result[BCD_DEC]+=1;
@@ -1024,6 +1132,53 @@ static void DivBCD(unsigned char *result, const unsigned char *n1, const unsigne
   FullShrinkBCD(result);
 }
 
+static void ModBCD(unsigned char *result, unsigned char *n1, unsigned char *n2)
+{
+  #pragma MM_VAR result
+  #pragma MM_VAR n1
+  #pragma MM_VAR n2
+
+  unsigned char sign,comp;
+  int places;
+  bool flip;
+
+  //n1 is already the remainder when it is smaller than n2
+  sign=n1[BCD_SIGN];
+  flip=(sign!=n2[BCD_SIGN]);
+  if (flip) n2[BCD_SIGN]=sign;
+  comp=CompVarBCD(n1,n2);
+  if (flip) n2[BCD_SIGN]=!sign;
+  if (comp==COMP_EQ)
+  {
+    CopyBCD(result,perm_zero);
+    return;
+  }
+  else if ((comp==COMP_LT)==(sign==0))
+  {
+    if (result!=n1) CopyBCD(result,n1);
+    return;
+  }
+
+  //Take off the whole part of the quotient times n2. The cost depends on the number of
+  //digits rather than the size of the quotient.
+  DivBCD(p0,n1,n2);
+  p0[BCD_LEN]=p0[BCD_DEC];
+  //The product has to keep every decimal place of n2 or the remainder is rounded off
+  places=Settings.DecPlaces;
+  if ((n2[BCD_LEN]-n2[BCD_DEC])>places) Settings.DecPlaces=n2[BCD_LEN]-n2[BCD_DEC];
+  MultBCD(p1,p0,n2);
+  Settings.DecPlaces=places;
+  SubBCD(result,n1,p1);
+
+  //Only needed if the quotient came out one too far from zero
+  if ((result[BCD_SIGN]!=sign)&&(!IsZero(result)))
+  {
+    if (n2[BCD_SIGN]==sign) AddBCD(p1,result,n2);
+    else SubBCD(p1,result,n2);
+    CopyBCD(result,p1);
+  }
+}
+
 static void ShrinkBCD(unsigned char *dest,unsigned char *src)
 {
   #pragma MM_VAR dest
@@ -1031,9 +1186,16 @@ static void ShrinkBCD(unsigned char *dest,unsigned char *src)
 
   int BCD_ptr,off_ptr=0;
   int ptr_end;
-  if ((src[3]==0)&&(src[BCD_DEC]!=0)&&(src[BCD_LEN]>1)) off_ptr=1;
-  ptr_end=src[BCD_LEN]+3-off_ptr;
-  for (BCD_ptr=3;BCD_ptr<ptr_end;BCD_ptr++) dest[BCD_ptr]=src[BCD_ptr+off_ptr];
+  if ((GetDigit(src,0)==0)&&(src[BCD_DEC]!=0)&&(src[BCD_LEN]>1)) off_ptr=1;
+  ptr_end=BCD_BYTES(src[BCD_LEN]-off_ptr)+3;
+  if (off_ptr==1)
+  {
+    for (BCD_ptr=3;BCD_ptr<ptr_end;BCD_ptr++) dest[BCD_ptr]=(src[BCD_ptr]<<4)|(src[BCD_ptr+1]>>4);
+  }
+  else if (dest!=src)
+  {
+    for (BCD_ptr=3;BCD_ptr<ptr_end;BCD_ptr++) dest[BCD_ptr]=src[BCD_ptr];
+  }
   dest[BCD_SIGN]=src[BCD_SIGN];
   dest[BCD_LEN]=src[BCD_LEN];
   dest[BCD_DEC]=src[BCD_DEC];
@@ -1047,15 +1209,46 @@ static void ShrinkBCD(unsigned char *dest,unsigned char *src)
 static void FullShrinkBCD(unsigned char *n1)
 {
   #pragma MM_VAR n1
-  while ((n1[3]==0)&&(n1[BCD_DEC]>1)) ShrinkBCD(n1,n1);
+  int i,i_end,amount=0;
+
+  //Count the leading zeroes first so the digits only have to be moved once. Whole bytes
+  //of zeroes are skipped before looking at single digits.
+  i_end=n1[BCD_DEC]-1;
+  while ((amount+1<i_end)&&(n1[(amount>>1)+3]==0)) amount+=2;
+  while ((amount<i_end)&&(GetDigit(n1,amount)==0)) amount++;
+  if (amount==0) return;
+
+  i_end=BCD_BYTES(n1[BCD_LEN]-amount)+3;
+  if (amount&1)
+  {
+    for (i=3;i<i_end;i++) n1[i]=(n1[i+(amount>>1)]<<4)|(n1[i+(amount>>1)+1]>>4);
+  }
+  else
+  {
+    for (i=3;i<i_end;i++) n1[i]=n1[i+(amount>>1)];
+  }
+  n1[BCD_LEN]-=amount;
+  n1[BCD_DEC]-=amount;
 }
 
 static void PadBCD(unsigned char *n1, int amount)
 {
   #pragma MM_VAR n1
-  int i;
-  for (i=n1[BCD_LEN]+3;i>=3;i--) n1[i+amount]=n1[i];
-  for (i=3;i<(amount+3);i++) n1[i]=0;
+  int i,i_end,shift=amount>>1;
+
+  //Move the digits a byte at a time starting from the end so none are overwritten
+  //before they are read
+  i_end=BCD_BYTES(n1[BCD_LEN]+amount)+3;
+  if (amount&1)
+  {
+    for (i=i_end-1;i>shift+3;i--) n1[i]=(n1[i-shift-1]<<4)|(n1[i-shift]>>4);
+    n1[shift+3]=n1[3]>>4;
+  }
+  else
+  {
+    for (i=i_end-1;i>=shift+3;i--) n1[i]=n1[i-shift];
+  }
+  for (i=3;i<shift+3;i++) n1[i]=0;
   n1[BCD_LEN]+=amount;
   n1[BCD_DEC]+=amount;
 }
@@ -1064,18 +1257,64 @@ static bool IsZero(unsigned char *n1)
 {
   #pragma MM_VAR n1
   int i,i_end;
-  i_end=n1[BCD_LEN]+3;
+  i_end=(n1[BCD_LEN]>>1)+3;
   for (i=3;i<i_end;i++) if (n1[i]!=0) return false;
+  if ((n1[BCD_LEN]&1)&&(n1[i]&0xF0)) return false;
   return true;
 }
 
+static int TrailingZeros(const unsigned char *n1)
+{
+  #pragma MM_VAR n1
+  int i;
+  if (n1[BCD_LEN]!=n1[BCD_DEC]) return 0;
+  for (i=n1[BCD_LEN];i>1;i--) if (GetDigit(n1,i-1)) break;
+  return n1[BCD_LEN]-i;
+}
+
+static void ShiftDecBCD(unsigned char *n1, int amount)
+{
+  #pragma MM_VAR n1
+  int i,i_end;
+  i_end=n1[BCD_DEC]+amount;
+  for (i=n1[BCD_LEN];i<i_end;i++) SetDigit(n1,i,0);
+  if (i_end>n1[BCD_LEN]) n1[BCD_LEN]=i_end;
+  n1[BCD_DEC]=i_end;
+}
+
+//n1 is below 10^-FracZeros. The first known zeroes after the decimal point are skipped.
+static int FracZeros(const unsigned char *n1, int known)
+{
+  #pragma MM_VAR n1
+  int i=0;
+  if (known>0) i=n1[BCD_DEC]+known;
+  for (;i<n1[BCD_LEN];i++) if (GetDigit(n1,i)) return i-n1[BCD_DEC];
+  return MATH_CELL_SIZE*2;
+}
+
+static unsigned char GetDigit(const unsigned char *n1, int digit)
+{
+  #pragma MM_VAR n1
+  if (digit&1) return n1[(digit>>1)+3]&0xF;
+  else return n1[(digit>>1)+3]>>4;
+}
+
+static void SetDigit(unsigned char *n1, int digit, unsigned char value)
+{
+  #pragma MM_VAR n1
+  unsigned char b0;
+  b0=n1[(digit>>1)+3];
+  if (digit&1) n1[(digit>>1)+3]=(b0&0xF0)|value;
+  else n1[(digit>>1)+3]=(b0&0x0F)|(value<<4);
+}
+
 //see if using this in other places makes things smaller
 static void CopyBCD(unsigned char *dest, unsigned char *src)
 {
   #pragma MM_VAR dest
   #pragma MM_VAR src
   int i,i_end;
-  i_end=src[BCD_LEN]+3;
+  i_end=BCD_BYTES(src[BCD_LEN])+3;
   for (i=0;i<i_end;i++) dest[i]=src[i];
 }
 
@@ -1083,18 +1322,16 @@ static bool LnBCD(unsigned char *result, unsigned char *arg)
 {
   #pragma MM_VAR result
   #pragma MM_VAR arg
-  #pragma MM_VAR temp
-
-  #pragma MM_DECLARE
-    unsigned char temp[4];
-  #pragma MM_END
+  #pragma MM_VAR x
+  #pragma MM_VAR next_x
+  #pragma MM_VAR swap
 
   bool flip_sign=false;
   unsigned int i,j=1,k=0;
+  int zeros=0;
+  unsigned char *x=p1,*next_x=p0,*swap;
 
-  ImmedBCD("1",temp);
-
-  SubBCD(p1,arg,temp);
+  SubBCD(p1,arg,perm_one);
   if (IsZero(p1))
   {
     CopyBCD(result,perm_zero);
@@ -1102,7 +1339,7 @@ static bool LnBCD(unsigned char *result, unsigned char *arg)
   }
   else if (p1[BCD_SIGN]==1)
   {
-    DivBCD(p1,temp,arg);
+    DivBCD(p1,perm_one,arg);
     flip_sign=true;
   }
   else CopyBCD(p1,arg);
@@ -1111,7 +1348,7 @@ static bool LnBCD(unsigned char *result, unsigned char *arg)
   {
     RorBCD(p0,p1,j);
     CopyBCD(p1,p0);
-    SubBCD(p0,p1,temp);
+    SubBCD(p0,p1,perm_one);
     if (p0[BCD_SIGN]==1) break;
     j=1<<(k++);
   }
@@ -1123,28 +1360,27 @@ static bool LnBCD(unsigned char *result, unsigned char *arg)
   k=7-k;
   CopyBCD(result,logs+k*MATH_ENTRY_SIZE);
 
+  //Stop once 1-x is small enough for the last step to be exact
   for (i=k;i<Settings.LogTableSize;i++)
   {
+    if (zeros*2>=Settings.DecPlaces+2) break;
     if (j!=0)
     {
-      RolBCD(p0,p1,j);
-      SubBCD(p2,p0,temp);
+      RolBCD(next_x,x,j);
       j>>=1;
     }
-    else
-    {
-      RorBCD(p2,p1,i-7);
-      AddBCD(p0,p1,p2);
-      SubBCD(p2,p0,temp);
-    }
+    else ShiftAddBCD(next_x,x,x,i-7,false);
+    SubBCD(p2,next_x,perm_one);
     if (p2[BCD_SIGN]==1)
     {
-      CopyBCD(p1,p0);
-      SubBCD(p2,result,logs+i*MATH_ENTRY_SIZE);
-      CopyBCD(result,p2);
+      swap=x;
+      x=next_x;
+      next_x=swap;
+      SubBCD(result,result,logs+i*MATH_ENTRY_SIZE);
+      zeros=FracZeros(p2,zeros);
     }
   }
-  SubBCD(p2,temp,p1);
+  SubBCD(p2,perm_one,x);
   SubBCD(p0,result,p2);
   CopyBCD(result,p0);
   if (flip_sign) result[BCD_SIGN]=1;
@@ -1157,13 +1393,8 @@ static void ExpBCD(unsigned char *result, unsigned char *arg)
 {
   #pragma MM_VAR result
   #pragma MM_VAR arg
-  #pragma MM_VAR temp
-
-  #pragma MM_DECLARE
-    unsigned char temp[4];
-  #pragma MM_END
 
-  int i,j=128;
+  int i,j=128,zeros;
   unsigned int log_ptr=0;
   bool invert=false;
   if (arg[BCD_SIGN]==1)
@@ -1174,38 +1405,36 @@ static void ExpBCD(unsigned char *result, unsigned char *arg)
 
   if (CompVarBCD(perm_zero,arg)==COMP_EQ)
   {
-    ImmedBCD("1",result);
+    CopyBCD(result,perm_one);
     return;
   }
 
-  ImmedBCD("1",temp);
   CopyBCD(p0,arg);
-  CopyBCD(result,temp);
+  CopyBCD(result,perm_one);
+  //p0 is below 10^-zeros. Stop once the last step is exact and skip entries that are
+  //too big to subtract. Entry i is above 2^(6-i) and 0.31 is more than log10(2).
+  zeros=FracZeros(p0,0);
   for (i=0;i<Settings.LogTableSize;i++)
   {
-    SubBCD(p1,p0,logs+log_ptr);
-    if (p1[BCD_SIGN]==0)
+    if (zeros*2>=Settings.DecPlaces+2) break;
+    if ((i-6)*31>zeros*100)
     {
-      CopyBCD(p0,p1);
-      if (i<8)
-      {
-        RolBCD(p1,result,j);
-      }
-      else
+      SubBCD(p1,p0,logs+log_ptr);
+      if (p1[BCD_SIGN]==0)
       {
-        RorBCD(p2,result,i-7);
-        AddBCD(p1,result,p2);
+        CopyBCD(p0,p1);
+        if (i<8) RolBCD(result,result,j);
+        else ShiftAddBCD(result,result,result,i-7,false);
+        zeros=FracZeros(p0,zeros);
       }
-      CopyBCD(result,p1);
     }
     j>>=1;
     log_ptr+=MATH_ENTRY_SIZE;
   }
-  AddBCD(p1,p0,temp);
+  AddBCD(p1,p0,perm_one);
   MultBCD(p2,p1,result);
-  CopyBCD(p2,result);
 
-  if (invert) DivBCD(result,temp,p2);
+  if (invert) DivBCD(result,perm_one,p2);
   else CopyBCD(result,p2);
 }
 
@@ -1213,28 +1442,53 @@ static void RolBCD(unsigned char *result, unsigned char *arg, unsigned char amou
 {
   #pragma MM_VAR result
   #pragma MM_VAR arg
+  #pragma MM_VAR src
 
-  int i,i_end,j;
-  unsigned char b0,b1;
+  int i,i_end,extra,shift;
+  unsigned char b0=0,digit,low=0;
+  unsigned long carry;
+  unsigned char *src=arg;
 
-  CopyBCD(result,arg);
-  for (j=0;j<amount;j++)
+  i_end=arg[BCD_LEN];
+  result[BCD_SIGN]=arg[BCD_SIGN];
+  result[BCD_DEC]=arg[BCD_DEC];
+  if (amount==0) CopyBCD(result,arg);
+
+  while (amount)
   {
-    b1=0;
-    i_end=result[BCD_LEN]+2;
-    for (i=i_end;i>=3;i--)
-    {
-      b0=(result[i]<<1)+b1;
-      if (b0>9) b0+=6;
-      b1=b0>>4;
-      result[i]=(b0&0xF);
-    }
-    if (b1)
+    shift=amount;
+    if (shift>SCALE_BITS) shift=SCALE_BITS;
+    amount-=shift;
+
+    //Room for the digits carried out of the top. Kept even so digits stay in the same nibble.
+    extra=((shift*3)/10+2)&~1;
+
+    //Work up from the last digit, writing each digit extra places further right
+    carry=0;
+    for (i=i_end-1;i>=-extra;i--)
     {
-      PadBCD(result,1);
-      result[3]=1;
+      if (i>=0)
+      {
+        if ((i&1)||(i==i_end-1)) b0=src[(i>>1)+3];
+        if (i&1) digit=b0&0xF;
+        else digit=b0>>4;
+        carry+=(unsigned long)digit<<shift;
+      }
+      digit=carry%10;
+      carry/=10;
+      if ((i+extra)&1) low=digit;
+      else
+      {
+        if (i==i_end-1) low=0;
+        result[((i+extra)>>1)+3]=(digit<<4)|low;
+      }
     }
+    i_end+=extra;
+    result[BCD_LEN]=i_end;
+    result[BCD_DEC]=result[BCD_DEC]+extra;
+    src=result;
   }
+  FullShrinkBCD(result);
 }
 
 //Does shifting one bit add an extra 0?
@@ -1242,117 +1496,407 @@ static void RorBCD(unsigned char *result, unsigned char *arg, unsigned char amou
 {
   #pragma MM_VAR result
   #pragma MM_VAR arg
+  #pragma MM_VAR src
 
-  int i,i_end,j;
-  unsigned char b0,b1,b2;
-  unsigned char t1;
-
-  static const unsigned char table[]={
-  0,0,0,0, // 0/16
-  0,6,2,5, // 1/16
-  1,2,5,0, // 2/16
-  1,8,7,5, // 3/16
-  2,5,0,0, // 4/16
-  3,1,2,5, // 5/16
-  3,7,5,0, // 6/16
-  4,3,7,5, // 7/16
-  5,0,0,0, // 8/16
-  5,6,2,5};// 9/16
-
-  unsigned char accum[6];
+  int i,i_end,i_max,shift;
+  unsigned char b0=0,digit,high=0;
+  unsigned long rem;
+  unsigned char *src=arg;
 
-  CopyBCD(result,arg);
+  i_end=arg[BCD_LEN];
+  //Digits shifted in past the last decimal place are dropped
+  i_max=arg[BCD_DEC]+Settings.DecPlaces;
+  if (i_max<i_end) i_max=i_end;
+  result[BCD_SIGN]=arg[BCD_SIGN];
+  result[BCD_DEC]=arg[BCD_DEC];
+  if (amount==0) CopyBCD(result,arg);
 
   while (amount)
   {
-    if (amount>3)
+    shift=amount;
+    if (shift>SCALE_BITS) shift=SCALE_BITS;
+    amount-=shift;
+
+    //Long division by 2^shift from the first digit. Once the digits of the number
+    //run out, zeroes are brought down until nothing is left over.
+    rem=0;
+    for (i=0;i<i_max;i++)
     {
-      for (i=0;i<6;i++) accum[i]=0;
-      amount-=4;
-
-      t1=result[BCD_DEC];
-      b0=0;
-      i_end=result[BCD_LEN]+3;
-      for (i=3;i<i_end;i++)
+      if (i<i_end)
       {
-        b1=0;
-        b2=result[i]*4;
-        for (j=3;j>=-1;j--)
-        {
-          if (j>=0) accum[b0+j]+=table[b2+j]+b1;
-          else accum[b0+j]+=b1;
+        if ((i&1)==0) b0=src[(i>>1)+3];
+        if (i&1) digit=b0&0xF;
+        else digit=b0>>4;
+      }
+      else if (rem) digit=0;
+      else break;
+      rem=rem*10+digit;
+      digit=rem>>shift;
+      rem&=(1UL<<shift)-1;
+      if (i&1) result[(i>>1)+3]=high|digit;
+      else high=digit<<4;
+    }
+    if (i&1) result[(i>>1)+3]=high;
+    i_end=i;
+    result[BCD_LEN]=i_end;
+    src=result;
+  }
+  FullShrinkBCD(result);
+}
 
-          if (accum[b0+j]>9)
-          {
-            accum[b0+j]-=10;
-            b1=1;
-          }
-          else b1=0;
-        }
+static void ShiftAddBCD(unsigned char *result, unsigned char *n1, unsigned char *n2, int amount, bool subtract)
+{
+  #pragma MM_VAR result
+  #pragma MM_VAR n1
+  #pragma MM_VAR n2
 
-        if (b0!=2) b0++;
-        else
-        {
-          if (t1) result[i-2]=accum[0];
-          else result[i-1]=accum[0];
+  int i,w,w_start,dec,frac,q_frac,n1_dec,n1_len,n2_dec,n2_len;
+  int n1_cached=-1,n2_cached=-1;
+  unsigned char sign,t1,n1_byte=0,n2_byte=0,low=0,carry=0;
+  bool subtracting,zero=true;
+  unsigned long mult=1,q=0;
 
-          for (j=0;j<5;j++) accum[j]=accum[j+1];
-          accum[5]=0;
-        }
+  if (amount>SHIFT_ADD_BITS)
+  {
+    RorBCD(perm_buff1,n2,amount);
+    if (subtract) SubBCD(result,n1,perm_buff1);
+    else AddBCD(result,n1,perm_buff1);
+    return;
+  }
+
+  for (i=0;i<amount;i++) mult*=5;
+
+  sign=n1[BCD_SIGN];
+  subtracting=(sign!=(n2[BCD_SIGN]^subtract));
+  n1_len=n1[BCD_LEN];
+  n1_dec=n1[BCD_DEC];
+  n2_len=n2[BCD_LEN];
+  n2_dec=n2[BCD_DEC];
+
+  //n2/2^amount has amount more decimal places than n2. As in RorBCD, the ones past
+  //the last decimal place are dropped.
+  q_frac=n2_len-n2_dec;
+  if (q_frac<Settings.DecPlaces) q_frac=Settings.DecPlaces;
+  if (q_frac>n2_len-n2_dec+amount) q_frac=n2_len-n2_dec+amount;
+  frac=n1_len-n1_dec;
+  if (q_frac>frac) frac=q_frac;
+  dec=n1_dec;
+  if (n2_dec>dec) dec=n2_dec;
+
+  //Work up from the lowest place. n2*5^amount is worked out a digit at a time and each
+  //of its digits is the digit of n2/2^amount amount places further left.
+  w_start=-(n2_len-n2_dec+amount);
+  if (-frac<w_start) w_start=-frac;
+  for (w=w_start;w<dec;w++)
+  {
+    i=n2_dec-1-w-amount;
+    if ((i>=0)&&(i<n2_len))
+    {
+      if ((i>>1)!=n2_cached)
+      {
+        n2_cached=i>>1;
+        n2_byte=n2[n2_cached+3];
+      }
+      if (i&1) q+=(n2_byte&0xF)*mult;
+      else q+=(n2_byte>>4)*mult;
+    }
+    t1=q%10;
+    q/=10;
+    if (w<-frac) continue;
+
+    i=n1_dec-1-w;
+    if ((i>=0)&&(i<n1_len))
+    {
+      if ((i>>1)!=n1_cached)
+      {
+        n1_cached=i>>1;
+        n1_byte=n1[n1_cached+3];
       }
+      if (i&1) i=n1_byte&0xF;
+      else i=n1_byte>>4;
+    }
+    else i=0;
 
-      b1=result[BCD_LEN]+3;
-      if (t1)
+    if (subtracting)
+    {
+      if (i<t1+carry)
       {
-        t1--;
-        result[BCD_LEN]=b1;
-        result[BCD_DEC]=t1;
-        b2=i-b0;
+        t1=i+10-t1-carry;
+        carry=1;
       }
       else
       {
-        b1++;
-        result[3]=0;
-        result[BCD_LEN]=b1;
-        b2=i-b0+1;
+        t1=i-t1-carry;
+        carry=0;
       }
-      for (j=0;j<5;j++) result[j+b2]=accum[j];
-
-      if ((b1-t1)>Settings.DecPlaces) result[BCD_LEN]=t1+Settings.DecPlaces;
     }
     else
     {
-      amount--;
-      i_end=result[BCD_LEN]+3;
-      b1=0;
-      for (i=3;i<i_end;i++)
+      t1=i+t1+carry;
+      if (t1>9)
       {
-        b0=result[i];
-        b2=b0;
-        b0=(b0>>1)+b1;
-        b1=0;
-        if (b2&1) b1=8;
-        if (b0>7) b0-=3;
-        result[i]=b0;
+        t1-=10;
+        carry=1;
       }
-      if (b1)
+      else carry=0;
+    }
+    if (t1) zero=false;
+
+    i=dec-1-w;
+    if (i&1) low=t1;
+    else
+    {
+      result[(i>>1)+3]=(t1<<4)|low;
+      low=0;
+    }
+  }
+
+  result[BCD_LEN]=dec+frac;
+  result[BCD_DEC]=dec;
+  if (carry)
+  {
+    if (subtracting)
+    {
+      //n2/2^amount was larger so the digits are the ten's complement of the answer
+      carry=1;
+      for (i=dec+frac-1;i>=0;i--)
       {
-        if((result[BCD_LEN]-result[BCD_DEC])<Settings.DecPlaces)
-        {
-          b1=result[BCD_LEN]+1;
-          result[BCD_LEN]=b1;
-          result[b1+2]=5;
-        }
+        t1=9-GetDigit(result,i)+carry;
+        if (t1==10) t1=0;
+        else carry=0;
+        SetDigit(result,i,t1);
       }
+      sign=!sign;
+    }
+    else
+    {
+      PadBCD(result,1);
+      SetDigit(result,0,1);
     }
   }
+  if (zero) sign=0;
+  result[BCD_SIGN]=sign;
+  if (n2_dec>n1_dec) FullShrinkBCD(result);
 }
 
-static void PowBCD(unsigned char *result, unsigned char *base, unsigned char *exp)
+static bool PowBCD(unsigned char *result, unsigned char *base, unsigned char *exp)
 {
+  #pragma MM_VAR result
+  #pragma MM_VAR base
+  #pragma MM_VAR exp
+
+  int i,places,guard=0;
+  unsigned long n=0,m;
+  unsigned char sign;
+  bool whole=true;
+
+  //Integer exponents are done by squaring, which is exact for integer bases and
+  //handles negative bases. Anything else goes through ln and exp.
+  if (exp[BCD_DEC]>POW_INT_DIGITS) whole=false;
+  for (i=0;(i<exp[BCD_LEN])&&whole;i++)
+  {
+    if (i<exp[BCD_DEC]) n=n*10+GetDigit(exp,i);
+    else if (GetDigit(exp,i)) whole=false;
+  }
+
+  if (whole)
+  {
+    //Every product of a base with decimal places is rounded and the squaring makes the
+    //error grow with n, so they are worked out with two more places than n has digits
+    //and only the answer is rounded.
+    if (base[BCD_LEN]>base[BCD_DEC])
+    {
+      for (m=n;m;m/=10) guard++;
+      guard+=2;
+    }
+    places=Settings.DecPlaces;
+    Settings.DecPlaces=places+guard;
+    m=PowIntBCD(result,base,n);
+    Settings.DecPlaces=places;
+
+    //The guard places can make a large power too long for a cell. The rounding matters
+    //much less there than the room, so it is worked out again without them.
+    if ((m)&&(guard)) m=PowIntBCD(result,base,n);
+
+    if (m==0)
+    {
+      //Multiplying by one rounds to DecPlaces
+      if (result[BCD_LEN]-result[BCD_DEC]>places)
+      {
+        MultBCD(p4,result,perm_one);
+        CopyBCD(result,p4);
+      }
+      if (exp[BCD_SIGN])
+      {
+        DivBCD(p4,perm_one,result);
+        CopyBCD(result,p4);
+      }
+      return true;
+    }
+  }
+
   LnBCD(p3,base);
   MultBCD(p4,p3,exp);
+
+  //ExpBCD is only good up to the sum of the log table, the same limit the e^x key has.
+  //Below -177 the answer is under 10^-76 so it is left as zero.
+  sign=p4[BCD_SIGN];
+  p4[BCD_SIGN]=0;
+  if (CompBCD("177",p4)==COMP_LT)
+  {
+    if (sign==0) return false;
+    CopyBCD(result,perm_zero);
+    return true;
+  }
+  p4[BCD_SIGN]=sign;
   ExpBCD(result,p4);
+  return true;
+}
+
+static unsigned long PowIntBCD(unsigned char *result, unsigned char *base, unsigned long n)
+{
+  #pragma MM_VAR result
+  #pragma MM_VAR base
+
+  //MultBCD works out every digit of the product before cutting it to DecPlaces and
+  //rounding can carry into one more, so both numbers together have to fit in one
+  //cell. If they don't, n is left over.
+  CopyBCD(result,perm_one);
+  CopyBCD(p3,base);
+  while (n)
+  {
+    if (n&1)
+    {
+      if (result[BCD_LEN]+p3[BCD_LEN]+1>MATH_MAX_DIGITS) break;
+      MultBCD(p4,result,p3);
+      CopyBCD(result,p4);
+    }
+    n>>=1;
+    if (n)
+    {
+      if (p3[BCD_LEN]*2+1>MATH_MAX_DIGITS) break;
+      MultBCD(p4,p3,p3);
+      CopyBCD(p3,p4);
+    }
+  }
+  return n;
+}
+
+static void SqrtBCD(unsigned char *result, unsigned char *arg)
+{
+  #pragma MM_VAR result
+  #pragma MM_VAR arg
+
+  int i,j,i_end,start,width;
+  int whole,digits,arg_ptr;
+  unsigned char d,t1,t2,carry;
+
+  //Every digit of the root comes from one pair of digits of the argument, with the
+  //pairs lined up on the decimal point. One extra decimal place is kept for rounding.
+  whole=(arg[BCD_DEC]+1)>>1;
+  digits=whole+Settings.DecPlaces+1;
+  arg_ptr=-(arg[BCD_DEC]&1);
+
+  //perm_buff1 holds the remainder and perm_buff2 holds 20*root+2*d+1, the next odd
+  //number to try subtracting from it. Both are right aligned in width digits.
+  width=digits+2;
+  i_end=BCD_BYTES(width)+3;
+  for (i=3;i<i_end;i++)
+  {
+    perm_buff1[i]=0;
+    perm_buff2[i]=0;
+  }
+  SetDigit(perm_buff2,width-1,1);
+
+  result[BCD_SIGN]=0;
+  result[BCD_LEN]=digits;
+  result[BCD_DEC]=whole;
+
+  for (i=0;i<digits;i++)
+  {
+    //Neither number is longer than i+3 digits at this point
+    start=width-i-3;
+
+    //Bring down the next two digits of the argument
+    for (j=start;j<width-2;j++) SetDigit(perm_buff1,j,GetDigit(perm_buff1,j+2));
+    for (j=width-2;j<width;j++)
+    {
+      if ((arg_ptr>=0)&&(arg_ptr<arg[BCD_LEN])) SetDigit(perm_buff1,j,GetDigit(arg,arg_ptr));
+      else SetDigit(perm_buff1,j,0);
+      arg_ptr++;
+    }
+
+    d=0;
+    for (;;)
+    {
+      //Stop when the remainder is less than the odd number
+      for (j=start;j<width;j++)
+      {
+        t1=GetDigit(perm_buff1,j);
+        t2=GetDigit(perm_buff2,j);
+        if (t1!=t2) break;
+      }
+      if ((j<width)&&(t1<t2)) break;
+
+      carry=0;
+      for (j=width-1;j>=start;j--)
+      {
+        t1=GetDigit(perm_buff1,j);
+        t2=GetDigit(perm_buff2,j)+carry;
+        if (t1<t2)
+        {
+          SetDigit(perm_buff1,j,t1+10-t2);
+          carry=1;
+        }
+        else
+        {
+          SetDigit(perm_buff1,j,t1-t2);
+          carry=0;
+        }
+      }
+
+      carry=2;
+      for (j=width-1;carry;j--)
+      {
+        t1=GetDigit(perm_buff2,j)+carry;
+        if (t1>9)
+        {
+          SetDigit(perm_buff2,j,t1-10);
+          carry=1;
+        }
+        else
+        {
+          SetDigit(perm_buff2,j,t1);
+          carry=0;
+        }
+      }
+      d++;
+    }
+    SetDigit(result,i,d);
+
+    //20*root+1 for the next digit is ten times the last odd number tried, minus 9
+    SetDigit(perm_buff2,width-1,GetDigit(perm_buff2,width-1)-1);
+    for (j=start;j<width-1;j++) SetDigit(perm_buff2,j,GetDigit(perm_buff2,j+1));
+    SetDigit(perm_buff2,width-1,1);
+  }
+
+  if (GetDigit(result,digits-1)>4)
+  {
+    i_end=BCD_BYTES(digits-1)+3;
+    for (i=3;i<i_end;i++) perm_buff3[i]=result[i];
+    perm_buff3[BCD_SIGN]=0;
+    perm_buff3[BCD_LEN]=digits-1;
+    perm_buff3[BCD_DEC]=digits-1;
+    perm_buff1[BCD_SIGN]=0;
+    perm_buff1[BCD_LEN]=1;
+    perm_buff1[BCD_DEC]=1;
+    perm_buff1[3]=0x10;
+    AddBCD(result,perm_buff3,perm_buff1);
+    result[BCD_DEC]=whole;
+    if (result[BCD_LEN]==digits) result[BCD_DEC]+=1;
+  }
+  else result[BCD_LEN]-=1;
+  FullShrinkBCD(result);
 }
 
 static void TanBCD(unsigned char *sine_result,unsigned char *cos_result,unsigned char *arg)
@@ -1373,10 +1917,8 @@ static void AcosBCD(unsigned char *result,unsigned char *arg)
 {
   CopyBCD(p0,arg);
   MultBCD(p1,p0,arg);
-  ImmedBCD("1",p0);
-  SubBCD(p5,p0,p1);
-  ImmedBCD("0.5",p6);
-  PowBCD(p7,p5,p6);
+  SubBCD(p5,perm_one,p1);
+  SqrtBCD(p7,p5);
   DivBCD(p6,p7,arg);
   AtanBCD(result,p6);
 }
@@ -1385,10 +1927,8 @@ static void AsinBCD(unsigned char *result,unsigned char *arg)
 {
   CopyBCD(p0,arg);
   MultBCD(p1,p0,arg);
-  ImmedBCD("1",p0);
-  SubBCD(p5,p0,p1);
-  ImmedBCD("0.5",p6);
-  PowBCD(p7,p5,p6);
+  SubBCD(p5,perm_one,p1);
+  SqrtBCD(p7,p5);
   DivBCD(p6,arg,p7);
   AtanBCD(result,p6);
 }
@@ -1398,7 +1938,7 @@ static void AtanBCD(unsigned char *result,unsigned char *arg)
   #pragma MM_VAR result
 
   CopyBCD(result,perm_zero);
-  ImmedBCD("1",p2);
+  CopyBCD(p2,perm_one);
   CopyBCD(p3,arg);
   CalcTanBCD(p2,p3,result,arg,1);
 
@@ -1409,39 +1949,82 @@ static void AtanBCD(unsigned char *result,unsigned char *arg)
 
 static void CalcTanBCD(unsigned char *result1,unsigned char *result2,unsigned char *result3,unsigned char *arg,unsigned char flag)
 {
+  #pragma MM_VAR result1
   #pragma MM_VAR result2
+  #pragma MM_VAR x
+  #pragma MM_VAR y
+  #pragma MM_VAR next_x
+  #pragma MM_VAR next_y
+  #pragma MM_VAR temp
 
   unsigned int i;
   unsigned int trig_ptr=0;
+  bool up;
+  //x and y are worked out into the spare buffer and the pointers swapped instead of copying back
+  unsigned char *x=result1,*y=result2,*next_x=p1,*next_y=p0,*temp;
 
   //function pointers could reduce flash size
   for (i=0;i<Settings.TrigTableSize;i++)
   {
-    if (flag==0) SubBCD(p1,arg,result3);
-
-    if (((flag==0)&&(p1[BCD_SIGN]==0))||((flag==1)&&(result2[BCD_SIGN]==0)))
+    if (flag==0)
     {
-      RorBCD(p0,result2,i);
-      AddBCD(p1,result1,p0);
-      RorBCD(p0,result1,i);
-      CopyBCD(result1,p1);
-      SubBCD(p1,result2,p0);
-      CopyBCD(result2,p1);
-      AddBCD(p0,result3,trig+trig_ptr);
+      SubBCD(next_x,arg,result3);
+      #ifdef CORDIC_TAIL
+        //Small angles are done by the linear step alone, before perm_K has been used
+        if ((i==0)&&(FracZeros(next_x,0)*2>=Settings.DecPlaces+2))
+        {
+          CopyBCD(y,perm_one);
+          break;
+        }
+      #endif
+      up=(next_x[BCD_SIGN]==0);
     }
     else
     {
-      RorBCD(p0,result2,i);
-      SubBCD(p1,result1,p0);
-      RorBCD(p0,result1,i);
-      CopyBCD(result1,p1);
-      AddBCD(p1,result2,p0);
-      CopyBCD(result2,p1);
-      SubBCD(p0,result3,trig+trig_ptr);
+      #ifdef CORDIC_TAIL
+        //x is at least 1 so atan(y/x) is close enough to y/x
+        if (FracZeros(y,0)*3>=Settings.DecPlaces+3) break;
+      #endif
+      up=(y[BCD_SIGN]==0);
     }
-    CopyBCD(result3,p0);
+
+    ShiftAddBCD(next_x,x,y,i,!up);
+    ShiftAddBCD(next_y,y,x,i,up);
+    if (up) AddBCD(result3,result3,trig+trig_ptr);
+    else SubBCD(result3,result3,trig+trig_ptr);
+
+    temp=x;
+    x=next_x;
+    next_x=temp;
+    temp=y;
+    y=next_y;
+    next_y=temp;
     trig_ptr+=MATH_ENTRY_SIZE;
   }
+
+  #ifdef CORDIC_TAIL
+    if (flag==0)
+    {
+      //Rotate by the rest of the angle in radians, t, with x+y*t and y-x*t
+      SubBCD(next_x,arg,result3);
+      DivBCD(result3,next_x,perm_deg);
+      MultBCD(next_x,y,result3);
+      MultBCD(next_y,x,result3);
+      AddBCD(x,x,next_x);
+      SubBCD(y,y,next_y);
+      CopyBCD(result3,arg);
+    }
+    else
+    {
+      //The rest of the angle is atan(y/x), or y/x radians
+      MultBCD(next_y,y,perm_deg);
+      DivBCD(next_x,next_y,x);
+      AddBCD(result3,result3,next_x);
+    }
+  #endif
+
+  if (x!=result1) CopyBCD(result1,x);
+  if (y!=result2) CopyBCD(result2,y);
 }
 
 static unsigned char CompBCD(const char *num, unsigned char *var)
@@ -1452,10 +2035,65 @@ static unsigned char CompBCD(const char *num, unsigned char *var)
 
 static unsigned char CompVarBCD(unsigned char *var1, unsigned char *var2)
 {
-  SubBCD(p1,var1,var2);
-  if (IsZero(p1)) return COMP_EQ;
-  else if (p1[BCD_SIGN]==0) return COMP_GT;
-  else return COMP_LT;
+  #pragma MM_VAR var1
+  #pragma MM_VAR var2
+
+  int i,w,w_end,len1,len2,dec1,dec2;
+  int cached1=-1,cached2=-1;
+  unsigned char sign,d1,d2,byte1=0,byte2=0;
+
+  sign=var1[BCD_SIGN];
+  if (sign!=var2[BCD_SIGN])
+  {
+    if (IsZero(var1)&&IsZero(var2)) return COMP_EQ;
+    else if (sign==0) return COMP_GT;
+    else return COMP_LT;
+  }
+
+  len1=var1[BCD_LEN];
+  dec1=var1[BCD_DEC];
+  len2=var2[BCD_LEN];
+  dec2=var2[BCD_DEC];
+
+  //Line up the decimal places and compare from the highest place down. Leading and
+  //trailing zeroes are compared like any other digit.
+  w=dec1;
+  if (dec2>w) w=dec2;
+  w_end=dec1-len1;
+  if ((dec2-len2)<w_end) w_end=dec2-len2;
+  for (w--;w>=w_end;w--)
+  {
+    d1=0;
+    i=dec1-1-w;
+    if ((i>=0)&&(i<len1))
+    {
+      if ((i>>1)!=cached1)
+      {
+        cached1=i>>1;
+        byte1=var1[cached1+3];
+      }
+      if (i&1) d1=byte1&0xF;
+      else d1=byte1>>4;
+    }
+    d2=0;
+    i=dec2-1-w;
+    if ((i>=0)&&(i<len2))
+    {
+      if ((i>>1)!=cached2)
+      {
+        cached2=i>>1;
+        byte2=var2[cached2+3];
+      }
+      if (i&1) d2=byte2&0xF;
+      else d2=byte2>>4;
+    }
+    if (d1!=d2)
+    {
+      if ((d1>d2)==(sign==0)) return COMP_GT;
+      else return COMP_LT;
+    }
+  }
+  return COMP_EQ;
 }
 
 //convert angle to 0-90 format and put in p3
@@ -1466,16 +2104,16 @@ static unsigned char TrigPrep(unsigned int stack_ptr_copy,unsigned char *cosine)
   if (Settings.DegRad) CopyBCD(p3,BCD_stack+(stack_ptr_copy-1)*MATH_CELL_SIZE);
   else
   {
-    ImmedBCD(deg_factor,p0);
-    MultBCD(p3,BCD_stack+(stack_ptr_copy-1)*MATH_CELL_SIZE,p0);
+    //Radians are reduced first so the multiply doesn't carry the whole turns
+    ModBCD(p2,BCD_stack+(stack_ptr_copy-1)*MATH_CELL_SIZE,perm_2pi);
+    MultBCD(p3,p2,perm_deg);
   }
 
-  ImmedBCD("360",p2);
-  while(CompVarBCD(p3,p2)==COMP_GT) CopyBCD(p3,p1);
+  ModBCD(p3,p3,perm_360);
 
-  if (CompBCD("180",p3)==COMP_LT)
+  if (CompVarBCD(perm_180,p3)==COMP_LT)
   {
-    SubBCD(stack_buffer,p2,p3);
+    SubBCD(stack_buffer,perm_360,p3);
     sine=1;
   }
   else
@@ -1483,10 +2121,9 @@ static unsigned char TrigPrep(unsigned int stack_ptr_copy,unsigned char *cosine)
     CopyBCD(stack_buffer,p3);
     sine=0;
   }
-  if (CompBCD("90",stack_buffer)==COMP_LT)
+  if (CompVarBCD(perm_90,stack_buffer)==COMP_LT)
   {
-    ImmedBCD("180",p2);
-    SubBCD(p3,p2,stack_buffer);
+    SubBCD(p3,perm_180,stack_buffer);
     *cosine=1;
   }
   else
@@ -0,0 +1,71 @@
+/**   RPN Scientific Calculator for MSP430
+ *    Copyright (C) 2014 Joey Shepard
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+//Stand-in for the TI header when rpnslave.c is built by rpnslave_emu.c.
+//Registers the slave only configures are plain variables. The UART,
+//the SPI shift registers for the SRAM address and the SRAM control pins
+//go through functions in rpnslave_emu.c so the slave code runs unchanged.
+
+#ifndef EMU_MSP430_H
+#define EMU_MSP430_H
+
+#define BIT0 0x01
+#define BIT1 0x02
+#define BIT2 0x04
+#define BIT3 0x08
+#define BIT4 0x10
+#define BIT5 0x20
+#define BIT6 0x40
+#define BIT7 0x80
+
+#define WDTPW     0x5A00
+#define WDTHOLD   0x0080
+#define UCSWRST   0x01
+#define UCSSEL_2  0x80
+#define UCBRS_5   0x0A
+#define UCCKPL    0x40
+#define UCMST     0x08
+#define UCSYNC    0x01
+#define UCA0RXIFG 0x01
+#define UCA0TXIFG 0x02
+#define LPM3_bits 0xD0
+
+extern unsigned int WDTCTL;
+extern unsigned char BCSCTL1, DCOCTL, CALBC1_16MHZ, CALDCO_16MHZ;
+extern unsigned char UCA0CTL0, UCA0CTL1, UCA0MCTL, UCA0BR0, UCA0BR1;
+extern unsigned char UCB0CTL0, UCB0CTL1, UCB0BR0, UCB0BR1;
+extern unsigned char P1SEL, P1SEL2, P1DIR, P2SEL, P2SEL2, P2DIR, P2OUT;
+
+unsigned char EmuIFG();
+unsigned char *EmuTXBUF();
+unsigned char EmuRXBUF();
+unsigned char *EmuSPI();
+unsigned char *EmuP1OUT();
+unsigned char EmuP2IN();
+
+#define UC0IFG    EmuIFG()
+#define UCA0TXBUF (*EmuTXBUF())
+#define UCA0RXBUF EmuRXBUF()
+#define UCB0TXBUF (*EmuSPI())
+#define P1OUT     (*EmuP1OUT())
+#define P2IN      EmuP2IN()
+
+#define __delay_cycles(x)
+#define __enable_interrupt()
+#define _BIS_SR(x)
+
+#endif
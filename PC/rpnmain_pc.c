@@ -21,6 +21,61 @@
 #define WINDOWS
 //#define LINUX
 
+//Read RPN expressions from stdin, or the file named on the command line, instead of the
+//keyboard. The result of each line is printed to stdout and nothing is drawn.
+//#define BATCH
+
+//Give each calculator its own copy of the variables in external RAM so several can run
+//side by side. MemMap already moves them into the memory of each context, so comment this
+//out before running the file through it.
+#define CONTEXT_RAM
+
+//Do the work of AddBCD, MultBCD and DivBCD on 32-bit limbs of 9 decimal digits
+//instead of one digit at a time. Numbers are still stored as packed BCD.
+#define LIMB_MATH
+
+//Run the CORDIC routines over half of the tables and finish with one linear step on what
+//is left. Past that point the error of the linear step is below the last decimal place.
+#define CORDIC_TAIL
+
+//Calculate ln, e^x, y^x and the trig functions at a few more decimal places than needed and
+//round. If the extra digits are too close to halfway to be sure which way to round, try
+//again with more of them.
+#define ZIV_ROUND
+
+//Keep the last MEMO_ENTRIES results of ln, e^x, y^x and the trig functions with the
+//operands and settings they came from. Working one out again is only a lookup.
+#define MEMO_CACHE
+
+//Calculate ln, e^x, y^x, square roots and trig functions with the C math library when
+//there are DOUBLE_MAX_PLACES decimal places or fewer. Results that can't be rounded
+//correctly from a double are calculated in BCD instead.
+//#define DOUBLE_MATH
+
+//Time the math routines at several precisions instead of running the calculator.
+//Results are written to stdout as CSV. Run the file through the MemMap preprocessor
+//first to also count reads and writes of external RAM.
+//#define BENCHMARK
+
+#ifdef BENCHMARK
+  #include <stdlib.h>
+  #include <time.h>
+#endif
+
+#ifdef BATCH
+  #include <string.h>
+#endif
+
+#ifdef ZIV_ROUND
+  #include <stdlib.h>
+#endif
+
+#ifdef DOUBLE_MATH
+  #include <stdlib.h>
+  #include <float.h>
+  #include <math.h>
+#endif
+
 #ifdef WINDOWS
   #include <windows.h>
 
@@ -49,36 +104,62 @@
   //#define KEY_DOWN      KEY_DOWN
   //#define KEY_UP        KEY_UP
 
-  #define printf printw
-  #define putchar addch
+  #ifndef BATCH
+    #define printf printw
+    #define putchar addch
+  #endif
 #endif
 
 #define SCREEN_WIDTH 20
 
 //Offsets for the first three bytes of every BCD number holding information.
-//The fourth byte onward is unpacked BCD.
+//The fourth byte onward is packed BCD, two digits per byte with the first digit
+//in the high nibble. The low nibble of the last byte is unused when BCD_LEN is odd.
 #define BCD_SIGN 0//0 for positive and 1 for negative
-#define BCD_LEN  1//The length of the entire number
+#define BCD_LEN  1//The length of the entire number in digits
 #define BCD_DEC  2//Decimal place. Always smaller or equal to BCD_LEN.
 
+//Number of bytes needed to hold a given number of packed digits
+#define BCD_BYTES(x) (((x)+1)>>1)
+
 //Maximum stack size. Can be changed to be much bigger.
 #define STACK_SIZE 10
 
 //Maximum number of bytes needed for a BCD number
-#define MATH_CELL_SIZE 260
+//3 bytes for info, 128 bytes for 255 packed digits and one spare byte
+#define MATH_CELL_SIZE 132
+//Most digits a BCD number can have since BCD_LEN is one byte
+#define MATH_MAX_DIGITS 255
 //Size of elements in the trig and log table
-//3 bytes for info, 2 for whole number part, 32 decimal places
-#define MATH_ENTRY_SIZE 37
-//Number of entries in the CORDIC log table
+//3 bytes for info, 49 bytes for 2 whole number digits and 96 decimal places
+#define MATH_ENTRY_SIZE 52
+//Number of entries in the built in CORDIC log table
 #define MATH_LOG_TABLE 114
-//Number of entries in the CORDIC trig table
+//Number of entries in the built in CORDIC trig table
 #define MATH_TRIG_TABLE 113
+//Decimal places the built in tables and constants are good for
+#define MATH_TABLE_PLACES 32
+//Most decimal places that can be set. Tables this precise are generated the first time
+//more than MATH_TABLE_PLACES are set. Products of two numbers this long still fit in a cell.
+#define MATH_MAX_PLACES 96
+//Digits in a generated table entry
+#define MATH_TABLE_DIGITS 98
+//Room for entries in the generated tables. Entries past these are zero at MATH_MAX_PLACES.
+#define MATH_LOG_MAX 330
+#define MATH_TRIG_MAX 330
+//Extra decimal places used while generating the tables
+#define MATH_GUARD_PLACES 6
+//Generated tables are saved here and loaded on later runs
+#define MATH_TABLE_FILE "rpn_tables.txt"
+//Constants saved after the tables: perm_K, perm_log10, perm_2pi, perm_deg and perm_pi
+#define MATH_TABLE_CONSTS 5
 
 //Starting point for CORDIC trig calculations
 #define K             "0.60725293500888125616944675250493"
 //Conversion factor for log10 and natural logs
 #define log10_factor  "2.30258509299404568401799145468437"
 #define pi            "3.1415926535897932384626433832795"
+#define two_pi        "6.283185307179586476925286766559006"
 #define pi2           "1.57079632679489661923132169163975"
 //Degree to radians conversion factor
 #define rad_factor    "0.01745329251994329576923690768489"
@@ -90,6 +171,51 @@
 #define COMP_LT 1//Less than
 #define COMP_EQ 2//Equal to
 
+//Most bits RolBCD and RorBCD shift by in one pass over a number. What is carried from
+//one digit to the next needs 4 more bits than this.
+#define SCALE_BITS 60
+
+//Most bits ShiftAddBCD shifts by in one pass. 10*5^SHIFT_ADD_BITS has to fit in 64 bits.
+#define SHIFT_ADD_BITS 26
+
+//Integer exponents with up to this many digits are done by squaring in PowBCD
+#define POW_INT_DIGITS 9
+
+//Table entries used past the halfway point before the linear step of CORDIC_TAIL
+#define CORDIC_TAIL_EXTRA 2
+
+#ifdef ZIV_ROUND
+  //Extra decimal places for the first try of ZivBCD. Each retry at least doubles them.
+  #define ZIV_GUARD_PLACES 3
+  //Most ExpBCD can be off by for results below 10, in units of its last decimal place
+  #define ZIV_ERROR        20
+#endif
+
+#ifdef MEMO_CACHE
+  //Results kept by MemoBCD
+  #define MEMO_ENTRIES 16
+#endif
+
+#ifdef DOUBLE_MATH
+  //Most decimal places DoubleBCD will try to round a double to
+  #define DOUBLE_MAX_PLACES 15
+  //Relative error allowed for each double input and for the math library result
+  #define DOUBLE_ARG_ERROR  (4*DBL_EPSILON)
+  #define DOUBLE_LIB_ERROR  (8*DBL_EPSILON)
+#endif
+
+#ifdef LIMB_MATH
+  //Each limb holds 9 decimal digits. Limbs are stored least significant first.
+  #define LIMB_BASE   1000000000UL
+  #define LIMB_DIGITS 9
+  //Enough limbs for the longest dividend DivBCD can build
+  #define LIMB_MAX    96
+  //Numbers with at least this many limbs are multiplied with Karatsuba
+  #define LIMB_KARATSUBA 8
+  //Divisors with at least this many limbs are divided by multiplying with their reciprocal
+  #define LIMB_NEWTON    12
+#endif
+
 //#pragmas beginning with MM_ are interpretted by my preprocessor.
 //They should be ignored by the compiler.
 //Function to use to access variables stored in external RAM
@@ -99,132 +225,326 @@
 //Enable preprocessing of code
 #pragma MM_ON
 
+//State of one calculator. Declared below.
+struct CalcContext;
+
 //Set cursor blink
 static void SetBlink(bool status);
 //Set text color
 static void SetColor(bool black);
 //Position text cursor
 static void gotoxy(short x, short y);
-//Clear screen
-static void clrscr();
-//Get input from keyboard
-static int GetKey();
+#ifndef BATCH
+  //Clear screen
+  static void clrscr();
+#endif
+//Get input from keyboard. Only batch mode uses the context.
+static int GetKey(struct CalcContext *ctx);
 
-//Reads data from external RAM. Simulated on the PC with the array "memory" declared below.
-static unsigned char RAM_Read(const unsigned char *a1);
-//Writes data from external RAM. Simulated on the PC with the array "memory" declared below.
-static void RAM_Write(const unsigned char *a1, const unsigned char byte);
+//Reads data from external RAM. Simulated on the PC with the array "memory" in the context.
+static unsigned char CalcRead(struct CalcContext *ctx, const unsigned char *a1);
+//Writes data from external RAM. Simulated on the PC with the array "memory" in the context.
+static void CalcWrite(struct CalcContext *ctx, const unsigned char *a1, const unsigned char byte);
+//MemMap writes RAM_Read and RAM_Write without a context. They use the ctx of the function they are in.
+#define RAM_Read(a1)       CalcRead(ctx,a1)
+#define RAM_Write(a1,byte) CalcWrite(ctx,a1,byte)
 
 //Add two BCD numbers. result should not be the same as n1 or n2.
-static void AddBCD(unsigned char *result, const unsigned char *n1, const unsigned char *n2);
+static void AddBCD(struct CalcContext *ctx, unsigned char *result, const unsigned char *n1, const unsigned char *n2);
 //Subtract two BCD numbers. n2 may be modified during operation.
-static void SubBCD(unsigned char *result, const unsigned char *n1, unsigned char *n2);
+static void SubBCD(struct CalcContext *ctx, unsigned char *result, const unsigned char *n1, unsigned char *n2);
 //Convert a string in internal memory into a BCD number
-static void ImmedBCD(const char *text, unsigned char *BCD);
+static void ImmedBCD(struct CalcContext *ctx, const char *text, unsigned char *BCD);
 //Convert a string in external memory into a BCD number
-static void BufferBCD(const unsigned char *text, unsigned char *BCD);
+static void BufferBCD(struct CalcContext *ctx, const unsigned char *text, unsigned char *BCD);
 //Print a BCD number
-static void PrintBCD(const unsigned char *BCD, int dec_point);
+static void PrintBCD(struct CalcContext *ctx, const unsigned char *BCD, int dec_point);
 //Multiply two BCD numbers
-static void MultBCD(unsigned char *result, const unsigned char *n1, const unsigned char *n2);
+static void MultBCD(struct CalcContext *ctx, unsigned char *result, const unsigned char *n1, const unsigned char *n2);
+//Digits MultBCD needs room for to multiply two BCD numbers
+static int MultDigits(struct CalcContext *ctx, const unsigned char *n1, const unsigned char *n2);
 //Divide two BCD numbers
-static void DivBCD(unsigned char *result, const unsigned char *n1, const unsigned char *n2);
-//Remove one leading zero from a BCD number
-static void ShrinkBCD(unsigned char *dest,unsigned char *src);
+static void DivBCD(struct CalcContext *ctx, unsigned char *result, const unsigned char *n1, const unsigned char *n2);
+//Remainder of n1/n2 with the sign of n1
+static void ModBCD(struct CalcContext *ctx, unsigned char *result, unsigned char *n1, unsigned char *n2);
 //Remove all leading zeroes from a BCD number
-static void FullShrinkBCD(unsigned char *n1);
+static void FullShrinkBCD(struct CalcContext *ctx, unsigned char *n1);
 //Add a leading zero to a BCD number
-static void PadBCD(unsigned char *n1, int amount);
+static void PadBCD(struct CalcContext *ctx, unsigned char *n1, int amount);
 //Check if a BCD number is equal to zero
-static bool IsZero(unsigned char *n1);
+static bool IsZero(struct CalcContext *ctx, unsigned char *n1);
+//Number of zeroes at the end of a whole number. Numbers with decimal places have none.
+static int TrailingZeros(struct CalcContext *ctx, const unsigned char *n1);
+//Position just past the last non-zero digit of a BCD number. Zero returns 0. Scanned
+//a byte at a time like LeadDigit.
+static int TrailDigit(struct CalcContext *ctx, const unsigned char *n1);
+//Multiply a BCD number by 10^amount by moving the decimal point. The caller makes sure
+//the result fits in a cell.
+static void ShiftDecBCD(struct CalcContext *ctx, unsigned char *n1, int amount);
+//Number of zeroes after the decimal point before the first non-zero digit. n1 is below
+//10^-FracZeros. Numbers of 1 or more return 0 or less and zero returns a large number.
+//The first known zeroes after the decimal point are not read again.
+static int FracZeros(struct CalcContext *ctx, const unsigned char *n1, int known);
+//Read one digit of a BCD number. Digit 0 is the most significant.
+static unsigned char GetDigit(struct CalcContext *ctx, const unsigned char *n1, int digit);
+//Write one digit of a BCD number
+static void SetDigit(struct CalcContext *ctx, unsigned char *n1, int digit, unsigned char value);
 //Copy a BCD number from one location in external RAM to another location in external RAM
-static void CopyBCD(unsigned char *dest, unsigned char *src);
+static void CopyBCD(struct CalcContext *ctx, unsigned char *dest, unsigned char *src);
 //Unpack trig and log tables and write them to an array in RAM
-static void MakeTables();
+static void MakeTables(struct CalcContext *ctx);
+//Find the first non-zero digit of every table entry for SetDecPlaces
+static void FindLeads(struct CalcContext *ctx);
+//Sum of x^n/n for odd n. Gives artanh(x), or atan(x) if the signs alternate.
+static void SeriesBCD(struct CalcContext *ctx, unsigned char *result, unsigned char *x, bool alternate);
+//Round a BCD number to len digits with dec whole number digits
+static void FixBCD(struct CalcContext *ctx, unsigned char *dest, const unsigned char *src, int dec, int len);
+//Position of the first non-zero digit of a BCD number. Zero returns the length. The
+//header doesn't keep it, so the digits are scanned a byte at a time.
+static int LeadDigit(struct CalcContext *ctx, const unsigned char *n1);
+//Table entry or constant number i in the order they are saved
+static unsigned char *TableEntry(struct CalcContext *ctx, int i);
+//Load the generated tables and constants from MATH_TABLE_FILE
+static bool LoadTables(struct CalcContext *ctx);
+//Save the generated tables and constants to MATH_TABLE_FILE
+static void SaveTables(struct CalcContext *ctx);
+//Calculate trig and log tables and constants to MATH_MAX_PLACES
+static void GenerateTables(struct CalcContext *ctx);
 //Natural logarithm of a BCD number
-static bool LnBCD(unsigned char *result, unsigned char *arg);
+static bool LnBCD(struct CalcContext *ctx, unsigned char *result, unsigned char *arg);
 //Power of e of a BCD number
-static void ExpBCD(unsigned char *result, unsigned char *arg);
-//Roll a BCD number left by one BCD decimal place
-static void RolBCD(unsigned char *result, unsigned char *arg, int amount);
-//Roll a BCD number right by one BCD decimal place
-static void RorBCD(unsigned char *result, unsigned char *arg, int amount);
-//Exponents of a BCD number
-static void PowBCD(unsigned char *result, unsigned char *base, unsigned char *exp);
+static void ExpBCD(struct CalcContext *ctx, unsigned char *result, unsigned char *arg);
+//Multiply a BCD number by 2^amount
+static void RolBCD(struct CalcContext *ctx, unsigned char *result, unsigned char *arg, int amount);
+//Divide a BCD number by 2^amount
+static void RorBCD(struct CalcContext *ctx, unsigned char *result, unsigned char *arg, int amount);
+//Add n2/2^amount to n1, or subtract it from n1. result may be n1 or n2.
+static void ShiftAddBCD(struct CalcContext *ctx, unsigned char *result, unsigned char *n1, unsigned char *n2, int amount, bool subtract);
+//Exponents of a BCD number. Returns false if the answer is too large to hold.
+static bool PowBCD(struct CalcContext *ctx, unsigned char *result, unsigned char *base, unsigned char *exp);
+//Raise a BCD number to a whole power by squaring. Returns what is left of the power if
+//a product would be too long for a cell.
+static unsigned long PowIntBCD(struct CalcContext *ctx, unsigned char *result, unsigned char *base, unsigned long n);
+//Square root of a BCD number
+static void SqrtBCD(struct CalcContext *ctx, unsigned char *result, unsigned char *arg);
 //Calculate sine and cosine of a BCD number
-static void TanBCD(unsigned char *sine_result,unsigned char *cos_result,unsigned char *arg);
+static void TanBCD(struct CalcContext *ctx, unsigned char *sine_result,unsigned char *cos_result,unsigned char *arg);
 //Arccosine of a BCD number
-static void AcosBCD(unsigned char *result,unsigned char *arg);
+static void AcosBCD(struct CalcContext *ctx, unsigned char *result,unsigned char *arg);
 //Arcsine of a BCD number
-static void AsinBCD(unsigned char *result,unsigned char *arg);
+static void AsinBCD(struct CalcContext *ctx, unsigned char *result,unsigned char *arg);
 //Arctangent of a BCD number
-static void AtanBCD(unsigned char *result,unsigned char *arg);
+static void AtanBCD(struct CalcContext *ctx, unsigned char *result,unsigned char *arg);
 //CORDIC routine used to calculate above trig functions
-static void CalcTanBCD(unsigned char *result1,unsigned char *result2,unsigned char *result3,unsigned char *arg,int flag);
+static void CalcTanBCD(struct CalcContext *ctx, unsigned char *result1,unsigned char *result2,unsigned char *result3,unsigned char *arg,int flag);
 //Compare a BCD number to a string
-static int CompBCD(const char *num, unsigned char *var);
+static int CompBCD(struct CalcContext *ctx, const char *num, unsigned char *var);
 //Compare two BCD numbers
-static int CompVarBCD(unsigned char *var1, unsigned char *var2);
+static int CompVarBCD(struct CalcContext *ctx, unsigned char *var1, unsigned char *var2);
 //Convert the number on the top of the stack to 0-90 degree format. Store result in p3.
-static int TrigPrep(int *cosine);
+static int TrigPrep(struct CalcContext *ctx, int *cosine);
+
+#ifdef LIMB_MATH
+  //Load the digits of a BCD number into limbs, multiplied by 10^shift
+  static int LimbLoad(struct CalcContext *ctx, unsigned long *limbs, const unsigned char *n1, int shift);
+  //Write limbs to the digits of a BCD number, padded with zeroes to width
+  static void LimbStore(struct CalcContext *ctx, unsigned char *n1, const unsigned long *limbs, int count, int width);
+  //Number of decimal digits in a limb number
+  static int LimbDigits(const unsigned long *limbs, int count);
+  //Compare two limb numbers. Returns COMP_GT, COMP_LT or COMP_EQ
+  static int LimbComp(const unsigned long *n1, int n1_count, const unsigned long *n2, int n2_count);
+  //Add two limb numbers
+  static int LimbAdd(unsigned long *result, const unsigned long *n1, int n1_count, const unsigned long *n2, int n2_count);
+  //Subtract a smaller limb number from a larger one
+  static int LimbSub(unsigned long *result, const unsigned long *n1, int n1_count, const unsigned long *n2, int n2_count);
+  //Multiply two limb numbers
+  static int LimbMult(struct CalcContext *ctx, unsigned long *result, const unsigned long *n1, int n1_count, const unsigned long *n2, int n2_count);
+  //Multiply two limb numbers of the same length by splitting them in half
+  static void LimbKaratsuba(struct CalcContext *ctx, unsigned long *result, const unsigned long *n1, const unsigned long *n2, int count, unsigned long *scratch);
+  //Divide two limb numbers, discarding the remainder
+  static int LimbDiv(struct CalcContext *ctx, unsigned long *result, const unsigned long *n1, int n1_count, const unsigned long *n2, int n2_count);
+  //Divide two limb numbers using a reciprocal found with Newton's method
+  static int LimbNewtonDiv(struct CalcContext *ctx, unsigned long *result, const unsigned long *n1, int n1_count, const unsigned long *n2, int n2_count);
+  //Divide a limb number by 10^amount, discarding the remainder
+  static int LimbShift(unsigned long *n1, int count, int amount);
+  //Limb versions of AddBCD, MultBCD and DivBCD
+  static void LimbAddBCD(struct CalcContext *ctx, unsigned char *result, const unsigned char *n1, const unsigned char *n2);
+  static void LimbMultBCD(struct CalcContext *ctx, unsigned char *result, const unsigned char *n1, const unsigned char *n2);
+  static void LimbDivBCD(struct CalcContext *ctx, unsigned char *result, const unsigned char *n1, const unsigned char *n2);
+#endif
+
+#ifdef ZIV_ROUND
+  enum ZivOps {ZivLn,ZivExp,ZivPow,ZivTan,ZivAtan};
+
+  //Calculate op of n1, or of n1 and n2 for ZivPow, at extra decimal places and round
+  //result1, and result2 for ZivTan, to DecPlaces. Returns false if LnBCD or PowBCD fails.
+  static bool ZivBCD(struct CalcContext *ctx, int op, unsigned char *result1, unsigned char *result2, unsigned char *n1, unsigned char *n2);
+  //Number of whole digits of n1, or of 1/n1 if n1 is below 1
+  static int ZivDigits(struct CalcContext *ctx, const unsigned char *n1);
+  //Check if the digits of n1 past places are far enough from halfway to round. The error
+  //is ZIV_ERROR times 10^scale in the last decimal place.
+  static bool ZivCheck(struct CalcContext *ctx, const unsigned char *n1, int places, int scale);
+  //Round n1 to places decimal places
+  static void ZivRound(struct CalcContext *ctx, unsigned char *n1, int places);
+#endif
+
+#ifdef MEMO_CACHE
+  enum MemoOps {MemoLn,MemoExp,MemoPow,MemoTan,MemoAtan};
+
+  //Look up op of n1, or of n1 and n2 for MemoPow, in the cache, or calculate it and save
+  //it in place of the least recently used entry. result2 is the cosine for MemoTan.
+  //Returns false if LnBCD or PowBCD fails.
+  static bool MemoBCD(struct CalcContext *ctx, int op, unsigned char *result1, unsigned char *result2, unsigned char *n1, unsigned char *n2);
+  //Add the bytes of a BCD number to a hash
+  static unsigned long MemoHash(struct CalcContext *ctx, unsigned long hash, const unsigned char *n1);
+  //Check if a BCD number has the same bytes as a copy in the cache
+  static bool MemoSame(struct CalcContext *ctx, const unsigned char *n1, const unsigned char *copy);
+  //Copy a BCD number into or out of the cache
+  static void MemoCopyIn(struct CalcContext *ctx, unsigned char *copy, const unsigned char *n1);
+  static void MemoCopyOut(struct CalcContext *ctx, unsigned char *n1, const unsigned char *copy);
+#endif
+
+#ifdef DOUBLE_MATH
+  enum DoubleOps {DoubleLn,DoubleExp,DoubleSin,DoubleCos,DoubleAtan,DoubleAsin,DoubleAcos,DoublePow,DoubleSqrt};
+
+  //Convert a BCD number to the nearest double
+  static double BCDToDouble(struct CalcContext *ctx, const unsigned char *n1);
+  //Function op of x, or of x and y for DoublePow. Angles are in degrees.
+  static double DoubleOp(int op, double x, double y);
+  //Calculate op of n1 and n2 with doubles and round it to DecPlaces. Returns false and
+  //leaves result alone if the rounded digits might be wrong.
+  static bool DoubleBCD(struct CalcContext *ctx, int op, unsigned char *result, const unsigned char *n1, const unsigned char *n2);
+#endif
 
-//Draw the stack
-static void DrawStack(bool menu, bool input, int stack_pointer);
-//Redraw the input line
-static void DrawInput(unsigned char *line, int input_ptr, int offset, bool menu);
+#ifndef BATCH
+  //Draw the stack
+  static void DrawStack(struct CalcContext *ctx, bool menu, bool input, int stack_pointer);
+  //Redraw the input line
+  static void DrawInput(struct CalcContext *ctx, unsigned char *line, int input_ptr, int offset, bool menu);
+#endif
 //Error message
-static void ErrorMsg(const char *msg);
+static void ErrorMsg(struct CalcContext *ctx, const char *msg);
 //Print a number between 0 and 99.
 static void Number2(int num);
 //Rewrite decimal places in trig and log tables after decimal place is changed
-static void SetDecPlaces();
+static void SetDecPlaces(struct CalcContext *ctx);
+//Set up a new calculator with an empty stack and default settings. MM_ASSIGN_GLOBALS
+//must have run first.
+static void CalcInit(struct CalcContext *ctx);
+
+#ifdef BENCHMARK
+  //Seconds from a high resolution timer
+  static double BenchTime();
+  //Write a random number with the given number of digits to a string
+  static void BenchNumber(char *text, int whole, int decimals, bool negative);
+  //Load random operands for one operation into the stack
+  static void BenchSetup(struct CalcContext *ctx, int op);
+  //Run one operation on the operands loaded by BenchSetup
+  static void BenchRun(struct CalcContext *ctx, int op);
+  //Time each operation at each precision and print the results
+  static void Benchmark(struct CalcContext *ctx);
+#endif
 //For compatibility with the MSP430 version
 #define LCD_Text printf
 
-//Simulated memory of the calculator. Can be set much larger.
-#define PC_MEM_SIZE 20000
-unsigned char memory[PC_MEM_SIZE];
+//Size of the simulated memory of the calculator. Can be set much larger.
+#define PC_MEM_SIZE 50000
+
+//Without MemMap the variables below are members of CalcRAM, which is part of each context.
+//MemMap counts braces even in code the preprocessor skips, and it forgets the variables
+//when their block closes. The braces of the struct are kept in these defines so MemMap
+//sees them open and close before any variables are declared.
+#ifdef CONTEXT_RAM
+  #define CALC_RAM_START struct CalcRAM {
+  #define CALC_RAM_END   };
+#else
+  #define CALC_RAM_START
+  #define CALC_RAM_END
+#endif
 
 //Offset for addresses of the following variables
 #pragma MM_OFFSET 5000
 //Global variables stored in external RAM. Use MM_ASSIGN_GLOBALS where you want to insert
 //code for initializing them.
+CALC_RAM_START
 #pragma MM_GLOBALS
   //p0-p7 are general register variables. Some (not all) of the functions they are used in
   //are listed here. If one function calls another, they should use separate registers.
-  unsigned char p0[260]; //PowBCD, LnBCD, ExpBCD, TanBCD, AtanBCD, typing,    CompBCD
-  unsigned char p1[260]; //PowBCD, LnBCD, ExpBCD, TanBCD, AtanBCD, DrawStack, CompBCD, CompVarBCD
-  unsigned char p2[260]; //PowBCD, LnBCD, ExpBCD, TanBCD, AtanBCD
-  unsigned char p3[260]; //PowBCD
-  unsigned char p4[260]; //PowBCD
-  unsigned char p5[260];
-  unsigned char p6[260];
-  unsigned char p7[260];
+  unsigned char p0[132]; //PowBCD, LnBCD, ExpBCD, TanBCD, AtanBCD, typing,    CompBCD, ModBCD
+  unsigned char p1[132]; //PowBCD, LnBCD, ExpBCD, TanBCD, AtanBCD, DrawStack, ModBCD
+  unsigned char p2[132]; //PowBCD, LnBCD, ExpBCD, TanBCD, AtanBCD
+  unsigned char p3[132]; //PowBCD
+  unsigned char p4[132]; //PowBCD
+  unsigned char p5[132];
+  unsigned char p6[132];
+  unsigned char p7[132];
   //Buffer variable for calculations in AddBCD
-  unsigned char buffer[260]; //AddBCD
+  unsigned char buffer[132]; //AddBCD
   //Buffer variables for DivBCD and MultBCD
-  unsigned char perm_buff1[260]; //DivBCD, MultBCD
-  unsigned char perm_buff2[260]; //DivBCD
-  unsigned char perm_buff3[260]; //DivBCD
+  unsigned char perm_buff1[132]; //DivBCD, MultBCD, ShiftAddBCD
+  unsigned char perm_buff2[132]; //DivBCD
+  unsigned char perm_buff3[132]; //DivBCD
   //Table of log values for CORDIC routines
   //My preprocessor does not evaluate define values. They have to be calculated manually.
-  //unsigned char logs[MATH_LOG_TABLE*MATH_ENTRY_SIZE];
-  unsigned char logs[4218];
+  //unsigned char logs[MATH_LOG_MAX*MATH_ENTRY_SIZE];
+  unsigned char logs[17160];
   //Table of trig values for CORDIC routines
-  //unsigned char trig[MATH_TRIG_TABLE*MATH_ENTRY_SIZE];
-  unsigned char trig[4218];
+  //unsigned char trig[MATH_TRIG_MAX*MATH_ENTRY_SIZE];
+  unsigned char trig[17160];
   //Stores 0 in BCD format so it doesn't have to be created in memory every time it's used.
   unsigned char perm_zero[4];
   //Stores the value of K for use with trig functions.
-  unsigned char perm_K[36];
+  unsigned char perm_K[52];
   //Stores the log10 conversion factor
-  unsigned char perm_log10[36];
+  unsigned char perm_log10[52];
+  //Constants used by the math routines and key handlers so they don't have to be parsed every time
+  unsigned char perm_one[4];
+  unsigned char perm_ten[4];
+  unsigned char perm_90[4];
+  unsigned char perm_180[5];
+  unsigned char perm_360[5];
+  unsigned char perm_deg[52];
+  unsigned char perm_2pi[52];
+  unsigned char perm_pi[52];
   //Total size of the stack. Should be equal to STACK_SIZE * MATH_CELL_SIZE
-  unsigned char BCD_stack[2600];
+  unsigned char BCD_stack[1320];
   //Return values are placed here before being added to the stack
-  unsigned char stack_buffer[260];
+  unsigned char stack_buffer[132];
 //End of global variables that will be stored externally
 #pragma MM_END
+CALC_RAM_END
+
+#ifdef CONTEXT_RAM
+  //The names above are found in the context of the function they are used in, the same as
+  //RAM_Read and RAM_Write after MemMap
+  #define p0           (ctx->ram.p0)
+  #define p1           (ctx->ram.p1)
+  #define p2           (ctx->ram.p2)
+  #define p3           (ctx->ram.p3)
+  #define p4           (ctx->ram.p4)
+  #define p5           (ctx->ram.p5)
+  #define p6           (ctx->ram.p6)
+  #define p7           (ctx->ram.p7)
+  #define buffer       (ctx->ram.buffer)
+  #define perm_buff1   (ctx->ram.perm_buff1)
+  #define perm_buff2   (ctx->ram.perm_buff2)
+  #define perm_buff3   (ctx->ram.perm_buff3)
+  #define logs         (ctx->ram.logs)
+  #define trig         (ctx->ram.trig)
+  #define perm_zero    (ctx->ram.perm_zero)
+  #define perm_K       (ctx->ram.perm_K)
+  #define perm_log10   (ctx->ram.perm_log10)
+  #define perm_one     (ctx->ram.perm_one)
+  #define perm_ten     (ctx->ram.perm_ten)
+  #define perm_90      (ctx->ram.perm_90)
+  #define perm_180     (ctx->ram.perm_180)
+  #define perm_360     (ctx->ram.perm_360)
+  #define perm_deg     (ctx->ram.perm_deg)
+  #define perm_2pi     (ctx->ram.perm_2pi)
+  #define perm_pi      (ctx->ram.perm_pi)
+  #define BCD_stack    (ctx->ram.BCD_stack)
+  #define stack_buffer (ctx->ram.stack_buffer)
+#endif
 
 //Information used in the settings page
 struct SettingsType
@@ -236,16 +556,185 @@ struct SettingsType
   int TrigTableSize;
   bool SciNot;
 
-} Settings;
+};
+
+#ifdef MEMO_CACHE
+//One result saved by MemoBCD. The numbers are copied out of the simulated memory.
+struct MemoEntry
+{
+  //Value of memo_clock when the entry was last used. Empty entries are 0.
+  unsigned long used;
+  unsigned long hash;
+  int op;
+  int places;
+  bool deg_rad;
+  bool success;
+  unsigned char n1[MATH_CELL_SIZE],n2[MATH_CELL_SIZE];
+  unsigned char result1[MATH_CELL_SIZE],result2[MATH_CELL_SIZE];
+};
+#endif
+
+//Everything a calculator changes while it runs. Each function that works with BCD numbers
+//takes one, so separate calculators can run side by side. The variables in external RAM
+//are in ram, or after MemMap they are only addresses and their contents are in memory.
+struct CalcContext
+{
+  //Simulated memory of the calculator
+  unsigned char memory[PC_MEM_SIZE];
+  #ifdef CONTEXT_RAM
+  //Variables in external RAM when the file hasn't been through MemMap
+  struct CalcRAM ram;
+  #endif
+  //Pointer to the top of the BCD stack
+  int stack_ptr;
+  struct SettingsType Settings;
+  //Debug variables to count how many accesses to external memory an operation takes
+  unsigned long counter1,counter2;
+  //Where the CORDIC tables run out at each precision. FindLeads fills these in for the
+  //built in tables and again after GenerateTables replaces them.
+  unsigned char log_lead[MATH_LOG_MAX],trig_lead[MATH_TRIG_MAX];
+  int log_count,trig_count;
+  bool tables_generated;
+  #ifdef ZIV_ROUND
+  //Extra decimal places ZivBCD is calling the math routines with, or -1 when it isn't
+  //running. The routines don't call it again while it is.
+  int ziv_guard;
+  #endif
+  #ifdef MEMO_CACHE
+  struct MemoEntry memo[MEMO_ENTRIES];
+  //Counts lookups to order the entries. Hits and misses are counted for tuning.
+  unsigned long memo_clock,memo_hits,memo_misses;
+  //Set while MemoBCD is calling the math routines so they don't call it again
+  bool memo_busy;
+  #endif
+  #ifdef BATCH
+  //Where expressions are read from
+  FILE *batch_file;
+  //Keys for the current token. GetKey returns them one at a time.
+  int batch_keys[MATH_CELL_SIZE];
+  int batch_key_ptr;
+  //Set once the current line has a token
+  bool batch_line;
+  //First error on the current line
+  const char *batch_error;
+  #endif
+  #ifdef LIMB_MATH
+  //Work space for the limb routines. Kept in PC memory rather than the simulated RAM.
+  unsigned long limb_a[LIMB_MAX+1],limb_b[LIMB_MAX],limb_r[LIMB_MAX*2];
+  unsigned long limb_k[LIMB_MAX*8];
+  unsigned long limb_x[LIMB_MAX+2],limb_p[LIMB_MAX*2+2],limb_e[LIMB_MAX*2+2];
+  #endif
+};
+
+#ifdef LIMB_MATH
+  static const unsigned long limb_pow10[LIMB_DIGITS]={1,10,100,1000,10000,100000,1000000,10000000,100000000};
+#endif
+
+//Functions for console operations in batch mode. Each token is turned into the keys
+//that would be typed for it. The top of the stack is printed at the end of each line.
+#ifdef BATCH
+void SetBlink(bool status)
+{
+  return;
+}
+
+void gotoxy(short x, short y)
+{
+  return;
+}
+
+void SetColor(bool black)
+{
+  return;
+}
+
+int GetKey(struct CalcContext *ctx)
+{
+  static const struct
+  {
+    const char *name;
+    int key;
+  } ops[]={{"+",'+'},{"-",'-'},{"*",'*'},{"/",'/'},{"atan",'a'},{"cos",'c'},{"dupe",'d'},
+           {"e^x",'e'},{"acos",'g'},{"asin",'h'},{"pi",'i'},{"10^x",'j'},{"log",'k'},{"ln",'l'},
+           {"+/-",'m'},{"1/x",'n'},{"round",'o'},{"y^x",'p'},{"sqrt",'q'},{"root",'r'},
+           {"sin",'s'},{"tan",'t'},{"mod",'v'},{"swap",'w'},{"x^2",'x'},{"clear",'z'},
+           {"drop",KEY_BACKSPACE}};
+  char token[MATH_CELL_SIZE];
+  int c,i,j,dots;
+
+  while (ctx->batch_keys[ctx->batch_key_ptr]==0)
+  {
+    ctx->batch_key_ptr=0;
+    ctx->batch_keys[0]=0;
 
-//Pointer to the top of the BCD stack
-int stack_ptr;
+    c=getc(ctx->batch_file);
+    while ((c==' ')||(c=='\t')||(c=='\r')) c=getc(ctx->batch_file);
+    if ((c=='\n')||(c==EOF))
+    {
+      if (ctx->batch_line)
+      {
+        if (ctx->batch_error)
+        {
+          fputs("Error: ",stdout);
+          for (i=0;ctx->batch_error[i];i++) putchar(ctx->batch_error[i]=='\n'?' ':ctx->batch_error[i]);
+        }
+        else if (ctx->stack_ptr) PrintBCD(ctx,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE,-1);
+        putchar('\n');
+        ctx->stack_ptr=0;
+        ctx->batch_error=NULL;
+        ctx->batch_line=false;
+      }
+      if (c==EOF) return KEY_ESCAPE;
+      continue;
+    }
 
-//Debug variables to count how many accesses to external memory an operation takes
-unsigned long counter1,counter2;
+    i=0;
+    do
+    {
+      if (i<MATH_CELL_SIZE-1) token[i++]=c;
+      c=getc(ctx->batch_file);
+    } while ((c!=EOF)&&(c!=' ')&&(c!='\t')&&(c!='\r')&&(c!='\n'));
+    if (c!=EOF) ungetc(c,ctx->batch_file);
+    token[i]=0;
+    ctx->batch_line=true;
+
+    //Numbers are typed followed by enter. Negative numbers are typed then negated.
+    j=(token[0]=='-');
+    dots=0;
+    for (i=j;token[i];i++)
+    {
+      if (token[i]=='.') dots++;
+      else if ((token[i]<'0')||(token[i]>'9')) break;
+    }
+    if ((token[i]==0)&&(i>j)&&(dots<2)&&(i-j>dots))
+    {
+      if (i-j>MATH_CELL_SIZE-3) ErrorMsg(ctx,"Invalid input");
+      else
+      {
+        for (i=j;token[i];i++) ctx->batch_keys[i-j]=token[i];
+        i-=j;
+        ctx->batch_keys[i++]=KEY_ENTER;
+        if (j) ctx->batch_keys[i++]='m';
+        ctx->batch_keys[i]=0;
+      }
+      continue;
+    }
 
+    for (i=0;i<(int)(sizeof(ops)/sizeof(ops[0]));i++)
+    {
+      if (strcmp(token,ops[i].name)==0)
+      {
+        ctx->batch_keys[0]=ops[i].key;
+        ctx->batch_keys[1]=0;
+        break;
+      }
+    }
+    if (ctx->batch_keys[0]==0) ErrorMsg(ctx,"Unknown token");
+  }
+  return ctx->batch_keys[ctx->batch_key_ptr++];
+}
 //Functions for console operations under Windows
-#ifdef WINDOWS
+#elif defined WINDOWS
 void SetBlink(bool status)
 {
   CONSOLE_CURSOR_INFO cursorInfo;
@@ -276,7 +765,7 @@ void clrscr()
   system("cls");
 }
 
-int GetKey()
+int GetKey(struct CalcContext *ctx)
 {
   int i;
   i=getch();
@@ -284,6 +773,7 @@ int GetKey()
   if (i==224) i=getch();
   return i;
 }
+
 //Functions for console operations under Linux using ncurses
 #elif defined LINUX
 void SetBlink(bool status)
@@ -307,7 +797,7 @@ void clrscr()
   erase();
 }
 
-int GetKey()
+int GetKey(struct CalcContext *ctx)
 {
   int i;
   i=getch();
@@ -315,34 +805,57 @@ int GetKey()
 }
 #endif
 
-static unsigned char RAM_Read(const unsigned char *a1)
+#ifdef BENCHMARK
+//Timing does not depend on the console, so the batch build can benchmark too
+#ifdef WINDOWS
+double BenchTime()
+{
+  LARGE_INTEGER count,freq;
+  QueryPerformanceCounter(&count);
+  QueryPerformanceFrequency(&freq);
+  return (double)count.QuadPart/freq.QuadPart;
+}
+#elif defined LINUX
+double BenchTime()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC,&now);
+  return now.tv_sec+now.tv_nsec/1e9;
+}
+#endif
+#endif
+
+static unsigned char CalcRead(struct CalcContext *ctx, const unsigned char *a1)
 {
-  counter1++;
+  ctx->counter1++;
   if (a1>(unsigned char *)PC_MEM_SIZE)
   {
     printf("\nRead error:%p\n",a1);
-    GetKey();
+    GetKey(ctx);
   }
-  return *(memory+(ptrdiff_t)a1);
+  return *(ctx->memory+(ptrdiff_t)a1);
 }
 
-static void RAM_Write(const unsigned char *a1, const unsigned char byte)
+static void CalcWrite(struct CalcContext *ctx, const unsigned char *a1, const unsigned char byte)
 {
-  counter2++;
+  ctx->counter2++;
   if (a1>(unsigned char *)PC_MEM_SIZE)
   {
     printf("\nWrite error:%p\n",a1);
-    GetKey();
+    GetKey(ctx);
   }
-  memory[(ptrdiff_t)a1]=byte;
+  ctx->memory[(ptrdiff_t)a1]=byte;
 }
 
-static void AddBCD(unsigned char *result, const unsigned char *n1, const unsigned char *n2)
+static void AddBCD(struct CalcContext *ctx, unsigned char *result, const unsigned char *n1, const unsigned char *n2)
 {
   #pragma MM_VAR result
   #pragma MM_VAR n1
   #pragma MM_VAR n2
 
+  #ifdef LIMB_MATH
+  LimbAddBCD(ctx,result,n1,n2);
+  #else
   unsigned char carry;
   const unsigned char *temp;
   unsigned char sign;
@@ -352,6 +865,10 @@ static void AddBCD(unsigned char *result, const unsigned char *n1, const unsigne
   unsigned char carry_number=0;
   bool subtracting=false;
   int t1,t2,d1,d2;
+  //Digits are read and written a byte at a time. These hold the byte last read
+  //from each number and the low digit waiting to be written.
+  int n1_cached=-1, n2_cached=-1;
+  unsigned char n1_byte=0, n2_byte=0, low=0;
 
   t1=n1[BCD_SIGN];
   t2=n2[BCD_SIGN];
@@ -373,14 +890,19 @@ static void AddBCD(unsigned char *result, const unsigned char *n1, const unsigne
     buffer[BCD_DEC]=n2[BCD_DEC];
     buffer[BCD_LEN]=n2[BCD_LEN];
     carry=1;
-    for (BCD_ptr=n2[BCD_LEN]+2;BCD_ptr>=3;BCD_ptr--)
+    BCD_end=n2[BCD_LEN]-1;
+    for (BCD_ptr=BCD_end;BCD_ptr>=0;BCD_ptr--)
     {
-      t1=9-n2[BCD_ptr]+carry;
-      if (t1==10) buffer[BCD_ptr]=0;
+      if ((BCD_ptr&1)||(BCD_ptr==BCD_end)) n2_byte=n2[(BCD_ptr>>1)+3];
+      if (BCD_ptr&1) t1=9-(n2_byte&0xF)+carry;
+      else t1=9-(n2_byte>>4)+carry;
+      if (t1==10) t1=0;
+      else carry=0;
+      if (BCD_ptr&1) low=t1;
       else
       {
-        carry=0;
-        buffer[BCD_ptr]=t1;
+        buffer[(BCD_ptr>>1)+3]=(t1<<4)|low;
+        low=0;
       }
     }
     carry_number=9;
@@ -420,13 +942,33 @@ static void AddBCD(unsigned char *result, const unsigned char *n1, const unsigne
   }
 
   carry=0;
-  BCD_end=result[BCD_LEN]+2;
-  for (BCD_ptr=BCD_end;BCD_ptr>=3;BCD_ptr--)
+  BCD_end=result[BCD_LEN]-1;
+  for (BCD_ptr=BCD_end;BCD_ptr>=0;BCD_ptr--)
   {
     t1=carry;
-    if ((BCD_ptr<=BCD_end-n1_dec)&&(BCD_ptr>n1_whole+2)) t1+=n1[BCD_ptr-n1_whole];
-    if ((BCD_ptr<=BCD_end-n2_dec)&&(BCD_ptr>n2_whole+2)) t1+=n2[BCD_ptr-n2_whole];
-    if (BCD_ptr<=n2_whole+2) t1+=carry_number;
+    if ((BCD_ptr<=BCD_end-n1_dec)&&(BCD_ptr>=n1_whole))
+    {
+      d1=BCD_ptr-n1_whole;
+      if ((d1>>1)!=n1_cached)
+      {
+        n1_cached=d1>>1;
+        n1_byte=n1[n1_cached+3];
+      }
+      if (d1&1) t1+=n1_byte&0xF;
+      else t1+=n1_byte>>4;
+    }
+    if ((BCD_ptr<=BCD_end-n2_dec)&&(BCD_ptr>=n2_whole))
+    {
+      d2=BCD_ptr-n2_whole;
+      if ((d2>>1)!=n2_cached)
+      {
+        n2_cached=d2>>1;
+        n2_byte=n2[n2_cached+3];
+      }
+      if (d2&1) t1+=n2_byte&0xF;
+      else t1+=n2_byte>>4;
+    }
+    if (BCD_ptr<n2_whole) t1+=carry_number;
 
     if (t1>9)
     {
@@ -434,59 +976,75 @@ static void AddBCD(unsigned char *result, const unsigned char *n1, const unsigne
       carry=1;
     }
     else carry=0;
-    result[BCD_ptr]=t1;
+
+    if (BCD_ptr&1) low=t1;
+    else
+    {
+      result[(BCD_ptr>>1)+3]=(t1<<4)|low;
+      low=0;
+    }
   }
 
   if ((carry==1)&&(subtracting==false))
   {
-    PadBCD(result,1);
-    result[3]=1;
+    PadBCD(ctx,result,1);
+    SetDigit(ctx,result,0,1);
   }
 
   if ((carry==0)&&(carry_number==9)&&(sign==2))
   {
     carry=1;
-    for (BCD_ptr=result[BCD_LEN]+2;BCD_ptr>=3;BCD_ptr--)
+    BCD_end=result[BCD_LEN]-1;
+    for (BCD_ptr=BCD_end;BCD_ptr>=0;BCD_ptr--)
     {
-      t1=9-result[BCD_ptr]+carry;
+      if ((BCD_ptr&1)||(BCD_ptr==BCD_end)) n1_byte=result[(BCD_ptr>>1)+3];
+      if (BCD_ptr&1) t1=9-(n1_byte&0xF)+carry;
+      else t1=9-(n1_byte>>4)+carry;
       if (t1==10) t1=0;
       else carry=0;
-      result[BCD_ptr]=t1;
+      if (BCD_ptr&1) low=t1;
+      else
+      {
+        result[(BCD_ptr>>1)+3]=(t1<<4)|low;
+        low=0;
+      }
     }
     sign=1;
   }
   else if (sign==2) sign=0;
   result[BCD_SIGN]=sign;
+  #endif
 }
 
-static void SubBCD(unsigned char *result, const unsigned char *n1, unsigned char *n2)
+static void SubBCD(struct CalcContext *ctx, unsigned char *result, const unsigned char *n1, unsigned char *n2)
 {
   #pragma MM_VAR result
   #pragma MM_VAR n1
   #pragma MM_VAR n2
   n2[BCD_SIGN]=!n2[BCD_SIGN];
-  AddBCD(result,n1,n2);
+  AddBCD(ctx,result,n1,n2);
   n2[BCD_SIGN]=!n2[BCD_SIGN];
 }
 
-static void ImmedBCD(const char *text, unsigned char *BCD)
+static void ImmedBCD(struct CalcContext *ctx, const char *text, unsigned char *BCD)
 {
   int text_ptr=0;
   do
   {
     perm_buff2[text_ptr]=(unsigned char)text[text_ptr];
   } while(text[text_ptr++]);
-  BufferBCD(perm_buff2,BCD);
+  BufferBCD(ctx,perm_buff2,BCD);
 }
 
-static void BufferBCD(const unsigned char *text, unsigned char *BCD)
+static void BufferBCD(struct CalcContext *ctx, const unsigned char *text, unsigned char *BCD)
 {
   #pragma MM_VAR text
   #pragma MM_VAR BCD
 
   unsigned char *RAM_ptr;
-  int BCD_ptr=3,text_ptr=0;
+  int BCD_ptr=0,text_ptr=0;
   char found=0;
+  unsigned char high=0;
 
   if (text[0]=='-')
   {
@@ -507,16 +1065,18 @@ static void BufferBCD(const unsigned char *text, unsigned char *BCD)
     }
     else
     {
-      BCD[BCD_ptr]=text[text_ptr]-'0';
+      if (BCD_ptr&1) BCD[(BCD_ptr>>1)+3]=high|(text[text_ptr]-'0');
+      else high=(text[text_ptr]-'0')<<4;
       BCD_ptr++;
     }
     text_ptr++;
   }
+  if (BCD_ptr&1) BCD[(BCD_ptr>>1)+3]=high;
   BCD[BCD_LEN]=text_ptr-found;
   if (found==0) BCD[BCD_DEC]=BCD[BCD_LEN];
 }
 
-static void PrintBCD(const unsigned char *BCD, int dec_point)
+static void PrintBCD(struct CalcContext *ctx, const unsigned char *BCD, int dec_point)
 {
   #pragma MM_VAR BCD
   int BCD_ptr,BCD_end;
@@ -535,93 +1095,107 @@ static void PrintBCD(const unsigned char *BCD, int dec_point)
   for (BCD_ptr=3;BCD_ptr<BCD_end;BCD_ptr++)
   {
     if (BCD_ptr==BCD[BCD_DEC]+3) putchar('.');
-    if (BCD[BCD_ptr]>9) putchar('x');
-    else putchar('0'+BCD[BCD_ptr]);
+    if (GetDigit(ctx,BCD,BCD_ptr-3)>9) putchar('x');
+    else putchar('0'+GetDigit(ctx,BCD,BCD_ptr-3));
   }
-  #ifdef LINUX
+  #if defined LINUX && !defined BATCH
   refresh();
   #endif
 }
 
-static void MultBCD(unsigned char *result, const unsigned char *n1, const unsigned char *n2)
+static void MultBCD(struct CalcContext *ctx, unsigned char *result, const unsigned char *n1, const unsigned char *n2)
 {
   #pragma MM_VAR result
   #pragma MM_VAR n1
   #pragma MM_VAR n2
-  #pragma MM_VAR temp
-
-  #pragma MM_DECLARE
-    unsigned char temp[5];
-  #pragma MM_END
-
-  unsigned char i,j,k,flip=0;
-  unsigned char i_end, j_end, k_end;
-  unsigned char b0,b1;
-  CopyBCD(result,perm_zero);
-  CopyBCD(perm_buff1,perm_zero);
-
-  temp[BCD_SIGN]=0;
-  temp[BCD_LEN]=2;
 
-  i_end=n1[BCD_LEN];
-  j_end=n2[BCD_LEN];
-  for (i=0;i<i_end;i++)
+  #ifdef LIMB_MATH
+  LimbMultBCD(ctx,result,n1,n2);
+  #else
+  int i,j,j_start;
+  int i_end,j_end,i_zeros,j_zeros;
+  unsigned int accum=0;
+  unsigned char low=0;
+
+  //Zeroes at the end of whole numbers, like the ones 10^x makes, are left out of the
+  //multiply and put back on the product afterwards
+  i_zeros=TrailingZeros(ctx,n1);
+  j_zeros=TrailingZeros(ctx,n2);
+  i_end=n1[BCD_LEN]-i_zeros;
+  j_end=n2[BCD_LEN]-j_zeros;
+  if ((i_end==0)||(j_end==0)) CopyBCD(ctx,result,perm_zero);
+  else
   {
-    for (j=0;j<j_end;j++)
+    //Each digit of the product is the sum of one column of digit products plus the
+    //carry from the column before, so no intermediate additions are needed
+    result[BCD_SIGN]=0;
+    result[BCD_LEN]=i_end+j_end;
+    result[BCD_DEC]=i_end+j_end;
+    for (i=i_end+j_end-1;i>=0;i--)
     {
-      b0=0;
-      b1=0;
-      k_end=n1[i+3];
-      for (k=0;k<k_end;k++) b0+=n2[j+3];
-      while (b0>9)
+      j_start=i-j_end;
+      if (j_start<0) j_start=0;
+      for (j=j_start;(j<i)&&(j<i_end);j++) accum+=GetDigit(ctx,n1,j)*GetDigit(ctx,n2,i-1-j);
+
+      if (i&1) low=accum%10;
+      else
       {
-        b1+=1;
-        b0-=10;
+        result[(i>>1)+3]=((accum%10)<<4)|low;
+        low=0;
       }
-      temp[3]=b1;
-      temp[4]=b0;
-
-      temp[BCD_DEC]=2+i_end-i+j_end-j-2;
-      if (flip==0) AddBCD(result,temp,perm_buff1);
-      else AddBCD(perm_buff1,temp,result);
-      flip=!flip;
+      accum/=10;
     }
   }
+  i=(n1[BCD_LEN]-n1[BCD_DEC])+(n2[BCD_LEN]-n2[BCD_DEC]);
 
-  if (flip==0)
-  {
-    //Just CopyBCD?
-    i=perm_buff1[BCD_LEN];
-    for (j=0;j<i+3;j++) result[j]=perm_buff1[j];
-  }
-  i=(i_end-n1[BCD_DEC])+(j_end-n2[BCD_DEC]);
-
-  if (i>Settings.DecPlaces)
+  if (i>ctx->Settings.DecPlaces)
   {
-    result[BCD_LEN]-=(i-Settings.DecPlaces-1);
+    result[BCD_LEN]-=(i-ctx->Settings.DecPlaces-1);
     result[BCD_DEC]=result[BCD_LEN];
 
-    if (result[result[BCD_LEN]+2]>4)
+    if (GetDigit(ctx,result,result[BCD_LEN]-1)>4)
     {
-      ImmedBCD("10",temp);
-      AddBCD(perm_buff1,result,temp);
-      CopyBCD(result,perm_buff1);
+      AddBCD(ctx,perm_buff1,result,perm_ten);
+      CopyBCD(ctx,result,perm_buff1);
     }
     result[BCD_LEN]-=1;
-    i=Settings.DecPlaces+1;
+    i=ctx->Settings.DecPlaces+1;
   }
   result[BCD_DEC]-=i;
   result[BCD_SIGN]=n1[BCD_SIGN]^n2[BCD_SIGN];
+  if (i_zeros+j_zeros) ShiftDecBCD(ctx,result,i_zeros+j_zeros);
+
+  FullShrinkBCD(ctx,result);
+  #endif
+}
 
-  FullShrinkBCD(result);
+static int MultDigits(struct CalcContext *ctx, const unsigned char *n1, const unsigned char *n2)
+{
+  #pragma MM_VAR n1
+  #pragma MM_VAR n2
+
+  //The limb version only stores the rounded product but the digit by digit one works
+  //out all of it first. Rounding can carry into one more digit in both.
+  #ifdef LIMB_MATH
+  int frac;
+
+  frac=(n1[BCD_LEN]-n1[BCD_DEC])+(n2[BCD_LEN]-n2[BCD_DEC]);
+  if (frac>ctx->Settings.DecPlaces) frac=ctx->Settings.DecPlaces;
+  return n1[BCD_DEC]+n2[BCD_DEC]+frac+1;
+  #else
+  return n1[BCD_LEN]+n2[BCD_LEN]+1;
+  #endif
 }
 
-static void DivBCD(unsigned char *result, const unsigned char *n1, const unsigned char *n2)
+static void DivBCD(struct CalcContext *ctx, unsigned char *result, const unsigned char *n1, const unsigned char *n2)
 {
   #pragma MM_VAR result
   #pragma MM_VAR n1
   #pragma MM_VAR n2
 
+  #ifdef LIMB_MATH
+  LimbDivBCD(ctx,result,n1,n2);
+  #else
   int i,j;
   int i_end, j_end;
   int result_ptr,n1_ptr;
@@ -632,11 +1206,11 @@ static void DivBCD(unsigned char *result, const unsigned char *n1, const unsigne
 
   max_offset=n1[BCD_LEN]-n1[BCD_DEC];
   if ((n2[BCD_LEN]-n2[BCD_DEC])>max_offset) max_offset=n2[BCD_LEN]-n2[BCD_DEC];
-  if (Settings.DecPlaces>max_offset) max_offset=Settings.DecPlaces;
+  if (ctx->Settings.DecPlaces>max_offset) max_offset=ctx->Settings.DecPlaces;
 
   result[BCD_LEN]=0;
 
-  result_ptr=3;
+  result_ptr=0;
 
   post_offset=n1[BCD_LEN]-n2[BCD_LEN];
 
@@ -653,7 +1227,7 @@ static void DivBCD(unsigned char *result, const unsigned char *n1, const unsigne
       result[BCD_DEC]=0;
       result_ptr+=pre_offset;
       res_ptr_off+=pre_offset;
-      for (i=3;i<(pre_offset+3);i++) result[i]=0;
+      for (i=0;i<pre_offset;i++) SetDigit(ctx,result,i,0);
     }
   }
   else if (post_offset>0)
@@ -674,69 +1248,76 @@ static void DivBCD(unsigned char *result, const unsigned char *n1, const unsigne
   perm_buff1[BCD_SIGN]=0;
   perm_buff1[BCD_LEN]=n2[BCD_LEN]+1;
   perm_buff1[BCD_DEC]=perm_buff1[BCD_LEN];
-  perm_buff1[3]=0;
+  SetDigit(ctx,perm_buff1,0,0);
 
-  i_end=n2[BCD_LEN]+3;
-  for (i=3;i<i_end;i++)
+  i_end=n2[BCD_LEN];
+  for (i=0;i<i_end;i++)
   {
-    if ((i-3)<post_offset) perm_buff1[i+1]=0;
-    else if ((i-post_offset)>(n1[BCD_LEN]+2)) perm_buff1[i+1]=0;
-    else perm_buff1[i+1]=n1[i-post_offset];
-    perm_buff2[i]=n2[i];
+    if (i<post_offset) SetDigit(ctx,perm_buff1,i+1,0);
+    else if ((i-post_offset)>=n1[BCD_LEN]) SetDigit(ctx,perm_buff1,i+1,0);
+    else SetDigit(ctx,perm_buff1,i+1,GetDigit(ctx,n1,i-post_offset));
   }
+  i_end=BCD_BYTES(n2[BCD_LEN])+3;
+  for (i=3;i<i_end;i++) perm_buff2[i]=n2[i];
 
-  n1_ptr=n2[BCD_LEN]+3+post_offset;
+  n1_ptr=n2[BCD_LEN]+post_offset;
   do
   {
-    result[result_ptr]=0;
+    SetDigit(ctx,result,result_ptr,0);
     result[BCD_LEN]+=1;
 
     do
     {
-      AddBCD(perm_buff3,perm_buff1,perm_buff2);
+      AddBCD(ctx,perm_buff3,perm_buff1,perm_buff2);
 
-      if ((perm_buff3[BCD_SIGN]==0)||(IsZero(perm_buff3)))
+      if ((perm_buff3[BCD_SIGN]==0)||(IsZero(ctx,perm_buff3)))
       {
-        result[result_ptr]+=1;
-        if (result[result_ptr]==10)
+        j=GetDigit(ctx,result,result_ptr)+1;
+        if (j==10)
         {
-          result[result_ptr]=0;
-          for (i=result_ptr-1;i>=3;i--)
+          SetDigit(ctx,result,result_ptr,0);
+          for (i=result_ptr-1;i>=0;i--)
           {
-            result[i]+=1;
-            if (result[i]<10) break;
-            else result[i]=0;
+            j=GetDigit(ctx,result,i)+1;
+            if (j<10)
+            {
+              SetDigit(ctx,result,i,j);
+              break;
+            }
+            else SetDigit(ctx,result,i,0);
           }
-          if (i==2)
+          if (i==-1)
           {
-            result[3]=1;
-            for (i=4;i<result_ptr;i++) result[i]=0;
+            SetDigit(ctx,result,0,1);
+            for (i=1;i<result_ptr;i++) SetDigit(ctx,result,i,0);
             result_ptr++;
             result[BCD_LEN]+=1;
             result[BCD_DEC]+=1;
-            result[result_ptr]=0;
+            SetDigit(ctx,result,result_ptr,0);
           }
         }
-        i_end=perm_buff1[BCD_LEN]+3;
+        else SetDigit(ctx,result,result_ptr,j);
+        i_end=BCD_BYTES(perm_buff1[BCD_LEN])+3;
         for (i=3;i<i_end;i++) perm_buff1[i]=perm_buff3[i];
       }
-    } while ((perm_buff3[BCD_SIGN]==0)&&(!IsZero(perm_buff3)));
+    } while ((perm_buff3[BCD_SIGN]==0)&&(!IsZero(ctx,perm_buff3)));
 
-    i_end=n2[BCD_LEN]+3;
-    for (i=3;i<i_end;i++) perm_buff1[i]=perm_buff1[i+1];
+    //Shift the remainder left by one digit
+    i_end=BCD_BYTES(perm_buff1[BCD_LEN])+3;
+    for (i=3;i<i_end;i++) perm_buff1[i]=(perm_buff1[i]<<4)|(perm_buff1[i+1]>>4);
 
-    if ((n1_ptr-3)>=n1[BCD_LEN])
+    if (n1_ptr>=n1[BCD_LEN])
     {
-      perm_buff1[i]=0;
+      SetDigit(ctx,perm_buff1,n2[BCD_LEN],0);
     }
     else
     {
-      perm_buff1[i]=n1[n1_ptr];
+      SetDigit(ctx,perm_buff1,n2[BCD_LEN],GetDigit(ctx,n1,n1_ptr));
       n1_ptr++;
     }
     result_ptr++;
 
-    if ((result_ptr-3)<(result[BCD_DEC]))
+    if (result_ptr<(result[BCD_DEC]))
     {
       logic=true;
     }
@@ -749,9 +1330,9 @@ static void DivBCD(unsigned char *result, const unsigned char *n1, const unsigne
 
   if ((result[BCD_LEN]-result[BCD_DEC])>max_offset)
   {
-    if (result[result[BCD_LEN]+2]>4)
+    if (GetDigit(ctx,result,result[BCD_LEN]-1)>4)
     {
-      i_end=result[BCD_LEN]+2;
+      i_end=BCD_BYTES(result[BCD_LEN]-1)+3;
       for (i=3;i<i_end;i++) perm_buff3[i]=result[i];
       i=result[BCD_LEN];
       j=result[BCD_DEC];
@@ -761,8 +1342,8 @@ static void DivBCD(unsigned char *result, const unsigned char *n1, const unsigne
       perm_buff1[BCD_SIGN]=0;
       perm_buff1[BCD_LEN]=1;
       perm_buff1[BCD_DEC]=1;
-      perm_buff1[3]=1;
-      AddBCD(result,perm_buff3,perm_buff1);
+      perm_buff1[3]=0x10;
+      AddBCD(ctx,result,perm_buff3,perm_buff1);
       result[BCD_DEC]=j;
       if (result[BCD_LEN]==i) result[BCD_DEC]+=1;
     }
@@ -772,118 +1353,921 @@ static void DivBCD(unsigned char *result, const unsigned char *n1, const unsigne
     }
   }
   result[BCD_SIGN]=n1[BCD_SIGN]^n2[BCD_SIGN];
-  FullShrinkBCD(result);
-  if ((result[BCD_LEN]-result[BCD_DEC])>Settings.DecPlaces) result[BCD_LEN]=result[BCD_DEC]+Settings.DecPlaces;
-
+  FullShrinkBCD(ctx,result);
+  if ((result[BCD_LEN]-result[BCD_DEC])>ctx->Settings.DecPlaces) result[BCD_LEN]=result[BCD_DEC]+ctx->Settings.DecPlaces;
+  #endif
 }
 
-static void ShrinkBCD(unsigned char *dest,unsigned char *src)
+static void ModBCD(struct CalcContext *ctx, unsigned char *result, unsigned char *n1, unsigned char *n2)
 {
-  #pragma MM_VAR dest
-  #pragma MM_VAR src
+  #pragma MM_VAR result
+  #pragma MM_VAR n1
+  #pragma MM_VAR n2
 
-  int BCD_ptr,off_ptr=0;
-  int ptr_end;
-  if ((src[3]==0)&&(src[BCD_DEC]!=0)&&(src[BCD_LEN]>1)) off_ptr=1;
-  ptr_end=src[BCD_LEN]+3-off_ptr;
-  for (BCD_ptr=3;BCD_ptr<ptr_end;BCD_ptr++) dest[BCD_ptr]=src[BCD_ptr+off_ptr];
-  dest[BCD_SIGN]=src[BCD_SIGN];
-  dest[BCD_LEN]=src[BCD_LEN];
-  dest[BCD_DEC]=src[BCD_DEC];
-  if (off_ptr==1)
+  unsigned char sign,comp;
+  int places;
+  bool flip;
+
+  //n1 is already the remainder when it is smaller than n2
+  sign=n1[BCD_SIGN];
+  flip=(sign!=n2[BCD_SIGN]);
+  if (flip) n2[BCD_SIGN]=sign;
+  comp=CompVarBCD(ctx,n1,n2);
+  if (flip) n2[BCD_SIGN]=!sign;
+  if (comp==COMP_EQ)
+  {
+    CopyBCD(ctx,result,perm_zero);
+    return;
+  }
+  else if ((comp==COMP_LT)==(sign==0))
+  {
+    if (result!=n1) CopyBCD(ctx,result,n1);
+    return;
+  }
+
+  //Take off the whole part of the quotient times n2. The cost depends on the number of
+  //digits rather than the size of the quotient.
+  DivBCD(ctx,p0,n1,n2);
+  p0[BCD_LEN]=p0[BCD_DEC];
+  //The product has to keep every decimal place of n2 or the remainder is rounded off
+  places=ctx->Settings.DecPlaces;
+  if ((n2[BCD_LEN]-n2[BCD_DEC])>places) ctx->Settings.DecPlaces=n2[BCD_LEN]-n2[BCD_DEC];
+  MultBCD(ctx,p1,p0,n2);
+  ctx->Settings.DecPlaces=places;
+  SubBCD(ctx,result,n1,p1);
+
+  //Only needed if the quotient came out one too far from zero
+  if ((result[BCD_SIGN]!=sign)&&(!IsZero(ctx,result)))
   {
-    dest[BCD_LEN]-=1;
-    dest[BCD_DEC]-=1;
+    if (n2[BCD_SIGN]==sign) AddBCD(ctx,p1,result,n2);
+    else SubBCD(ctx,p1,result,n2);
+    CopyBCD(ctx,result,p1);
   }
 }
 
-static void FullShrinkBCD(unsigned char *n1)
+static void FullShrinkBCD(struct CalcContext *ctx, unsigned char *n1)
 {
   #pragma MM_VAR n1
-  while ((n1[3]==0)&&(n1[BCD_DEC]>1)) ShrinkBCD(n1,n1);
+  int i,i_end,amount;
+
+  //Count the leading zeroes first so the digits only have to be moved once
+  amount=LeadDigit(ctx,n1);
+  if (amount>n1[BCD_DEC]-1) amount=n1[BCD_DEC]-1;
+  if (amount<=0) return;
+
+  i_end=BCD_BYTES(n1[BCD_LEN]-amount)+3;
+  if (amount&1)
+  {
+    for (i=3;i<i_end;i++) n1[i]=(n1[i+(amount>>1)]<<4)|(n1[i+(amount>>1)+1]>>4);
+  }
+  else
+  {
+    for (i=3;i<i_end;i++) n1[i]=n1[i+(amount>>1)];
+  }
+  n1[BCD_LEN]-=amount;
+  n1[BCD_DEC]-=amount;
 }
 
-static void PadBCD(unsigned char *n1, int amount)
+static void PadBCD(struct CalcContext *ctx, unsigned char *n1, int amount)
 {
   #pragma MM_VAR n1
-  int i;
-  for (i=n1[BCD_LEN]+3;i>=3;i--) n1[i+amount]=n1[i];
-  for (i=3;i<(amount+3);i++) n1[i]=0;
+  int i,i_end,shift=amount>>1;
+
+  //Move the digits a byte at a time starting from the end so none are overwritten
+  //before they are read
+  i_end=BCD_BYTES(n1[BCD_LEN]+amount)+3;
+  if (amount&1)
+  {
+    for (i=i_end-1;i>shift+3;i--) n1[i]=(n1[i-shift-1]<<4)|(n1[i-shift]>>4);
+    n1[shift+3]=n1[3]>>4;
+  }
+  else
+  {
+    for (i=i_end-1;i>=shift+3;i--) n1[i]=n1[i-shift];
+  }
+  for (i=3;i<shift+3;i++) n1[i]=0;
   n1[BCD_LEN]+=amount;
   n1[BCD_DEC]+=amount;
 }
 
-static bool IsZero(unsigned char *n1)
+static bool IsZero(struct CalcContext *ctx, unsigned char *n1)
 {
   #pragma MM_VAR n1
   int i,i_end;
-  i_end=n1[BCD_LEN]+3;
+  i_end=(n1[BCD_LEN]>>1)+3;
   for (i=3;i<i_end;i++) if (n1[i]!=0) return false;
+  if ((n1[BCD_LEN]&1)&&(n1[i]&0xF0)) return false;
   return true;
 }
 
-static void CopyBCD(unsigned char *dest, unsigned char *src)
+static int TrailingZeros(struct CalcContext *ctx, const unsigned char *n1)
+{
+  #pragma MM_VAR n1
+  int i;
+  if (n1[BCD_LEN]!=n1[BCD_DEC]) return 0;
+  //Zero keeps one digit
+  i=TrailDigit(ctx,n1);
+  if ((i==0)&&(n1[BCD_LEN])) i=1;
+  return n1[BCD_LEN]-i;
+}
+
+static int TrailDigit(struct CalcContext *ctx, const unsigned char *n1)
+{
+  #pragma MM_VAR n1
+  int i=n1[BCD_LEN];
+
+  //An odd length ends with one digit in the high nibble
+  if (i&1)
+  {
+    if (GetDigit(ctx,n1,i-1)) return i;
+    i--;
+  }
+  while ((i>0)&&(n1[(i>>1)+2]==0)) i-=2;
+  if ((i>0)&&((n1[(i>>1)+2]&0xF)==0)) i--;
+  return i;
+}
+
+static void ShiftDecBCD(struct CalcContext *ctx, unsigned char *n1, int amount)
+{
+  #pragma MM_VAR n1
+  int i,i_end;
+  i_end=n1[BCD_DEC]+amount;
+  for (i=n1[BCD_LEN];i<i_end;i++) SetDigit(ctx,n1,i,0);
+  if (i_end>n1[BCD_LEN]) n1[BCD_LEN]=i_end;
+  n1[BCD_DEC]=i_end;
+}
+
+static int FracZeros(struct CalcContext *ctx, const unsigned char *n1, int known)
+{
+  #pragma MM_VAR n1
+  int i=0;
+  if (known>0) i=n1[BCD_DEC]+known;
+  for (;i<n1[BCD_LEN];i++) if (GetDigit(ctx,n1,i)) return i-n1[BCD_DEC];
+  return MATH_CELL_SIZE*2;
+}
+
+static unsigned char GetDigit(struct CalcContext *ctx, const unsigned char *n1, int digit)
+{
+  #pragma MM_VAR n1
+  if (digit&1) return n1[(digit>>1)+3]&0xF;
+  else return n1[(digit>>1)+3]>>4;
+}
+
+static void SetDigit(struct CalcContext *ctx, unsigned char *n1, int digit, unsigned char value)
+{
+  #pragma MM_VAR n1
+  unsigned char b0;
+  b0=n1[(digit>>1)+3];
+  if (digit&1) n1[(digit>>1)+3]=(b0&0xF0)|value;
+  else n1[(digit>>1)+3]=(b0&0x0F)|(value<<4);
+}
+
+static void CopyBCD(struct CalcContext *ctx, unsigned char *dest, unsigned char *src)
 {
   #pragma MM_VAR dest
   #pragma MM_VAR src
   int i,i_end;
-  i_end=src[BCD_LEN]+3;
+  i_end=BCD_BYTES(src[BCD_LEN])+3;
   for (i=0;i<i_end;i++) dest[i]=src[i];
 }
 
-static void MakeTables()
+#ifdef LIMB_MATH
+static int LimbLoad(struct CalcContext *ctx, unsigned long *limbs, const unsigned char *n1, int shift)
 {
-  //The first number of every line is the number of BCD bytes that follow it.
-  //Log table
-  static const unsigned char table[]={
-  17 ,0x88,0x72,0x28,0x39,0x11,0x16,0x72,0x99,0x96,0x05,0x40,0x57,0x11,0x54,0x66,0x46,0x60,
-  17 ,0x44,0x36,0x14,0x19,0x55,0x58,0x36,0x49,0x98,0x02,0x70,0x28,0x55,0x77,0x33,0x23,0x30,
-  17 ,0x22,0x18,0x07,0x09,0x77,0x79,0x18,0x24,0x99,0x01,0x35,0x14,0x27,0x88,0x66,0x61,0x65,
-  17 ,0x11,0x09,0x03,0x54,0x88,0x89,0x59,0x12,0x49,0x50,0x67,0x57,0x13,0x94,0x33,0x30,0x83,
-  17 ,0x05,0x54,0x51,0x77,0x44,0x44,0x79,0x56,0x24,0x75,0x33,0x78,0x56,0x97,0x16,0x65,0x41,
-  17 ,0x02,0x77,0x25,0x88,0x72,0x22,0x39,0x78,0x12,0x37,0x66,0x89,0x28,0x48,0x58,0x32,0x71,
-  17 ,0x01,0x38,0x62,0x94,0x36,0x11,0x19,0x89,0x06,0x18,0x83,0x44,0x64,0x24,0x29,0x16,0x35,
-  16 ,0x69,0x31,0x47,0x18,0x05,0x59,0x94,0x53,0x09,0x41,0x72,0x32,0x12,0x14,0x58,0x18,
-  16 ,0x40,0x54,0x65,0x10,0x81,0x08,0x16,0x43,0x81,0x97,0x80,0x13,0x11,0x54,0x64,0x35,
-  16 ,0x22,0x31,0x43,0x55,0x13,0x14,0x20,0x97,0x55,0x76,0x62,0x95,0x09,0x03,0x09,0x83,
-  16 ,0x11,0x77,0x83,0x03,0x56,0x56,0x38,0x34,0x54,0x53,0x87,0x94,0x10,0x94,0x70,0x52,
-  16 ,0x06,0x06,0x24,0x62,0x18,0x16,0x43,0x48,0x42,0x58,0x06,0x06,0x13,0x20,0x40,0x42,
-  16 ,0x03,0x07,0x71,0x65,0x86,0x66,0x75,0x36,0x88,0x37,0x10,0x28,0x20,0x75,0x96,0x77,
-  16 ,0x01,0x55,0x04,0x18,0x65,0x35,0x96,0x52,0x54,0x15,0x08,0x54,0x04,0x60,0x42,0x45,
-  15 ,0x77,0x82,0x14,0x04,0x42,0x05,0x49,0x48,0x94,0x74,0x62,0x90,0x00,0x61,0x14,
-  15 ,0x38,0x98,0x64,0x04,0x15,0x65,0x73,0x23,0x01,0x39,0x37,0x34,0x30,0x95,0x84,
-  15 ,0x19,0x51,0x22,0x01,0x31,0x26,0x17,0x49,0x43,0x96,0x74,0x04,0x95,0x31,0x84,
-  15 ,0x09,0x76,0x08,0x59,0x73,0x05,0x54,0x58,0x89,0x59,0x60,0x82,0x49,0x08,0x02,
-  15 ,0x04,0x88,0x16,0x20,0x79,0x50,0x13,0x51,0x18,0x85,0x37,0x04,0x96,0x92,0x65,
-  15 ,0x02,0x44,0x11,0x08,0x27,0x52,0x73,0x62,0x70,0x91,0x60,0x47,0x90,0x85,0x82,
-  15 ,0x01,0x22,0x06,0x28,0x62,0x52,0x56,0x77,0x37,0x16,0x23,0x05,0x53,0x67,0x16,
-  14 ,0x61,0x03,0x32,0x93,0x68,0x06,0x38,0x52,0x49,0x13,0x15,0x87,0x89,0x65,
-  14 ,0x30,0x51,0x71,0x12,0x47,0x31,0x86,0x37,0x85,0x69,0x06,0x95,0x14,0x17,
-  14 ,0x15,0x25,0x86,0x72,0x64,0x83,0x62,0x39,0x74,0x05,0x75,0x73,0x25,0x13,
-  14 ,0x07,0x62,0x93,0x65,0x42,0x75,0x67,0x57,0x21,0x55,0x88,0x52,0x96,0x85,
-  14 ,0x03,0x81,0x46,0x89,0x98,0x96,0x85,0x88,0x94,0x80,0x71,0x17,0x84,0x98,
-  14 ,0x01,0x90,0x73,0x46,0x81,0x38,0x25,0x40,0x94,0x15,0x46,0x94,0x42,0x51,
-  13 ,0x95,0x36,0x73,0x86,0x16,0x59,0x18,0x82,0x33,0x90,0x84,0x15,0x51,
-  13 ,0x47,0x68,0x37,0x04,0x45,0x16,0x32,0x34,0x18,0x44,0x34,0x61,0x75,
-  13 ,0x23,0x84,0x18,0x55,0x06,0x79,0x85,0x75,0x87,0x10,0x42,0x36,0x79,
-  13 ,0x11,0x92,0x09,0x28,0x24,0x45,0x35,0x44,0x57,0x08,0x75,0x79,0x16,
-  13 ,0x05,0x96,0x04,0x64,0x29,0x99,0x03,0x38,0x56,0x18,0x58,0x25,0x32,
-  13 ,0x02,0x98,0x02,0x32,0x19,0x43,0x60,0x61,0x11,0x47,0x31,0x97,0x05,
-  13 ,0x01,0x49,0x01,0x16,0x10,0x82,0x82,0x53,0x54,0x89,0x03,0x91,0x82,
-  12 ,0x74,0x50,0x58,0x05,0x69,0x16,0x82,0x52,0x64,0x72,0x34,0x52,
-  12 ,0x37,0x25,0x29,0x02,0x91,0x52,0x30,0x20,0x17,0x58,0x25,0x70,
-  12 ,0x18,0x62,0x64,0x51,0x47,0x49,0x62,0x33,0x55,0x74,0x27,0x31,
-  12 ,0x09,0x31,0x32,0x25,0x74,0x18,0x17,0x97,0x64,0x69,0x00,0x06,
-  12 ,0x04,0x65,0x66,0x12,0x87,0x19,0x93,0x19,0x04,0x05,0x97,0x61,
-  12 ,0x02,0x32,0x83,0x06,0x43,0x62,0x67,0x64,0x57,0x45,0x98,0x32,
-  12 ,0x01,0x16,0x41,0x53,0x21,0x82,0x01,0x58,0x55,0x08,0x75,0x62,
-  11 ,0x58,0x20,0x76,0x60,0x91,0x17,0x73,0x34,0x13,0x32,0x12,
-  11 ,0x29,0x10,0x38,0x30,0x45,0x63,0x10,0x18,0x71,0x39,0x66,
-  11 ,0x14,0x55,0x19,0x15,0x22,0x82,0x60,0x97,0x26,0x88,0x23,
-  11 ,0x07,0x27,0x59,0x57,0x61,0x41,0x56,0x95,0x61,0x23,0x72,
-  11 ,0x03,0x63,0x79,0x78,0x80,0x70,0x85,0x09,0x55,0x06,0x76,
-  11 ,0x01,0x81,0x89,0x89,0x40,0x35,0x44,0x20,0x21,0x14,0x60,
-  10 ,0x90,0x94,0x94,0x70,0x17,0x72,0x51,0x46,0x47,0x61,
+  #pragma MM_VAR n1
+  int i,i_end,count,weight;
+  unsigned char b0=0;
+
+  i_end=n1[BCD_LEN];
+  count=(shift+i_end+LIMB_DIGITS-1)/LIMB_DIGITS;
+  if (count<0) count=0;
+  for (i=0;i<count;i++) limbs[i]=0;
+
+  for (i=0;i<i_end;i++)
+  {
+    //Digits shifted below the ones place are dropped
+    weight=shift+i_end-1-i;
+    if (weight<0) break;
+    if ((i&1)==0) b0=n1[(i>>1)+3];
+    if (i&1) limbs[weight/LIMB_DIGITS]+=(b0&0xF)*limb_pow10[weight%LIMB_DIGITS];
+    else limbs[weight/LIMB_DIGITS]+=(b0>>4)*limb_pow10[weight%LIMB_DIGITS];
+  }
+
+  while ((count>0)&&(limbs[count-1]==0)) count--;
+  return count;
+}
+
+static void LimbStore(struct CalcContext *ctx, unsigned char *n1, const unsigned long *limbs, int count, int width)
+{
+  #pragma MM_VAR n1
+  int i,weight;
+  unsigned char digit,high=0;
+
+  for (i=0;i<width;i++)
+  {
+    weight=width-1-i;
+    if ((weight/LIMB_DIGITS)<count) digit=(limbs[weight/LIMB_DIGITS]/limb_pow10[weight%LIMB_DIGITS])%10;
+    else digit=0;
+    if (i&1) n1[(i>>1)+3]=high|digit;
+    else high=digit<<4;
+  }
+  if (width&1) n1[(width>>1)+3]=high;
+}
+
+static int LimbDigits(const unsigned long *limbs, int count)
+{
+  int digits;
+  unsigned long top;
+  if (count==0) return 0;
+  digits=(count-1)*LIMB_DIGITS;
+  for (top=limbs[count-1];top;top/=10) digits++;
+  return digits;
+}
+
+static int LimbComp(const unsigned long *n1, int n1_count, const unsigned long *n2, int n2_count)
+{
+  int i;
+  if (n1_count>n2_count) return COMP_GT;
+  if (n1_count<n2_count) return COMP_LT;
+  for (i=n1_count-1;i>=0;i--)
+  {
+    if (n1[i]>n2[i]) return COMP_GT;
+    if (n1[i]<n2[i]) return COMP_LT;
+  }
+  return COMP_EQ;
+}
+
+static int LimbAdd(unsigned long *result, const unsigned long *n1, int n1_count, const unsigned long *n2, int n2_count)
+{
+  int i,i_end;
+  unsigned long t1,carry=0;
+
+  i_end=n1_count;
+  if (n2_count>i_end) i_end=n2_count;
+  for (i=0;i<i_end;i++)
+  {
+    t1=carry;
+    if (i<n1_count) t1+=n1[i];
+    if (i<n2_count) t1+=n2[i];
+    if (t1>=LIMB_BASE)
+    {
+      t1-=LIMB_BASE;
+      carry=1;
+    }
+    else carry=0;
+    result[i]=t1;
+  }
+  if (carry) result[i_end++]=1;
+  return i_end;
+}
+
+static int LimbSub(unsigned long *result, const unsigned long *n1, int n1_count, const unsigned long *n2, int n2_count)
+{
+  int i;
+  unsigned long t1,borrow=0;
+
+  for (i=0;i<n1_count;i++)
+  {
+    t1=borrow;
+    if (i<n2_count) t1+=n2[i];
+    if (n1[i]<t1)
+    {
+      result[i]=n1[i]+LIMB_BASE-t1;
+      borrow=1;
+    }
+    else
+    {
+      result[i]=n1[i]-t1;
+      borrow=0;
+    }
+  }
+  while ((i>0)&&(result[i-1]==0)) i--;
+  return i;
+}
+
+static int LimbMult(struct CalcContext *ctx, unsigned long *result, const unsigned long *n1, int n1_count, const unsigned long *n2, int n2_count)
+{
+  int i,j,i_end;
+  unsigned long long t1;
+  unsigned long carry;
+
+  if ((n1_count==0)||(n2_count==0)) return 0;
+  i_end=n1_count+n2_count;
+
+  if ((n1_count>=LIMB_KARATSUBA)&&(n2_count>=LIMB_KARATSUBA))
+  {
+    //Pad the shorter number so both halves line up
+    j=n1_count;
+    if (n2_count>j) j=n2_count;
+    for (i=0;i<j;i++)
+    {
+      ctx->limb_k[i]=0;
+      ctx->limb_k[i+j]=0;
+      if (i<n1_count) ctx->limb_k[i]=n1[i];
+      if (i<n2_count) ctx->limb_k[i+j]=n2[i];
+    }
+    LimbKaratsuba(ctx,result,ctx->limb_k,ctx->limb_k+j,j,ctx->limb_k+j*2);
+    while ((i_end>0)&&(result[i_end-1]==0)) i_end--;
+    return i_end;
+  }
+
+  for (i=0;i<i_end;i++) result[i]=0;
+  for (i=0;i<n1_count;i++)
+  {
+    carry=0;
+    for (j=0;j<n2_count;j++)
+    {
+      t1=(unsigned long long)n1[i]*n2[j]+result[i+j]+carry;
+      result[i+j]=t1%LIMB_BASE;
+      carry=t1/LIMB_BASE;
+    }
+    result[i+n2_count]=carry;
+  }
+
+  while ((i_end>0)&&(result[i_end-1]==0)) i_end--;
+  return i_end;
+}
+
+static void LimbKaratsuba(struct CalcContext *ctx, unsigned long *result, const unsigned long *n1, const unsigned long *n2, int count, unsigned long *scratch)
+{
+  int i,low,high;
+  unsigned long *sum1,*sum2,*middle;
+  unsigned long t1,carry;
+
+  //Result always has count*2 limbs, including leading zero limbs
+  if (count<LIMB_KARATSUBA)
+  {
+    i=LimbMult(ctx,result,n1,count,n2,count);
+    for (;i<count*2;i++) result[i]=0;
+    return;
+  }
+
+  low=count/2;
+  high=count-low;
+  sum1=scratch;
+  sum2=sum1+high+1;
+  middle=sum2+high+1;
+
+  //(a*B+b)(c*B+d) = ac*B^2 + ((a+b)(c+d)-ac-bd)*B + bd
+  LimbKaratsuba(ctx,result,n1,n2,low,scratch);
+  LimbKaratsuba(ctx,result+low*2,n1+low,n2+low,high,scratch);
+
+  sum1[high]=LimbAdd(sum1,n1,low,n1+low,high)-high;
+  sum2[high]=LimbAdd(sum2,n2,low,n2+low,high)-high;
+  LimbKaratsuba(ctx,middle,sum1,sum2,high+1,middle+(high+1)*2);
+  LimbSub(middle,middle,(high+1)*2,result,low*2);
+  LimbSub(middle,middle,(high+1)*2,result+low*2,high*2);
+
+  carry=0;
+  for (i=0;i<(high+1)*2;i++)
+  {
+    if ((i+low)>=count*2) break;
+    t1=result[i+low]+middle[i]+carry;
+    if (t1>=LIMB_BASE)
+    {
+      t1-=LIMB_BASE;
+      carry=1;
+    }
+    else carry=0;
+    result[i+low]=t1;
+  }
+  for (i+=low;(carry)&&(i<count*2);i++)
+  {
+    t1=result[i]+carry;
+    if (t1>=LIMB_BASE)
+    {
+      t1-=LIMB_BASE;
+      carry=1;
+    }
+    else carry=0;
+    result[i]=t1;
+  }
+}
+
+static int LimbDiv(struct CalcContext *ctx, unsigned long *result, const unsigned long *n1, int n1_count, const unsigned long *n2, int n2_count)
+{
+  int i,j,count;
+  unsigned long scale,carry,borrow;
+  unsigned long long t1,guess,guess_rem;
+  unsigned long v[LIMB_MAX];
+
+  if ((n2_count==0)||(n1_count<n2_count)) return 0;
+  if ((n2_count>=LIMB_NEWTON)&&(n1_count<LIMB_MAX)) return LimbNewtonDiv(ctx,result,n1,n1_count,n2,n2_count);
+
+  //Short division when the divisor fits in one limb
+  if (n2_count==1)
+  {
+    t1=0;
+    for (i=n1_count-1;i>=0;i--)
+    {
+      t1=t1*LIMB_BASE+n1[i];
+      result[i]=t1/n2[0];
+      t1%=n2[0];
+    }
+    count=n1_count;
+    while ((count>0)&&(result[count-1]==0)) count--;
+    return count;
+  }
+
+  //Long division guessing one limb of the quotient at a time. Scaling both numbers
+  //so the top limb of the divisor is large keeps each guess at most two too big.
+  scale=LIMB_BASE/(n2[n2_count-1]+1);
+  carry=0;
+  for (i=0;i<n2_count;i++)
+  {
+    t1=(unsigned long long)n2[i]*scale+carry;
+    v[i]=t1%LIMB_BASE;
+    carry=t1/LIMB_BASE;
+  }
+  carry=0;
+  for (i=0;i<n1_count;i++)
+  {
+    t1=(unsigned long long)n1[i]*scale+carry;
+    ctx->limb_a[i]=t1%LIMB_BASE;
+    carry=t1/LIMB_BASE;
+  }
+  ctx->limb_a[n1_count]=carry;
+
+  for (j=n1_count-n2_count;j>=0;j--)
+  {
+    t1=(unsigned long long)ctx->limb_a[j+n2_count]*LIMB_BASE+ctx->limb_a[j+n2_count-1];
+    guess=t1/v[n2_count-1];
+    guess_rem=t1%v[n2_count-1];
+    while ((guess>=LIMB_BASE)||(guess*v[n2_count-2]>guess_rem*LIMB_BASE+ctx->limb_a[j+n2_count-2]))
+    {
+      guess--;
+      guess_rem+=v[n2_count-1];
+      if (guess_rem>=LIMB_BASE) break;
+    }
+
+    carry=0;
+    borrow=0;
+    for (i=0;i<n2_count;i++)
+    {
+      t1=guess*v[i]+carry;
+      carry=t1/LIMB_BASE;
+      t1=t1%LIMB_BASE+borrow;
+      if (ctx->limb_a[i+j]<t1)
+      {
+        ctx->limb_a[i+j]=ctx->limb_a[i+j]+LIMB_BASE-t1;
+        borrow=1;
+      }
+      else
+      {
+        ctx->limb_a[i+j]-=t1;
+        borrow=0;
+      }
+    }
+    t1=carry+borrow;
+    if (ctx->limb_a[j+n2_count]<t1)
+    {
+      //Guess was one too big. Add the divisor back.
+      ctx->limb_a[j+n2_count]=ctx->limb_a[j+n2_count]+LIMB_BASE-t1;
+      guess--;
+      carry=0;
+      for (i=0;i<n2_count;i++)
+      {
+        t1=(unsigned long long)ctx->limb_a[i+j]+v[i]+carry;
+        ctx->limb_a[i+j]=t1%LIMB_BASE;
+        carry=t1/LIMB_BASE;
+      }
+      ctx->limb_a[j+n2_count]=(ctx->limb_a[j+n2_count]+carry)%LIMB_BASE;
+    }
+    else ctx->limb_a[j+n2_count]-=t1;
+    result[j]=guess;
+  }
+
+  count=n1_count-n2_count+1;
+  while ((count>0)&&(result[count-1]==0)) count--;
+  return count;
+}
+
+static int LimbNewtonDiv(struct CalcContext *ctx, unsigned long *result, const unsigned long *n1, int n1_count, const unsigned long *n2, int n2_count)
+{
+  int i,k,count,x_count,p_count,e_count;
+  bool above;
+  double guess;
+  unsigned long long t1;
+
+  //Find x close to B^k/n2 where B is LIMB_BASE and B^k is larger than n1
+  k=n1_count+1;
+
+  //First guess from the top two limbs of the divisor is good to about 15 digits
+  guess=(double)LIMB_BASE*LIMB_BASE*LIMB_BASE/((double)n2[n2_count-1]*LIMB_BASE+n2[n2_count-2]);
+  t1=(unsigned long long)guess;
+  x_count=k-n2_count+1;
+  for (i=0;i<x_count;i++) ctx->limb_x[i]=0;
+  ctx->limb_x[x_count-2]=t1%LIMB_BASE;
+  ctx->limb_x[x_count-1]=t1/LIMB_BASE;
+  while ((x_count>0)&&(ctx->limb_x[x_count-1]==0)) x_count--;
+
+  //x = x + x*(B^k - n2*x)/B^k roughly doubles the number of correct digits each time
+  for (i=0;i<16;i++)
+  {
+    p_count=LimbMult(ctx,ctx->limb_p,n2,n2_count,ctx->limb_x,x_count);
+    for (e_count=0;e_count<k;e_count++) ctx->limb_e[e_count]=0;
+    ctx->limb_e[k]=1;
+    e_count=k+1;
+    if (LimbComp(ctx->limb_p,p_count,ctx->limb_e,e_count)==COMP_GT)
+    {
+      above=true;
+      e_count=LimbSub(ctx->limb_e,ctx->limb_p,p_count,ctx->limb_e,e_count);
+    }
+    else
+    {
+      above=false;
+      e_count=LimbSub(ctx->limb_e,ctx->limb_e,e_count,ctx->limb_p,p_count);
+    }
+    p_count=LimbMult(ctx,ctx->limb_p,ctx->limb_x,x_count,ctx->limb_e,e_count);
+    if (p_count<=k) break;
+    for (count=0;count<p_count-k;count++) ctx->limb_p[count]=ctx->limb_p[count+k];
+    p_count-=k;
+    if (above) x_count=LimbSub(ctx->limb_x,ctx->limb_x,x_count,ctx->limb_p,p_count);
+    else x_count=LimbAdd(ctx->limb_x,ctx->limb_x,x_count,ctx->limb_p,p_count);
+  }
+
+  //The quotient is n1*x/B^k, which can be off by a little either way
+  p_count=LimbMult(ctx,ctx->limb_p,n1,n1_count,ctx->limb_x,x_count);
+  count=0;
+  if (p_count>k)
+  {
+    count=p_count-k;
+    for (i=0;i<count;i++) result[i]=ctx->limb_p[i+k];
+  }
+
+  //Correct it so result*n2 <= n1 < (result+1)*n2
+  ctx->limb_e[0]=1;
+  for (;;)
+  {
+    p_count=LimbMult(ctx,ctx->limb_p,result,count,n2,n2_count);
+    if (LimbComp(ctx->limb_p,p_count,n1,n1_count)!=COMP_GT) break;
+    count=LimbSub(result,result,count,ctx->limb_e,1);
+  }
+  for (;;)
+  {
+    p_count=LimbAdd(ctx->limb_p,ctx->limb_p,p_count,n2,n2_count);
+    if (LimbComp(ctx->limb_p,p_count,n1,n1_count)==COMP_GT) break;
+    count=LimbAdd(result,result,count,ctx->limb_e,1);
+  }
+  return count;
+}
+
+static int LimbShift(unsigned long *n1, int count, int amount)
+{
+  int i,limbs;
+  unsigned long long t1=0;
+  unsigned long divisor;
+
+  limbs=amount/LIMB_DIGITS;
+  if (limbs>=count) return 0;
+  if (limbs)
+  {
+    for (i=0;i<count-limbs;i++) n1[i]=n1[i+limbs];
+    count-=limbs;
+  }
+
+  divisor=limb_pow10[amount%LIMB_DIGITS];
+  if (divisor>1)
+  {
+    for (i=count-1;i>=0;i--)
+    {
+      t1=t1*LIMB_BASE+n1[i];
+      n1[i]=t1/divisor;
+      t1%=divisor;
+    }
+  }
+
+  while ((count>0)&&(n1[count-1]==0)) count--;
+  return count;
+}
+
+static void LimbAddBCD(struct CalcContext *ctx, unsigned char *result, const unsigned char *n1, const unsigned char *n2)
+{
+  #pragma MM_VAR result
+  #pragma MM_VAR n1
+  #pragma MM_VAR n2
+
+  int dec,len,n1_dec,n2_dec;
+  int a_count,b_count,count;
+  unsigned char sign;
+
+  //The result is laid out exactly as the digit by digit version would leave it
+  dec=n1[BCD_DEC];
+  if (n2[BCD_DEC]>dec) dec=n2[BCD_DEC];
+  n1_dec=n1[BCD_LEN]-n1[BCD_DEC];
+  n2_dec=n2[BCD_LEN]-n2[BCD_DEC];
+  len=n1_dec;
+  if (n2_dec>len) len=n2_dec;
+
+  a_count=LimbLoad(ctx,ctx->limb_a,n1,len-n1_dec);
+  b_count=LimbLoad(ctx,ctx->limb_b,n2,len-n2_dec);
+  len+=dec;
+
+  if (n1[BCD_SIGN]==n2[BCD_SIGN])
+  {
+    sign=n1[BCD_SIGN];
+    count=LimbAdd(ctx->limb_r,ctx->limb_a,a_count,ctx->limb_b,b_count);
+    if (LimbDigits(ctx->limb_r,count)>len)
+    {
+      len++;
+      dec++;
+    }
+  }
+  else
+  {
+    //Negative only if the negative number is strictly larger
+    if (LimbComp(ctx->limb_a,a_count,ctx->limb_b,b_count)==COMP_LT)
+    {
+      sign=n2[BCD_SIGN];
+      count=LimbSub(ctx->limb_r,ctx->limb_b,b_count,ctx->limb_a,a_count);
+    }
+    else
+    {
+      sign=n1[BCD_SIGN];
+      count=LimbSub(ctx->limb_r,ctx->limb_a,a_count,ctx->limb_b,b_count);
+    }
+    if (count==0) sign=0;
+  }
+
+  LimbStore(ctx,result,ctx->limb_r,count,len);
+  result[BCD_SIGN]=sign;
+  result[BCD_LEN]=len;
+  result[BCD_DEC]=dec;
+}
+
+static void LimbMultBCD(struct CalcContext *ctx, unsigned char *result, const unsigned char *n1, const unsigned char *n2)
+{
+  #pragma MM_VAR result
+  #pragma MM_VAR n1
+  #pragma MM_VAR n2
+
+  int i,len,count;
+  int a_count,b_count,a_zeros,b_zeros;
+  unsigned long last;
+  unsigned char sign;
+
+  //Zeroes at the end of whole numbers are left out, as in the digit by digit version
+  a_zeros=TrailingZeros(ctx,n1);
+  b_zeros=TrailingZeros(ctx,n2);
+  a_count=LimbLoad(ctx,ctx->limb_a,n1,-a_zeros);
+  b_count=LimbLoad(ctx,ctx->limb_b,n2,-b_zeros);
+  count=LimbMult(ctx,ctx->limb_r,ctx->limb_a,a_count,ctx->limb_b,b_count);
+
+  //Width of the product before rounding, matching the digit by digit version
+  if ((n1[BCD_LEN]==0)||(n2[BCD_LEN]==0)) len=1;
+  else len=n1[BCD_LEN]+n2[BCD_LEN]-a_zeros-b_zeros;
+  i=(n1[BCD_LEN]-n1[BCD_DEC])+(n2[BCD_LEN]-n2[BCD_DEC]);
+  sign=n1[BCD_SIGN]^n2[BCD_SIGN];
+
+  if (i>ctx->Settings.DecPlaces)
+  {
+    //Keep one extra decimal place to round with
+    count=LimbShift(ctx->limb_r,count,i-ctx->Settings.DecPlaces-1);
+    len-=i-ctx->Settings.DecPlaces-1;
+    last=0;
+    if (count) last=ctx->limb_r[0]%10;
+    count=LimbShift(ctx->limb_r,count,1);
+    if (last>4)
+    {
+      ctx->limb_b[0]=1;
+      count=LimbAdd(ctx->limb_r,ctx->limb_r,count,ctx->limb_b,1);
+      if (len<2) len=2;
+      if (LimbDigits(ctx->limb_r,count)>=len) len++;
+    }
+    len-=1;
+    i=ctx->Settings.DecPlaces;
+  }
+
+  LimbStore(ctx,result,ctx->limb_r,count,len);
+  result[BCD_SIGN]=sign;
+  result[BCD_LEN]=len;
+  result[BCD_DEC]=len-i;
+  if (a_zeros+b_zeros) ShiftDecBCD(ctx,result,a_zeros+b_zeros);
+
+  FullShrinkBCD(ctx,result);
+}
+
+static void LimbDivBCD(struct CalcContext *ctx, unsigned char *result, const unsigned char *n1, const unsigned char *n2)
+{
+  #pragma MM_VAR result
+  #pragma MM_VAR n1
+  #pragma MM_VAR n2
+
+  int len,dec,steps,digits,count;
+  int a_count,b_count;
+  int max_offset,pre_offset=0,post_offset;
+  unsigned long last;
+
+  max_offset=n1[BCD_LEN]-n1[BCD_DEC];
+  if ((n2[BCD_LEN]-n2[BCD_DEC])>max_offset) max_offset=n2[BCD_LEN]-n2[BCD_DEC];
+  if (ctx->Settings.DecPlaces>max_offset) max_offset=ctx->Settings.DecPlaces;
+
+  //Find where the first quotient digit lands the same way long division does
+  post_offset=n1[BCD_LEN]-n2[BCD_LEN];
+  if ((n1[BCD_DEC]-n2[BCD_DEC]+1)<post_offset)
+  {
+    dec=n1[BCD_DEC]-n2[BCD_DEC]+1;
+    post_offset=0;
+    if (dec<=0)
+    {
+      pre_offset=-dec;
+      dec=0;
+    }
+  }
+  else if (post_offset>0)
+  {
+    post_offset=0;
+    dec=n1[BCD_DEC]-n2[BCD_DEC]+1;
+  }
+  else
+  {
+    post_offset*=-1;
+    dec=post_offset+n1[BCD_DEC]-n2[BCD_DEC]+1;
+  }
+
+  //Number of quotient digits needed for max_offset decimal places plus one to round
+  steps=max_offset+1+dec-pre_offset;
+  if (steps<1) steps=1;
+
+  //The dividend is n1 shifted right by post_offset and cut off after the last
+  //digit long division would have brought down
+  digits=n2[BCD_LEN]+steps-1;
+  a_count=LimbLoad(ctx,ctx->limb_r,n1,digits-post_offset-n1[BCD_LEN]);
+  b_count=LimbLoad(ctx,ctx->limb_b,n2,0);
+  count=LimbDiv(ctx,ctx->limb_r+LIMB_MAX,ctx->limb_r,a_count,ctx->limb_b,b_count);
+
+  len=pre_offset+steps;
+  digits=LimbDigits(ctx->limb_r+LIMB_MAX,count);
+  if (digits>len)
+  {
+    dec+=digits-len;
+    len=digits;
+  }
+
+  if ((len-dec)>max_offset)
+  {
+    last=0;
+    if (count) last=ctx->limb_r[LIMB_MAX]%10;
+    count=LimbShift(ctx->limb_r+LIMB_MAX,count,1);
+    len-=1;
+    if (last>4)
+    {
+      ctx->limb_b[0]=1;
+      count=LimbAdd(ctx->limb_r+LIMB_MAX,ctx->limb_r+LIMB_MAX,count,ctx->limb_b,1);
+      if (LimbDigits(ctx->limb_r+LIMB_MAX,count)>len)
+      {
+        len++;
+        dec++;
+      }
+    }
+  }
+
+  LimbStore(ctx,result,ctx->limb_r+LIMB_MAX,count,len);
+  result[BCD_SIGN]=n1[BCD_SIGN]^n2[BCD_SIGN];
+  result[BCD_LEN]=len;
+  result[BCD_DEC]=dec;
+  FullShrinkBCD(ctx,result);
+  if ((result[BCD_LEN]-result[BCD_DEC])>ctx->Settings.DecPlaces) result[BCD_LEN]=result[BCD_DEC]+ctx->Settings.DecPlaces;
+}
+#endif
+
+#ifdef DOUBLE_MATH
+static double BCDToDouble(struct CalcContext *ctx, const unsigned char *n1)
+{
+  #pragma MM_VAR n1
+
+  char text[MATH_CELL_SIZE*2+4];
+  int i,text_ptr=0;
+
+  if (n1[BCD_SIGN]) text[text_ptr++]='-';
+  if (n1[BCD_DEC]==0) text[text_ptr++]='0';
+  for (i=0;i<n1[BCD_LEN];i++)
+  {
+    if (i==n1[BCD_DEC]) text[text_ptr++]='.';
+    text[text_ptr++]='0'+GetDigit(ctx,n1,i);
+  }
+  text[text_ptr]=0;
+  return strtod(text,NULL);
+}
+
+static double DoubleOp(int op, double x, double y)
+{
+  switch (op)
+  {
+    case DoubleLn:   return log(x);
+    case DoubleExp:  return exp(x);
+    case DoubleSin:  return sin(x*M_PI/180);
+    case DoubleCos:  return cos(x*M_PI/180);
+    case DoubleAtan: return atan(x)*180/M_PI;
+    case DoubleAsin: return asin(x)*180/M_PI;
+    //Same as AcosBCD, which takes the arctangent of sqrt(1-x^2)/x
+    case DoubleAcos: return atan(sqrt((1-x)*(1+x))/x)*180/M_PI;
+    case DoublePow:  return pow(x,y);
+    case DoubleSqrt: return sqrt(x);
+  }
+  return NAN;
+}
+
+static bool DoubleBCD(struct CalcContext *ctx, int op, unsigned char *result, const unsigned char *n1, const unsigned char *n2)
+{
+  char low[48],high[48];
+  double x,y=0,r,error,e;
+  int i;
+
+  if (ctx->Settings.DecPlaces>DOUBLE_MAX_PLACES) return false;
+
+  x=BCDToDouble(ctx,n1);
+  if (n2) y=BCDToDouble(ctx,n2);
+  r=DoubleOp(op,x,y);
+  if ((!isfinite(r))||(fabs(r)>=1e20)) return false;
+
+  //The inputs are only within DOUBLE_ARG_ERROR of the BCD numbers, so find how far the
+  //result moves when they do. If the bounds still round to the same digits, so does
+  //the exact result. Otherwise the BCD routines have to work it out.
+  error=fabs(r)*DOUBLE_LIB_ERROR+DBL_MIN;
+  e=fmax(fabs(DoubleOp(op,x*(1-DOUBLE_ARG_ERROR),y)-r),fabs(DoubleOp(op,x*(1+DOUBLE_ARG_ERROR),y)-r));
+  if (isnan(e)) return false;
+  error+=e;
+  if (n2)
+  {
+    e=fmax(fabs(DoubleOp(op,x,y*(1-DOUBLE_ARG_ERROR))-r),fabs(DoubleOp(op,x,y*(1+DOUBLE_ARG_ERROR))-r));
+    if (isnan(e)) return false;
+    error+=e;
+  }
+
+  snprintf(low,sizeof(low),"%.*f",ctx->Settings.DecPlaces,r-error);
+  snprintf(high,sizeof(high),"%.*f",ctx->Settings.DecPlaces,r+error);
+  for (i=0;low[i]==high[i];i++)
+  {
+    if (low[i]==0) break;
+  }
+  if (low[i]!=high[i]) return false;
+
+  //Trailing zeroes after the decimal point are dropped like the BCD routines do
+  if (ctx->Settings.DecPlaces)
+  {
+    for (i--;low[i]=='0';i--) low[i]=0;
+    if (low[i]=='.') low[i]=0;
+  }
+  if ((low[0]=='-')&&(low[1]=='0')&&(low[2]==0)) ImmedBCD(ctx,"0",result);
+  else ImmedBCD(ctx,low,result);
+  return true;
+}
+#endif
+
+static void MakeTables(struct CalcContext *ctx)
+{
+  //The first number of every line is the number of BCD bytes that follow it.
+  //Log table
+  static const unsigned char table[]={
+  17 ,0x88,0x72,0x28,0x39,0x11,0x16,0x72,0x99,0x96,0x05,0x40,0x57,0x11,0x54,0x66,0x46,0x60,
+  17 ,0x44,0x36,0x14,0x19,0x55,0x58,0x36,0x49,0x98,0x02,0x70,0x28,0x55,0x77,0x33,0x23,0x30,
+  17 ,0x22,0x18,0x07,0x09,0x77,0x79,0x18,0x24,0x99,0x01,0x35,0x14,0x27,0x88,0x66,0x61,0x65,
+  17 ,0x11,0x09,0x03,0x54,0x88,0x89,0x59,0x12,0x49,0x50,0x67,0x57,0x13,0x94,0x33,0x30,0x83,
+  17 ,0x05,0x54,0x51,0x77,0x44,0x44,0x79,0x56,0x24,0x75,0x33,0x78,0x56,0x97,0x16,0x65,0x41,
+  17 ,0x02,0x77,0x25,0x88,0x72,0x22,0x39,0x78,0x12,0x37,0x66,0x89,0x28,0x48,0x58,0x32,0x71,
+  17 ,0x01,0x38,0x62,0x94,0x36,0x11,0x19,0x89,0x06,0x18,0x83,0x44,0x64,0x24,0x29,0x16,0x35,
+  16 ,0x69,0x31,0x47,0x18,0x05,0x59,0x94,0x53,0x09,0x41,0x72,0x32,0x12,0x14,0x58,0x18,
+  16 ,0x40,0x54,0x65,0x10,0x81,0x08,0x16,0x43,0x81,0x97,0x80,0x13,0x11,0x54,0x64,0x35,
+  16 ,0x22,0x31,0x43,0x55,0x13,0x14,0x20,0x97,0x55,0x76,0x62,0x95,0x09,0x03,0x09,0x83,
+  16 ,0x11,0x77,0x83,0x03,0x56,0x56,0x38,0x34,0x54,0x53,0x87,0x94,0x10,0x94,0x70,0x52,
+  16 ,0x06,0x06,0x24,0x62,0x18,0x16,0x43,0x48,0x42,0x58,0x06,0x06,0x13,0x20,0x40,0x42,
+  16 ,0x03,0x07,0x71,0x65,0x86,0x66,0x75,0x36,0x88,0x37,0x10,0x28,0x20,0x75,0x96,0x77,
+  16 ,0x01,0x55,0x04,0x18,0x65,0x35,0x96,0x52,0x54,0x15,0x08,0x54,0x04,0x60,0x42,0x45,
+  15 ,0x77,0x82,0x14,0x04,0x42,0x05,0x49,0x48,0x94,0x74,0x62,0x90,0x00,0x61,0x14,
+  15 ,0x38,0x98,0x64,0x04,0x15,0x65,0x73,0x23,0x01,0x39,0x37,0x34,0x30,0x95,0x84,
+  15 ,0x19,0x51,0x22,0x01,0x31,0x26,0x17,0x49,0x43,0x96,0x74,0x04,0x95,0x31,0x84,
+  15 ,0x09,0x76,0x08,0x59,0x73,0x05,0x54,0x58,0x89,0x59,0x60,0x82,0x49,0x08,0x02,
+  15 ,0x04,0x88,0x16,0x20,0x79,0x50,0x13,0x51,0x18,0x85,0x37,0x04,0x96,0x92,0x65,
+  15 ,0x02,0x44,0x11,0x08,0x27,0x52,0x73,0x62,0x70,0x91,0x60,0x47,0x90,0x85,0x82,
+  15 ,0x01,0x22,0x06,0x28,0x62,0x52,0x56,0x77,0x37,0x16,0x23,0x05,0x53,0x67,0x16,
+  14 ,0x61,0x03,0x32,0x93,0x68,0x06,0x38,0x52,0x49,0x13,0x15,0x87,0x89,0x65,
+  14 ,0x30,0x51,0x71,0x12,0x47,0x31,0x86,0x37,0x85,0x69,0x06,0x95,0x14,0x17,
+  14 ,0x15,0x25,0x86,0x72,0x64,0x83,0x62,0x39,0x74,0x05,0x75,0x73,0x25,0x13,
+  14 ,0x07,0x62,0x93,0x65,0x42,0x75,0x67,0x57,0x21,0x55,0x88,0x52,0x96,0x85,
+  14 ,0x03,0x81,0x46,0x89,0x98,0x96,0x85,0x88,0x94,0x80,0x71,0x17,0x84,0x98,
+  14 ,0x01,0x90,0x73,0x46,0x81,0x38,0x25,0x40,0x94,0x15,0x46,0x94,0x42,0x51,
+  13 ,0x95,0x36,0x73,0x86,0x16,0x59,0x18,0x82,0x33,0x90,0x84,0x15,0x51,
+  13 ,0x47,0x68,0x37,0x04,0x45,0x16,0x32,0x34,0x18,0x44,0x34,0x61,0x75,
+  13 ,0x23,0x84,0x18,0x55,0x06,0x79,0x85,0x75,0x87,0x10,0x42,0x36,0x79,
+  13 ,0x11,0x92,0x09,0x28,0x24,0x45,0x35,0x44,0x57,0x08,0x75,0x79,0x16,
+  13 ,0x05,0x96,0x04,0x64,0x29,0x99,0x03,0x38,0x56,0x18,0x58,0x25,0x32,
+  13 ,0x02,0x98,0x02,0x32,0x19,0x43,0x60,0x61,0x11,0x47,0x31,0x97,0x05,
+  13 ,0x01,0x49,0x01,0x16,0x10,0x82,0x82,0x53,0x54,0x89,0x03,0x91,0x82,
+  12 ,0x74,0x50,0x58,0x05,0x69,0x16,0x82,0x52,0x64,0x72,0x34,0x52,
+  12 ,0x37,0x25,0x29,0x02,0x91,0x52,0x30,0x20,0x17,0x58,0x25,0x70,
+  12 ,0x18,0x62,0x64,0x51,0x47,0x49,0x62,0x33,0x55,0x74,0x27,0x31,
+  12 ,0x09,0x31,0x32,0x25,0x74,0x18,0x17,0x97,0x64,0x69,0x00,0x06,
+  12 ,0x04,0x65,0x66,0x12,0x87,0x19,0x93,0x19,0x04,0x05,0x97,0x61,
+  12 ,0x02,0x32,0x83,0x06,0x43,0x62,0x67,0x64,0x57,0x45,0x98,0x32,
+  12 ,0x01,0x16,0x41,0x53,0x21,0x82,0x01,0x58,0x55,0x08,0x75,0x62,
+  11 ,0x58,0x20,0x76,0x60,0x91,0x17,0x73,0x34,0x13,0x32,0x12,
+  11 ,0x29,0x10,0x38,0x30,0x45,0x63,0x10,0x18,0x71,0x39,0x66,
+  11 ,0x14,0x55,0x19,0x15,0x22,0x82,0x60,0x97,0x26,0x88,0x23,
+  11 ,0x07,0x27,0x59,0x57,0x61,0x41,0x56,0x95,0x61,0x23,0x72,
+  11 ,0x03,0x63,0x79,0x78,0x80,0x70,0x85,0x09,0x55,0x06,0x76,
+  11 ,0x01,0x81,0x89,0x89,0x40,0x35,0x44,0x20,0x21,0x14,0x60,
+  10 ,0x90,0x94,0x94,0x70,0x17,0x72,0x51,0x46,0x47,0x61,
   10 ,0x45,0x47,0x47,0x35,0x08,0x86,0x36,0x07,0x21,0x38,
   10 ,0x22,0x73,0x73,0x67,0x54,0x43,0x20,0x62,0x10,0x08,
   10 ,0x11,0x36,0x86,0x83,0x77,0x21,0x60,0x95,0x67,0x39,
@@ -1067,437 +2451,1519 @@ static void MakeTables()
   1 ,0x01,
   0};
 
-  int i,i_end;
-  int table_ptr=0,log_ptr=0;
-  do
+  #pragma MM_VAR dest
+
+  //The table is already packed BCD so it is copied as is after the leading zeroes
+  int i,i_end,entry=0;
+  int table_ptr=0,log_ptr;
+  unsigned char *dest=logs;
+  do
+  {
+    if (entry==MATH_LOG_TABLE) dest=trig;
+    log_ptr=(entry%MATH_LOG_TABLE)*MATH_ENTRY_SIZE;
+    dest[log_ptr+BCD_SIGN]=0;
+    dest[log_ptr+BCD_DEC]=2;
+    dest[log_ptr+BCD_LEN]=34;
+    log_ptr+=3;
+    i_end=table[table_ptr];
+    table_ptr++;
+    for (i=0;i<(17-i_end);i++) dest[log_ptr++]=0;
+    for (i=0;i<i_end;i++) dest[log_ptr++]=table[table_ptr++];
+    entry++;
+  } while(table[table_ptr]);
+}
+
+static void FindLeads(struct CalcContext *ctx)
+{
+  int i;
+
+  //The entries have to be at full length, before SetDecPlaces cuts them
+  for (i=0;i<ctx->log_count;i++) ctx->log_lead[i]=LeadDigit(ctx,logs+i*MATH_ENTRY_SIZE);
+  for (i=0;i<ctx->trig_count;i++) ctx->trig_lead[i]=LeadDigit(ctx,trig+i*MATH_ENTRY_SIZE);
+}
+
+static void SeriesBCD(struct CalcContext *ctx, unsigned char *result, unsigned char *x, bool alternate)
+{
+  int n;
+  char text[12];
+
+  //p3 holds x^n, p4 holds x^2, p5 holds n and p6 holds x^n/n
+  CopyBCD(ctx,result,x);
+  CopyBCD(ctx,p3,x);
+  MultBCD(ctx,p4,x,x);
+  for (n=3;;n+=2)
+  {
+    MultBCD(ctx,p6,p3,p4);
+    CopyBCD(ctx,p3,p6);
+    if (IsZero(ctx,p3)) break;
+    sprintf(text,"%d",n);
+    ImmedBCD(ctx,text,p5);
+    DivBCD(ctx,p6,p3,p5);
+    if ((alternate)&&(n&2)) SubBCD(ctx,p7,result,p6);
+    else AddBCD(ctx,p7,result,p6);
+    CopyBCD(ctx,result,p7);
+  }
+}
+
+static void FixBCD(struct CalcContext *ctx, unsigned char *dest, const unsigned char *src, int dec, int len)
+{
+  #pragma MM_VAR dest
+  #pragma MM_VAR src
+
+  int i,j,offset;
+  unsigned char digit;
+
+  offset=src[BCD_DEC]-dec;
+  for (i=0;i<len;i++)
+  {
+    j=i+offset;
+    if ((j>=0)&&(j<src[BCD_LEN])) SetDigit(ctx,dest,i,GetDigit(ctx,src,j));
+    else SetDigit(ctx,dest,i,0);
+  }
+
+  //Round on the first digit that doesn't fit
+  j=len+offset;
+  if ((j>=0)&&(j<src[BCD_LEN])&&(GetDigit(ctx,src,j)>4))
+  {
+    for (i=len-1;i>=0;i--)
+    {
+      digit=GetDigit(ctx,dest,i)+1;
+      if (digit<10)
+      {
+        SetDigit(ctx,dest,i,digit);
+        break;
+      }
+      SetDigit(ctx,dest,i,0);
+    }
+  }
+  dest[BCD_SIGN]=src[BCD_SIGN];
+  dest[BCD_LEN]=len;
+  dest[BCD_DEC]=dec;
+}
+
+static int LeadDigit(struct CalcContext *ctx, const unsigned char *n1)
+{
+  #pragma MM_VAR n1
+
+  int i,i_end;
+
+  //Skip whole bytes of zeroes before looking at single digits
+  i_end=BCD_BYTES(n1[BCD_LEN])+3;
+  for (i=3;i<i_end;i++) if (n1[i]) break;
+  i=(i-3)*2;
+  if ((i<n1[BCD_LEN])&&(GetDigit(ctx,n1,i)==0)) i++;
+  if (i>n1[BCD_LEN]) i=n1[BCD_LEN];
+  return i;
+}
+
+static unsigned char *TableEntry(struct CalcContext *ctx, int i)
+{
+  if (i<ctx->log_count) return logs+i*MATH_ENTRY_SIZE;
+  i-=ctx->log_count;
+  if (i<ctx->trig_count) return trig+i*MATH_ENTRY_SIZE;
+  i-=ctx->trig_count;
+  if (i==0) return perm_K;
+  else if (i==1) return perm_log10;
+  else if (i==2) return perm_2pi;
+  else if (i==3) return perm_deg;
+  return perm_pi;
+}
+
+static bool LoadTables(struct CalcContext *ctx)
+{
+  #pragma MM_VAR n1
+
+  FILE *file;
+  int i,j,c,dec,len,places,count=0;
+  unsigned char *n1;
+
+  file=fopen(MATH_TABLE_FILE,"r");
+  if (file==NULL) return false;
+
+  //The first line is MATH_MAX_PLACES and the size of each table. Every line after that
+  //is the number of whole number digits and then the digits of one entry.
+  if (fscanf(file,"%d %d %d",&places,&ctx->log_count,&ctx->trig_count)==3)
+  {
+    if ((places==MATH_MAX_PLACES)&&(ctx->log_count>8)&&(ctx->log_count<=MATH_LOG_MAX)&&
+        (ctx->trig_count>0)&&(ctx->trig_count<=MATH_TRIG_MAX))
+    {
+      count=ctx->log_count+ctx->trig_count+MATH_TABLE_CONSTS;
+    }
+  }
+
+  for (i=0;i<count;i++)
+  {
+    n1=TableEntry(ctx,i);
+    if (fscanf(file,"%d ",&dec)!=1) break;
+
+    //Each entry has to have as many digits as GenerateTables gives it. A short one
+    //means the file is cut off or from another build so the tables are made again.
+    if ((n1==perm_K)||(n1==perm_log10)||(n1==perm_pi)) len=1+MATH_MAX_PLACES;
+    else if ((n1==perm_2pi)||(n1==perm_deg)) len=2+MATH_MAX_PLACES;
+    else len=MATH_TABLE_DIGITS;
+    for (j=0;j<=len;j++)
+    {
+      c=fgetc(file);
+      if ((c<'0')||(c>'9')) break;
+      if (j<len) SetDigit(ctx,n1,j,c-'0');
+    }
+    if ((j!=len)||(dec<0)||(dec>j)) break;
+    n1[BCD_SIGN]=0;
+    n1[BCD_LEN]=j;
+    n1[BCD_DEC]=dec;
+  }
+  fclose(file);
+  return (count)&&(i==count);
+}
+
+static void SaveTables(struct CalcContext *ctx)
+{
+  #pragma MM_VAR n1
+
+  FILE *file;
+  int i,j,count;
+  unsigned char *n1;
+
+  file=fopen(MATH_TABLE_FILE,"w");
+  if (file==NULL) return;
+
+  fprintf(file,"%d %d %d\n",MATH_MAX_PLACES,ctx->log_count,ctx->trig_count);
+  count=ctx->log_count+ctx->trig_count+MATH_TABLE_CONSTS;
+  for (i=0;i<count;i++)
+  {
+    n1=TableEntry(ctx,i);
+    fprintf(file,"%d ",n1[BCD_DEC]);
+    for (j=0;j<n1[BCD_LEN];j++) fputc('0'+GetDigit(ctx,n1,j),file);
+    fputc('\n',file);
+  }
+  fclose(file);
+}
+
+static void GenerateTables(struct CalcContext *ctx)
+{
+  int i,places=ctx->Settings.DecPlaces;
+
+  if (!LoadTables(ctx))
+  {
+    //Everything is calculated with extra places then rounded. p0-p2 are used here and
+    //SeriesBCD uses p3-p7.
+    ctx->Settings.DecPlaces=MATH_MAX_PLACES+MATH_GUARD_PLACES;
+
+    //ln(2)=2*artanh(1/3)
+    ImmedBCD(ctx,"3",p1);
+    DivBCD(ctx,p0,perm_one,p1);
+    SeriesBCD(ctx,p1,p0,false);
+    AddBCD(ctx,p2,p1,p1);
+
+    //ln(10)=3*ln(2)+ln(1.25) and ln(1.25)=2*artanh(1/9)
+    ImmedBCD(ctx,"9",p1);
+    DivBCD(ctx,p0,perm_one,p1);
+    SeriesBCD(ctx,p1,p0,false);
+    AddBCD(ctx,p0,p1,p2);
+    AddBCD(ctx,p1,p0,p0);
+    AddBCD(ctx,p0,p1,p2);
+    FixBCD(ctx,perm_log10,p0,1,1+MATH_MAX_PLACES);
+
+    //The log table starts with 2^7*ln(2) down to ln(2)
+    for (i=0;i<8;i++)
+    {
+      RolBCD(ctx,p0,p2,7-i);
+      FixBCD(ctx,logs+i*MATH_ENTRY_SIZE,p0,2,MATH_TABLE_DIGITS);
+    }
+
+    //Then ln(1+2^-k)=2*artanh(1/(2^(k+1)+1)) until the entries are zero
+    for (i=8;i<MATH_LOG_MAX;i++)
+    {
+      RolBCD(ctx,p0,perm_one,i-6);
+      AddBCD(ctx,p1,p0,perm_one);
+      DivBCD(ctx,p0,perm_one,p1);
+      SeriesBCD(ctx,p1,p0,false);
+      AddBCD(ctx,p0,p1,p1);
+      FixBCD(ctx,logs+i*MATH_ENTRY_SIZE,p0,2,MATH_TABLE_DIGITS);
+      if (LeadDigit(ctx,logs+i*MATH_ENTRY_SIZE)==MATH_TABLE_DIGITS)
+      {
+        i++;
+        break;
+      }
+    }
+    ctx->log_count=i;
+
+    //pi=16*atan(1/5)-4*atan(1/239)
+    ImmedBCD(ctx,"5",p1);
+    DivBCD(ctx,p0,perm_one,p1);
+    SeriesBCD(ctx,p1,p0,true);
+    RolBCD(ctx,p2,p1,4);
+    ImmedBCD(ctx,"239",p1);
+    DivBCD(ctx,p0,perm_one,p1);
+    SeriesBCD(ctx,p1,p0,true);
+    RolBCD(ctx,p0,p1,2);
+    SubBCD(ctx,p1,p2,p0);
+    FixBCD(ctx,perm_pi,p1,1,1+MATH_MAX_PLACES);
+    AddBCD(ctx,p0,p1,p1);
+    FixBCD(ctx,perm_2pi,p0,1,2+MATH_MAX_PLACES);
+    DivBCD(ctx,p2,perm_180,p1);
+    FixBCD(ctx,perm_deg,p2,2,2+MATH_MAX_PLACES);
+
+    //The trig table is atan(2^-k) in degrees, starting with exactly 45
+    ImmedBCD(ctx,"45",p0);
+    FixBCD(ctx,trig,p0,2,MATH_TABLE_DIGITS);
+    for (i=1;i<MATH_TRIG_MAX;i++)
+    {
+      RorBCD(ctx,p0,perm_one,i);
+      SeriesBCD(ctx,p1,p0,true);
+      MultBCD(ctx,p0,p1,p2);
+      FixBCD(ctx,trig+i*MATH_ENTRY_SIZE,p0,2,MATH_TABLE_DIGITS);
+      if (LeadDigit(ctx,trig+i*MATH_ENTRY_SIZE)==MATH_TABLE_DIGITS)
+      {
+        i++;
+        break;
+      }
+    }
+    ctx->trig_count=i;
+
+    //K=1/sqrt((1+1)*(1+1/4)*(1+1/16)...)
+    CopyBCD(ctx,p0,perm_one);
+    for (i=0;;i++)
+    {
+      RorBCD(ctx,p1,perm_one,i*2);
+      if (IsZero(ctx,p1)) break;
+      AddBCD(ctx,p2,p1,perm_one);
+      MultBCD(ctx,p1,p0,p2);
+      CopyBCD(ctx,p0,p1);
+    }
+    SqrtBCD(ctx,p1,p0);
+    DivBCD(ctx,p0,perm_one,p1);
+    FixBCD(ctx,perm_K,p0,1,1+MATH_MAX_PLACES);
+
+    ctx->Settings.DecPlaces=places;
+    SaveTables(ctx);
+  }
+
+  FindLeads(ctx);
+  ctx->tables_generated=true;
+  #ifdef MEMO_CACHE
+  //Results from the built-in constants may not match the new ones
+  for (i=0;i<MEMO_ENTRIES;i++) ctx->memo[i].used=0;
+  #endif
+}
+
+static bool LnBCD(struct CalcContext *ctx, unsigned char *result, unsigned char *arg)
+{
+  #pragma MM_VAR result
+  #pragma MM_VAR arg
+  #pragma MM_VAR x
+  #pragma MM_VAR next_x
+  #pragma MM_VAR swap
+
+  bool flip_sign=false;
+  unsigned int i,j=1,k=0;
+  int zeros=0;
+  unsigned char *x=p1,*next_x=p0,*swap;
+
+  #ifdef DOUBLE_MATH
+  if (DoubleBCD(ctx,DoubleLn,result,arg,NULL)) return true;
+  #endif
+  #ifdef MEMO_CACHE
+  if (!ctx->memo_busy) return MemoBCD(ctx,MemoLn,result,NULL,arg,NULL);
+  #endif
+  #ifdef ZIV_ROUND
+  if (ctx->ziv_guard<0) return ZivBCD(ctx,ZivLn,result,NULL,arg,NULL);
+  #endif
+
+  SubBCD(ctx,p1,arg,perm_one);
+  if (IsZero(ctx,p1))
+  {
+    CopyBCD(ctx,result,perm_zero);
+    return true;
+  }
+  else if (p1[BCD_SIGN]==1)
+  {
+    DivBCD(ctx,p1,perm_one,arg);
+    flip_sign=true;
+  }
+  else CopyBCD(ctx,p1,arg);
+
+  for (i=0;i<8;i++)
+  {
+    RorBCD(ctx,p0,p1,j);
+    CopyBCD(ctx,p1,p0);
+    SubBCD(ctx,p0,p1,perm_one);
+    if (p0[BCD_SIGN]==1) break;
+    j=1<<(k++);
+  }
+
+  if (i==8) return false;
+  if (IsZero(ctx,p1)) return false;
+
+  j=1<<i;
+  k=7-k;
+  CopyBCD(ctx,result,logs+k*MATH_ENTRY_SIZE);
+
+  //zeros tracks how far below 1 x is. Once 1-x is below 10^-zeros the last step is off
+  //by less than 10^-(2*zeros)/2.
+  for (i=k;i<ctx->Settings.LogTableSize;i++)
+  {
+    if (zeros*2>=ctx->Settings.DecPlaces+2) break;
+    if (j!=0)
+    {
+      RolBCD(ctx,next_x,x,j);
+      j>>=1;
+    }
+    else
+    {
+      //Entries at least ten times 1-x would take x past 1
+      if (ctx->log_lead[i]<=zeros) continue;
+      ShiftAddBCD(ctx,next_x,x,x,i-7,false);
+    }
+    SubBCD(ctx,p2,next_x,perm_one);
+    if (p2[BCD_SIGN]==1)
+    {
+      swap=x;
+      x=next_x;
+      next_x=swap;
+      SubBCD(ctx,result,result,logs+i*MATH_ENTRY_SIZE);
+      zeros=FracZeros(ctx,p2,zeros);
+    }
+  }
+  SubBCD(ctx,p2,perm_one,x);
+  SubBCD(ctx,p0,result,p2);
+  CopyBCD(ctx,result,p0);
+  if (flip_sign) result[BCD_SIGN]=1;
+  return true;
+}
+
+static void ExpBCD(struct CalcContext *ctx, unsigned char *result, unsigned char *arg)
+{
+  #pragma MM_VAR result
+  #pragma MM_VAR arg
+
+  int i,j=128,zeros;
+  unsigned int log_ptr=0;
+  bool invert=false;
+
+  #ifdef DOUBLE_MATH
+  if (DoubleBCD(ctx,DoubleExp,result,arg,NULL)) return;
+  #endif
+  #ifdef MEMO_CACHE
+  if (!ctx->memo_busy)
   {
-    logs[log_ptr+BCD_SIGN]=0;
-    logs[log_ptr+BCD_DEC]=2;
-    logs[log_ptr+BCD_LEN]=34;
-    log_ptr+=3;
-    i_end=table[table_ptr];
-    table_ptr++;
-    for (i=0;i<(17-i_end);i++)
+    MemoBCD(ctx,MemoExp,result,NULL,arg,NULL);
+    return;
+  }
+  #endif
+  #ifdef ZIV_ROUND
+  if (ctx->ziv_guard<0)
+  {
+    ZivBCD(ctx,ZivExp,result,NULL,arg,NULL);
+    return;
+  }
+  #endif
+
+  if (arg[BCD_SIGN]==1)
+  {
+    invert=true;
+    arg[BCD_SIGN]=0;
+  }
+
+  if (CompVarBCD(ctx,perm_zero,arg)==COMP_EQ)
+  {
+    CopyBCD(ctx,result,perm_one);
+    return;
+  }
+
+  CopyBCD(ctx,p0,arg);
+  CopyBCD(ctx,result,perm_one);
+  //What is left in p0 is below 10^-zeros. Once the last step is off by less than
+  //10^-(2*zeros)/2 the rest of the table can't change the result.
+  zeros=FracZeros(ctx,p0,0);
+  for (i=0;i<ctx->Settings.LogTableSize;i++)
+  {
+    if (zeros*2>=ctx->Settings.DecPlaces+2) break;
+    //Entries with fewer leading zeroes than p0 are too big to subtract
+    if (ctx->log_lead[i]>zeros+1)
     {
-      logs[log_ptr++]=0;
-      logs[log_ptr++]=0;
+      SubBCD(ctx,p1,p0,logs+log_ptr);
+      if (p1[BCD_SIGN]==0)
+      {
+        CopyBCD(ctx,p0,p1);
+        if (i<8) RolBCD(ctx,result,result,j);
+        else ShiftAddBCD(ctx,result,result,result,i-7,false);
+        zeros=FracZeros(ctx,p0,zeros);
+      }
     }
-    for (i=0;i<i_end;i++)
+    j>>=1;
+    log_ptr+=MATH_ENTRY_SIZE;
+  }
+  AddBCD(ctx,p1,p0,perm_one);
+  MultBCD(ctx,p2,p1,result);
+
+  if (invert) DivBCD(ctx,result,perm_one,p2);
+  else CopyBCD(ctx,result,p2);
+}
+
+static void RolBCD(struct CalcContext *ctx, unsigned char *result, unsigned char *arg, int amount)
+{
+  #pragma MM_VAR result
+  #pragma MM_VAR arg
+  #pragma MM_VAR src
+
+  int i,i_end,extra,shift;
+  unsigned char b0=0,digit,low=0;
+  unsigned long long carry;
+  unsigned char *src=arg;
+
+  i_end=arg[BCD_LEN];
+  result[BCD_SIGN]=arg[BCD_SIGN];
+  result[BCD_DEC]=arg[BCD_DEC];
+  if (amount==0) CopyBCD(ctx,result,arg);
+
+  while (amount)
+  {
+    shift=amount;
+    if (shift>SCALE_BITS) shift=SCALE_BITS;
+    amount-=shift;
+
+    //Room for the digits carried out of the top. Kept even so digits stay in the same nibble.
+    extra=((shift*3)/10+2)&~1;
+
+    //Work up from the last digit, writing each digit extra places further right
+    carry=0;
+    for (i=i_end-1;i>=-extra;i--)
     {
-      logs[log_ptr]=table[table_ptr]>>4;
-      logs[log_ptr+1]=table[table_ptr]&0xF;
-      table_ptr++;
-      log_ptr+=2;
+      if (i>=0)
+      {
+        if ((i&1)||(i==i_end-1)) b0=src[(i>>1)+3];
+        if (i&1) digit=b0&0xF;
+        else digit=b0>>4;
+        carry+=(unsigned long long)digit<<shift;
+      }
+      digit=carry%10;
+      carry/=10;
+      if ((i+extra)&1) low=digit;
+      else
+      {
+        if (i==i_end-1) low=0;
+        result[((i+extra)>>1)+3]=(digit<<4)|low;
+      }
     }
-  } while(table[table_ptr]);
+    i_end+=extra;
+    result[BCD_LEN]=i_end;
+    result[BCD_DEC]=result[BCD_DEC]+extra;
+    src=result;
+  }
+  FullShrinkBCD(ctx,result);
 }
 
-static bool LnBCD(unsigned char *result, unsigned char *arg)
+static void RorBCD(struct CalcContext *ctx, unsigned char *result, unsigned char *arg, int amount)
 {
   #pragma MM_VAR result
   #pragma MM_VAR arg
-  #pragma MM_VAR temp
+  #pragma MM_VAR src
 
-  #pragma MM_DECLARE
-    unsigned char temp[4];
-  #pragma MM_END
+  int i,i_end,i_max,shift;
+  unsigned char b0=0,digit,high=0;
+  unsigned long long rem;
+  unsigned char *src=arg;
 
-  bool flip_sign=false;
-  unsigned int i,j=1,k=0;
+  i_end=arg[BCD_LEN];
+  //Digits shifted in past the last decimal place are dropped
+  i_max=arg[BCD_DEC]+ctx->Settings.DecPlaces;
+  if (i_max<i_end) i_max=i_end;
+  result[BCD_SIGN]=arg[BCD_SIGN];
+  result[BCD_DEC]=arg[BCD_DEC];
+  if (amount==0) CopyBCD(ctx,result,arg);
 
-  ImmedBCD("1",temp);
+  while (amount)
+  {
+    shift=amount;
+    if (shift>SCALE_BITS) shift=SCALE_BITS;
+    amount-=shift;
+
+    //Long division by 2^shift from the first digit. Once the digits of the number
+    //run out, zeroes are brought down until nothing is left over.
+    rem=0;
+    for (i=0;i<i_max;i++)
+    {
+      if (i<i_end)
+      {
+        if ((i&1)==0) b0=src[(i>>1)+3];
+        if (i&1) digit=b0&0xF;
+        else digit=b0>>4;
+      }
+      else if (rem) digit=0;
+      else break;
+      rem=rem*10+digit;
+      digit=rem>>shift;
+      rem&=(1ULL<<shift)-1;
+      if (i&1) result[(i>>1)+3]=high|digit;
+      else high=digit<<4;
+    }
+    if (i&1) result[(i>>1)+3]=high;
+    i_end=i;
+    result[BCD_LEN]=i_end;
+    src=result;
+  }
+  FullShrinkBCD(ctx,result);
+}
 
-  SubBCD(p1,arg,temp);
-  if (IsZero(p1))
+static void ShiftAddBCD(struct CalcContext *ctx, unsigned char *result, unsigned char *n1, unsigned char *n2, int amount, bool subtract)
+{
+  #pragma MM_VAR result
+  #pragma MM_VAR n1
+  #pragma MM_VAR n2
+
+  int i,w,w_start,dec,frac,q_frac,n1_dec,n1_len,n2_dec,n2_len;
+  int n1_cached=-1,n2_cached=-1;
+  unsigned char sign,t1,n1_byte=0,n2_byte=0,low=0,carry=0;
+  bool subtracting,zero=true;
+  unsigned long long mult=1,q=0;
+
+  if (amount>SHIFT_ADD_BITS)
   {
-    CopyBCD(result,perm_zero);
-    return true;
+    RorBCD(ctx,perm_buff1,n2,amount);
+    if (subtract) SubBCD(ctx,result,n1,perm_buff1);
+    else AddBCD(ctx,result,n1,perm_buff1);
+    return;
   }
-  else if (p1[BCD_SIGN]==1)
+
+  for (i=0;i<amount;i++) mult*=5;
+
+  sign=n1[BCD_SIGN];
+  subtracting=(sign!=(n2[BCD_SIGN]^subtract));
+  n1_len=n1[BCD_LEN];
+  n1_dec=n1[BCD_DEC];
+  n2_len=n2[BCD_LEN];
+  n2_dec=n2[BCD_DEC];
+
+  //n2/2^amount has amount more decimal places than n2. As in RorBCD, the ones past
+  //the last decimal place are dropped.
+  q_frac=n2_len-n2_dec;
+  if (q_frac<ctx->Settings.DecPlaces) q_frac=ctx->Settings.DecPlaces;
+  if (q_frac>n2_len-n2_dec+amount) q_frac=n2_len-n2_dec+amount;
+  frac=n1_len-n1_dec;
+  if (q_frac>frac) frac=q_frac;
+  dec=n1_dec;
+  if (n2_dec>dec) dec=n2_dec;
+
+  //Work up from the lowest place. n2*5^amount is worked out a digit at a time and each
+  //of its digits is the digit of n2/2^amount amount places further left.
+  w_start=-(n2_len-n2_dec+amount);
+  if (-frac<w_start) w_start=-frac;
+  for (w=w_start;w<dec;w++)
   {
-    DivBCD(p1,temp,arg);
-    flip_sign=true;
+    i=n2_dec-1-w-amount;
+    if ((i>=0)&&(i<n2_len))
+    {
+      if ((i>>1)!=n2_cached)
+      {
+        n2_cached=i>>1;
+        n2_byte=n2[n2_cached+3];
+      }
+      if (i&1) q+=(n2_byte&0xF)*mult;
+      else q+=(n2_byte>>4)*mult;
+    }
+    t1=q%10;
+    q/=10;
+    if (w<-frac) continue;
+
+    i=n1_dec-1-w;
+    if ((i>=0)&&(i<n1_len))
+    {
+      if ((i>>1)!=n1_cached)
+      {
+        n1_cached=i>>1;
+        n1_byte=n1[n1_cached+3];
+      }
+      if (i&1) i=n1_byte&0xF;
+      else i=n1_byte>>4;
+    }
+    else i=0;
+
+    if (subtracting)
+    {
+      if (i<t1+carry)
+      {
+        t1=i+10-t1-carry;
+        carry=1;
+      }
+      else
+      {
+        t1=i-t1-carry;
+        carry=0;
+      }
+    }
+    else
+    {
+      t1=i+t1+carry;
+      if (t1>9)
+      {
+        t1-=10;
+        carry=1;
+      }
+      else carry=0;
+    }
+    if (t1) zero=false;
+
+    i=dec-1-w;
+    if (i&1) low=t1;
+    else
+    {
+      result[(i>>1)+3]=(t1<<4)|low;
+      low=0;
+    }
   }
-  else CopyBCD(p1,arg);
 
-  for (i=0;i<8;i++)
+  result[BCD_LEN]=dec+frac;
+  result[BCD_DEC]=dec;
+  if (carry)
   {
-    RorBCD(p0,p1,j);
-    CopyBCD(p1,p0);
-    SubBCD(p0,p1,temp);
-    if (p0[BCD_SIGN]==1) break;
-    j=1<<(k++);
+    if (subtracting)
+    {
+      //n2/2^amount was larger so the digits are the ten's complement of the answer
+      carry=1;
+      for (i=dec+frac-1;i>=0;i--)
+      {
+        t1=9-GetDigit(ctx,result,i)+carry;
+        if (t1==10) t1=0;
+        else carry=0;
+        SetDigit(ctx,result,i,t1);
+      }
+      sign=!sign;
+    }
+    else
+    {
+      PadBCD(ctx,result,1);
+      SetDigit(ctx,result,0,1);
+    }
   }
+  if (zero) sign=0;
+  result[BCD_SIGN]=sign;
+  if (n2_dec>n1_dec) FullShrinkBCD(ctx,result);
+}
 
-  if (i==8) return false;
-  if (IsZero(p1)) return false;
+static bool PowBCD(struct CalcContext *ctx, unsigned char *result, unsigned char *base, unsigned char *exp)
+{
+  #pragma MM_VAR result
+  #pragma MM_VAR base
+  #pragma MM_VAR exp
 
-  j=1<<i;
-  k=7-k;
-  CopyBCD(result,logs+k*MATH_ENTRY_SIZE);
+  int i,places,asked,guard=0;
+  unsigned long n=0,m;
+  unsigned char sign;
+  bool whole=true;
+
+  #ifdef DOUBLE_MATH
+  if (DoubleBCD(ctx,DoublePow,result,base,exp)) return true;
+  #endif
+  #ifdef MEMO_CACHE
+  if (!ctx->memo_busy) return MemoBCD(ctx,MemoPow,result,NULL,base,exp);
+  #endif
+  #ifdef ZIV_ROUND
+  if (ctx->ziv_guard<0) return ZivBCD(ctx,ZivPow,result,NULL,base,exp);
+  #endif
 
-  for (i=k;i<Settings.LogTableSize;i++)
+  //Integer exponents are done by squaring, which is exact for integer bases and
+  //handles negative bases. Anything else goes through ln and exp.
+  if (exp[BCD_DEC]>POW_INT_DIGITS) whole=false;
+  for (i=0;(i<exp[BCD_LEN])&&whole;i++)
   {
-    if (j!=0)
+    if (i<exp[BCD_DEC]) n=n*10+GetDigit(ctx,exp,i);
+    else if (GetDigit(ctx,exp,i)) whole=false;
+  }
+
+  if (whole)
+  {
+    //Every product of a base with decimal places is rounded and the squaring makes the
+    //error grow with n, so they are worked out with two more places than n has digits
+    //and only the answer is rounded.
+    if (base[BCD_LEN]>base[BCD_DEC])
     {
-      RolBCD(p0,p1,j);
-      SubBCD(p2,p0,temp);
-      j>>=1;
+      for (m=n;m;m/=10) guard++;
+      guard+=2;
     }
-    else
+    places=ctx->Settings.DecPlaces;
+    asked=places;
+    #ifdef ZIV_ROUND
+      if (ctx->ziv_guard>0) asked-=ctx->ziv_guard;
+    #endif
+    ctx->Settings.DecPlaces=places+guard;
+    m=PowIntBCD(ctx,result,base,n);
+
+    //The guard places, and any ZivBCD adds, can make a large power too long for a cell.
+    //The rounding matters much less there than the room, so it is worked out again with
+    //only the guard places over those asked for and then with none.
+    if ((m)&&(asked<places))
     {
-      RorBCD(p2,p1,i-7);
-      AddBCD(p0,p1,p2);
-      SubBCD(p2,p0,temp);
+      ctx->Settings.DecPlaces=asked+guard;
+      m=PowIntBCD(ctx,result,base,n);
     }
-    if (p2[BCD_SIGN]==1)
+    if ((m)&&(guard))
+    {
+      ctx->Settings.DecPlaces=asked;
+      m=PowIntBCD(ctx,result,base,n);
+    }
+    ctx->Settings.DecPlaces=places;
+
+    if (m==0)
     {
-      CopyBCD(p1,p0);
-      SubBCD(p2,result,logs+i*MATH_ENTRY_SIZE);
-      CopyBCD(result,p2);
+      if (result[BCD_LEN]-result[BCD_DEC]>places)
+      {
+        //Room for a carry out of the first digit
+        PadBCD(ctx,result,1);
+        FixBCD(ctx,result,result,result[BCD_DEC],result[BCD_DEC]+places);
+        FullShrinkBCD(ctx,result);
+      }
+      if (exp[BCD_SIGN])
+      {
+        DivBCD(ctx,p4,perm_one,result);
+        CopyBCD(ctx,result,p4);
+      }
+      return true;
     }
   }
-  SubBCD(p2,temp,p1);
-  SubBCD(p0,result,p2);
-  CopyBCD(result,p0);
-  if (flip_sign) result[BCD_SIGN]=1;
+
+  LnBCD(ctx,p3,base);
+  MultBCD(ctx,p4,p3,exp);
+
+  //ExpBCD is only good up to the sum of the log table, the same limit the e^x key has.
+  //Below -177 the answer is under 10^-76 so it is left as zero.
+  sign=p4[BCD_SIGN];
+  p4[BCD_SIGN]=0;
+  if (CompBCD(ctx,"177",p4)==COMP_LT)
+  {
+    if (sign==0) return false;
+    CopyBCD(ctx,result,perm_zero);
+    return true;
+  }
+  p4[BCD_SIGN]=sign;
+  ExpBCD(ctx,result,p4);
   return true;
 }
 
-static void ExpBCD(unsigned char *result, unsigned char *arg)
+static unsigned long PowIntBCD(struct CalcContext *ctx, unsigned char *result, unsigned char *base, unsigned long n)
+{
+  #pragma MM_VAR result
+  #pragma MM_VAR base
+
+  //Each product has to fit in one cell. If one doesn't, n is left over.
+  CopyBCD(ctx,result,perm_one);
+  CopyBCD(ctx,p3,base);
+  while (n)
+  {
+    if (n&1)
+    {
+      if (MultDigits(ctx,result,p3)>MATH_MAX_DIGITS) break;
+      MultBCD(ctx,p4,result,p3);
+      CopyBCD(ctx,result,p4);
+    }
+    n>>=1;
+    if (n)
+    {
+      if (MultDigits(ctx,p3,p3)>MATH_MAX_DIGITS) break;
+      MultBCD(ctx,p4,p3,p3);
+      CopyBCD(ctx,p3,p4);
+    }
+  }
+  return n;
+}
+
+static void SqrtBCD(struct CalcContext *ctx, unsigned char *result, unsigned char *arg)
 {
   #pragma MM_VAR result
   #pragma MM_VAR arg
-  #pragma MM_VAR temp
 
-  #pragma MM_DECLARE
-    unsigned char temp[4];
-  #pragma MM_END
+  int i,j,i_end,start,width;
+  int whole,digits,arg_ptr;
+  unsigned char d,t1,t2,carry;
 
-  int i,j=128;
-  unsigned int log_ptr=0;
-  bool invert=false;
-  if (arg[BCD_SIGN]==1)
+  #ifdef DOUBLE_MATH
+  if (DoubleBCD(ctx,DoubleSqrt,result,arg,NULL)) return;
+  #endif
+
+  //Every digit of the root comes from one pair of digits of the argument, with the
+  //pairs lined up on the decimal point. One extra decimal place is kept for rounding.
+  whole=(arg[BCD_DEC]+1)>>1;
+  digits=whole+ctx->Settings.DecPlaces+1;
+  arg_ptr=-(arg[BCD_DEC]&1);
+
+  //perm_buff1 holds the remainder and perm_buff2 holds 20*root+2*d+1, the next odd
+  //number to try subtracting from it. Both are right aligned in width digits.
+  width=digits+2;
+  i_end=BCD_BYTES(width)+3;
+  for (i=3;i<i_end;i++)
   {
-    invert=true;
-    arg[BCD_SIGN]=0;
+    perm_buff1[i]=0;
+    perm_buff2[i]=0;
+  }
+  SetDigit(ctx,perm_buff2,width-1,1);
+
+  result[BCD_SIGN]=0;
+  result[BCD_LEN]=digits;
+  result[BCD_DEC]=whole;
+
+  for (i=0;i<digits;i++)
+  {
+    //Neither number is longer than i+3 digits at this point
+    start=width-i-3;
+
+    //Bring down the next two digits of the argument
+    for (j=start;j<width-2;j++) SetDigit(ctx,perm_buff1,j,GetDigit(ctx,perm_buff1,j+2));
+    for (j=width-2;j<width;j++)
+    {
+      if ((arg_ptr>=0)&&(arg_ptr<arg[BCD_LEN])) SetDigit(ctx,perm_buff1,j,GetDigit(ctx,arg,arg_ptr));
+      else SetDigit(ctx,perm_buff1,j,0);
+      arg_ptr++;
+    }
+
+    d=0;
+    for (;;)
+    {
+      //Stop when the remainder is less than the odd number
+      for (j=start;j<width;j++)
+      {
+        t1=GetDigit(ctx,perm_buff1,j);
+        t2=GetDigit(ctx,perm_buff2,j);
+        if (t1!=t2) break;
+      }
+      if ((j<width)&&(t1<t2)) break;
+
+      carry=0;
+      for (j=width-1;j>=start;j--)
+      {
+        t1=GetDigit(ctx,perm_buff1,j);
+        t2=GetDigit(ctx,perm_buff2,j)+carry;
+        if (t1<t2)
+        {
+          SetDigit(ctx,perm_buff1,j,t1+10-t2);
+          carry=1;
+        }
+        else
+        {
+          SetDigit(ctx,perm_buff1,j,t1-t2);
+          carry=0;
+        }
+      }
+
+      carry=2;
+      for (j=width-1;carry;j--)
+      {
+        t1=GetDigit(ctx,perm_buff2,j)+carry;
+        if (t1>9)
+        {
+          SetDigit(ctx,perm_buff2,j,t1-10);
+          carry=1;
+        }
+        else
+        {
+          SetDigit(ctx,perm_buff2,j,t1);
+          carry=0;
+        }
+      }
+      d++;
+    }
+    SetDigit(ctx,result,i,d);
+
+    //20*root+1 for the next digit is ten times the last odd number tried, minus 9
+    SetDigit(ctx,perm_buff2,width-1,GetDigit(ctx,perm_buff2,width-1)-1);
+    for (j=start;j<width-1;j++) SetDigit(ctx,perm_buff2,j,GetDigit(ctx,perm_buff2,j+1));
+    SetDigit(ctx,perm_buff2,width-1,1);
+  }
+
+  if (GetDigit(ctx,result,digits-1)>4)
+  {
+    i_end=BCD_BYTES(digits-1)+3;
+    for (i=3;i<i_end;i++) perm_buff3[i]=result[i];
+    perm_buff3[BCD_SIGN]=0;
+    perm_buff3[BCD_LEN]=digits-1;
+    perm_buff3[BCD_DEC]=digits-1;
+    perm_buff1[BCD_SIGN]=0;
+    perm_buff1[BCD_LEN]=1;
+    perm_buff1[BCD_DEC]=1;
+    perm_buff1[3]=0x10;
+    AddBCD(ctx,result,perm_buff3,perm_buff1);
+    result[BCD_DEC]=whole;
+    if (result[BCD_LEN]==digits) result[BCD_DEC]+=1;
+  }
+  else result[BCD_LEN]-=1;
+  FullShrinkBCD(ctx,result);
+}
+
+static void TanBCD(struct CalcContext *ctx, unsigned char *sine_result,unsigned char *cos_result,unsigned char *arg)
+{
+  #pragma MM_VAR sine_result
+  #pragma MM_VAR cos_result
+
+  #ifdef DOUBLE_MATH
+  if (DoubleBCD(ctx,DoubleSin,sine_result,arg,NULL))
+  {
+    if (DoubleBCD(ctx,DoubleCos,cos_result,arg,NULL)) return;
+  }
+  #endif
+  #ifdef MEMO_CACHE
+  if (!ctx->memo_busy)
+  {
+    MemoBCD(ctx,MemoTan,sine_result,cos_result,arg,NULL);
+    return;
+  }
+  #endif
+  #ifdef ZIV_ROUND
+  if (ctx->ziv_guard<0)
+  {
+    ZivBCD(ctx,ZivTan,sine_result,cos_result,arg,NULL);
+    return;
   }
+  #endif
 
-  if (CompVarBCD(perm_zero,arg)==COMP_EQ)
+  CopyBCD(ctx,p2,perm_zero);
+  CopyBCD(ctx,sine_result,perm_zero);
+  CopyBCD(ctx,cos_result,perm_K);
+
+  CalcTanBCD(ctx,sine_result,cos_result,p2,arg,0);
+  #ifdef ZIV_ROUND
+  //ZivBCD rounds on the digits past DecPlaces
+  if (ctx->ziv_guard>0) return;
+  #endif
+  sine_result[BCD_LEN]=ctx->Settings.DecPlaces;
+  cos_result[BCD_LEN]=ctx->Settings.DecPlaces;
+}
+
+static void AcosBCD(struct CalcContext *ctx, unsigned char *result,unsigned char *arg)
+{
+  #ifdef DOUBLE_MATH
+  if (DoubleBCD(ctx,DoubleAcos,result,arg,NULL)) return;
+  #endif
+
+  CopyBCD(ctx,p0,arg);
+  MultBCD(ctx,p1,p0,arg);
+  SubBCD(ctx,p5,perm_one,p1);
+  SqrtBCD(ctx,p7,p5);
+  DivBCD(ctx,p6,p7,arg);
+  AtanBCD(ctx,result,p6);
+}
+
+static void AsinBCD(struct CalcContext *ctx, unsigned char *result,unsigned char *arg)
+{
+  #ifdef DOUBLE_MATH
+  if (DoubleBCD(ctx,DoubleAsin,result,arg,NULL)) return;
+  #endif
+
+  CopyBCD(ctx,p0,arg);
+  MultBCD(ctx,p1,p0,arg);
+  SubBCD(ctx,p5,perm_one,p1);
+  SqrtBCD(ctx,p7,p5);
+  DivBCD(ctx,p6,arg,p7);
+  AtanBCD(ctx,result,p6);
+}
+
+static void AtanBCD(struct CalcContext *ctx, unsigned char *result,unsigned char *arg)
+{
+  #pragma MM_VAR result
+
+  #ifdef DOUBLE_MATH
+  if (DoubleBCD(ctx,DoubleAtan,result,arg,NULL)) return;
+  #endif
+  #ifdef MEMO_CACHE
+  if (!ctx->memo_busy)
   {
-    ImmedBCD("1",result);
+    MemoBCD(ctx,MemoAtan,result,NULL,arg,NULL);
     return;
   }
+  #endif
+  #ifdef ZIV_ROUND
+  if (ctx->ziv_guard<0) ZivBCD(ctx,ZivAtan,result,NULL,arg,NULL);
+  else
+  #endif
+  {
+    CopyBCD(ctx,result,perm_zero);
+    CopyBCD(ctx,p2,perm_one);
+    CopyBCD(ctx,p3,arg);
+    CalcTanBCD(ctx,p2,p3,result,arg,1);
+  }
+  #ifdef ZIV_ROUND
+  //ZivBCD rounds on the digits past DecPlaces
+  if (ctx->ziv_guard>0) return;
+  #endif
+  if ((result[BCD_DEC]<=ctx->Settings.DecPlaces)&&(result[BCD_LEN]>ctx->Settings.DecPlaces)) result[BCD_LEN]=ctx->Settings.DecPlaces;
+}
+
+#ifdef MEMO_CACHE
+static bool MemoBCD(struct CalcContext *ctx, int op, unsigned char *result1, unsigned char *result2, unsigned char *n1, unsigned char *n2)
+{
+  #pragma MM_VAR result1
+  #pragma MM_VAR result2
+  #pragma MM_VAR n1
+  #pragma MM_VAR n2
+
+  struct MemoEntry *entry;
+  unsigned long hash=2166136261UL;
+  int i,oldest=0;
+  unsigned char sign;
+  bool success=true;
 
-  ImmedBCD("1",temp);
-  CopyBCD(p0,arg);
-  CopyBCD(result,temp);
-  for (i=0;i<Settings.LogTableSize;i++)
+  hash=(hash^op)*16777619UL;
+  hash=(hash^ctx->Settings.DecPlaces)*16777619UL;
+  hash=(hash^ctx->Settings.DegRad)*16777619UL;
+  hash=MemoHash(ctx,hash,n1);
+  if (op==MemoPow) hash=MemoHash(ctx,hash,n2);
+
+  ctx->memo_clock++;
+  for (i=0;i<MEMO_ENTRIES;i++)
   {
-    SubBCD(p1,p0,logs+log_ptr);
-    if (p1[BCD_SIGN]==0)
+    entry=&ctx->memo[i];
+    if ((entry->used)&&(entry->hash==hash)&&(entry->op==op)&&(entry->places==ctx->Settings.DecPlaces)&&
+        (entry->deg_rad==ctx->Settings.DegRad)&&(MemoSame(ctx,n1,entry->n1)))
     {
-      CopyBCD(p0,p1);
-      if (i<8)
-      {
-        RolBCD(p1,result,j);
-      }
-      else
+      if ((op!=MemoPow)||(MemoSame(ctx,n2,entry->n2)))
       {
-        RorBCD(p2,result,i-7);
-        AddBCD(p1,result,p2);
+        entry->used=ctx->memo_clock;
+        ctx->memo_hits++;
+        if (entry->success)
+        {
+          MemoCopyOut(ctx,result1,entry->result1);
+          if (op==MemoTan) MemoCopyOut(ctx,result2,entry->result2);
+        }
+        return entry->success;
       }
-      CopyBCD(result,p1);
     }
-    j>>=1;
-    log_ptr+=MATH_ENTRY_SIZE;
+    if (entry->used<ctx->memo[oldest].used) oldest=i;
   }
-  AddBCD(p1,p0,temp);
-  MultBCD(p2,p1,result);
-  CopyBCD(p2,result);
+  ctx->memo_misses++;
 
-  if (invert) DivBCD(result,temp,p2);
-  else CopyBCD(result,p2);
+  //ExpBCD clears the sign of its argument so it is saved first and put back after. That
+  //way the arguments are left the same whether or not the result was found.
+  entry=&ctx->memo[oldest];
+  MemoCopyIn(ctx,entry->n1,n1);
+  if (op==MemoPow) MemoCopyIn(ctx,entry->n2,n2);
+  sign=n1[BCD_SIGN];
+
+  ctx->memo_busy=true;
+  switch (op)
+  {
+    case MemoLn:
+      success=LnBCD(ctx,result1,n1);
+      break;
+    case MemoExp:
+      ExpBCD(ctx,result1,n1);
+      break;
+    case MemoPow:
+      success=PowBCD(ctx,result1,n1,n2);
+      break;
+    case MemoTan:
+      TanBCD(ctx,result1,result2,n1);
+      break;
+    case MemoAtan:
+      AtanBCD(ctx,result1,n1);
+      break;
+  }
+  ctx->memo_busy=false;
+  n1[BCD_SIGN]=sign;
+
+  entry->used=ctx->memo_clock;
+  entry->hash=hash;
+  entry->op=op;
+  entry->places=ctx->Settings.DecPlaces;
+  entry->deg_rad=ctx->Settings.DegRad;
+  entry->success=success;
+  if (success)
+  {
+    MemoCopyIn(ctx,entry->result1,result1);
+    if (op==MemoTan) MemoCopyIn(ctx,entry->result2,result2);
+  }
+  return success;
 }
 
-static void RolBCD(unsigned char *result, unsigned char *arg, int amount)
+static unsigned long MemoHash(struct CalcContext *ctx, unsigned long hash, const unsigned char *n1)
 {
-  #pragma MM_VAR result
-  #pragma MM_VAR arg
-
-  int i,i_end,j;
-  unsigned char b0,b1;
+  #pragma MM_VAR n1
+  int i,i_end;
 
-  CopyBCD(result,arg);
-  for (j=0;j<amount;j++)
-  {
-    b1=0;
-    i_end=result[BCD_LEN]+2;
-    for (i=i_end;i>=3;i--)
-    {
-      b0=(result[i]<<1)+b1;
-      if (b0>9) b0+=6;
-      b1=b0>>4;
-      result[i]=(b0&0xF);
-    }
-    if (b1)
-    {
-      PadBCD(result,1);
-      result[3]=1;
-    }
-  }
+  i_end=BCD_BYTES(n1[BCD_LEN])+3;
+  for (i=0;i<i_end;i++) hash=(hash^n1[i])*16777619UL;
+  return hash;
 }
 
-static void RorBCD(unsigned char *result, unsigned char *arg, int amount)
+static bool MemoSame(struct CalcContext *ctx, const unsigned char *n1, const unsigned char *copy)
 {
-  #pragma MM_VAR result
-  #pragma MM_VAR arg
+  #pragma MM_VAR n1
+  int i,i_end;
 
-  int i,i_end,j;
-  unsigned char b0,b1,b2;
-  unsigned char t1;
+  if (n1[BCD_LEN]!=copy[BCD_LEN]) return false;
+  i_end=BCD_BYTES(n1[BCD_LEN])+3;
+  for (i=0;i<i_end;i++) if (n1[i]!=copy[i]) return false;
+  return true;
+}
 
-  static const unsigned char table[]={
-  0,0,0,0, // 0/16
-  0,6,2,5, // 1/16
-  1,2,5,0, // 2/16
-  1,8,7,5, // 3/16
-  2,5,0,0, // 4/16
-  3,1,2,5, // 5/16
-  3,7,5,0, // 6/16
-  4,3,7,5, // 7/16
-  5,0,0,0, // 8/16
-  5,6,2,5};// 9/16
+static void MemoCopyIn(struct CalcContext *ctx, unsigned char *copy, const unsigned char *n1)
+{
+  #pragma MM_VAR n1
+  int i,i_end;
 
-  unsigned char accum[6];
+  i_end=BCD_BYTES(n1[BCD_LEN])+3;
+  for (i=0;i<i_end;i++) copy[i]=n1[i];
+}
 
-  CopyBCD(result,arg);
+static void MemoCopyOut(struct CalcContext *ctx, unsigned char *n1, const unsigned char *copy)
+{
+  #pragma MM_VAR n1
+  int i,i_end;
 
-  while (amount)
-  {
-    if (amount>3)
-    {
-      for (i=0;i<6;i++) accum[i]=0;
-      amount-=4;
+  i_end=BCD_BYTES(copy[BCD_LEN])+3;
+  for (i=0;i<i_end;i++) n1[i]=copy[i];
+}
+#endif
 
-      t1=result[BCD_DEC];
-      b0=0;
-      i_end=result[BCD_LEN]+3;
-      for (i=3;i<i_end;i++)
-      {
-        b1=0;
-        b2=result[i]*4;
-        for (j=3;j>=-1;j--)
-        {
-          if (j>=0) accum[b0+j]+=table[b2+j]+b1;
-          else accum[b0+j]+=b1;
+#ifdef ZIV_ROUND
+static bool ZivBCD(struct CalcContext *ctx, int op, unsigned char *result1, unsigned char *result2, unsigned char *n1, unsigned char *n2)
+{
+  #pragma MM_VAR result1
+  #pragma MM_VAR result2
+  #pragma MM_VAR n1
+  #pragma MM_VAR n2
 
-          if (accum[b0+j]>9)
-          {
-            accum[b0+j]-=10;
-            b1=1;
-          }
-          else b1=0;
-        }
+  int places=ctx->Settings.DecPlaces,rounding=places,guard,max_places,scale=-1,whole=0;
+  unsigned char sign=n1[BCD_SIGN];
+  bool success=true,done=false;
 
-        if (b0!=2) b0++;
-        else
-        {
-          if (t1) result[i-2]=accum[0];
-          else result[i-1]=accum[0];
+  //The built in tables only have enough digits for MATH_TABLE_PLACES
+  if (ctx->tables_generated) max_places=MATH_MAX_PLACES;
+  else max_places=MATH_TABLE_PLACES;
 
-          for (j=0;j<5;j++) accum[j]=accum[j+1];
-          accum[5]=0;
-        }
-      }
+  //The trig routines are good to about ZIV_ERROR/10. LnBCD scales its argument to 1 by
+  //powers of 2 and loses about a digit for every digit it moves it. y^x loses that many
+  //again for each whole digit of x, and exp a digit for each whole digit of the result.
+  if (op==ZivExp) scale=0;
+  if ((op==ZivLn)||(op==ZivPow)) scale=ZivDigits(ctx,n1)-1;
+  if (op==ZivPow)
+  {
+    if (n2[BCD_DEC]>LeadDigit(ctx,n2)) scale+=n2[BCD_DEC]-LeadDigit(ctx,n2);
+  }
+  guard=ZIV_GUARD_PLACES;
+  if (scale>0) guard+=scale;
 
-      b1=result[BCD_LEN]+3;
-      if (t1)
-      {
-        t1--;
-        result[BCD_LEN]=b1;
-        result[BCD_DEC]=t1;
-        b2=i-b0;
-      }
-      else
-      {
-        b1++;
-        result[3]=0;
-        result[BCD_LEN]=b1;
-        b2=i-b0+1;
-      }
-      for (j=0;j<5;j++) result[j+b2]=accum[j];
+  while (!done)
+  {
+    if (places+guard>=max_places)
+    {
+      guard=max_places-places;
+      if (guard<0) guard=0;
+      done=true;
+    }
+    if (guard>0)
+    {
+      ctx->Settings.DecPlaces=places+guard;
+      SetDecPlaces(ctx);
+    }
+    ctx->ziv_guard=guard;
 
-      if ((b1-t1)>Settings.DecPlaces) result[BCD_LEN]=t1+Settings.DecPlaces;
+    //ExpBCD clears the sign of its argument
+    n1[BCD_SIGN]=sign;
+    switch (op)
+    {
+      case ZivLn:
+        success=LnBCD(ctx,result1,n1);
+        break;
+      case ZivExp:
+        ExpBCD(ctx,result1,n1);
+        break;
+      case ZivPow:
+        success=PowBCD(ctx,result1,n1,n2);
+        break;
+      case ZivTan:
+        TanBCD(ctx,result1,result2,n1);
+        break;
+      case ZivAtan:
+        AtanBCD(ctx,result1,n1);
+        break;
     }
-    else
+    if ((!success)||(guard==0)) break;
+
+    if ((op==ZivExp)||(op==ZivPow))
     {
-      amount--;
-      i_end=result[BCD_LEN]+3;
-      b1=0;
-      for (i=3;i<i_end;i++)
-      {
-        b0=result[i];
-        b2=b0;
-        b0=(b0>>1)+b1;
-        b1=0;
-        if (b2&1) b1=8;
-        if (b0>7) b0-=3;
-        result[i]=b0;
-      }
-      if (b1)
-      {
-        if((result[BCD_LEN]-result[BCD_DEC])<Settings.DecPlaces)
-        {
-          b1=result[BCD_LEN]+1;
-          result[BCD_LEN]=b1;
-          result[b1+2]=5;
-        }
-      }
+      whole=result1[BCD_DEC]-LeadDigit(ctx,result1);
+      if (whole<0) whole=0;
+    }
+    //The key handlers cut the result of PowBCD to DecPlaces digits in all, counting
+    //the zero in front of the decimal point of an answer below 1
+    if (op==ZivPow)
+    {
+      if (whole) rounding=places-whole;
+      else rounding=places-1;
+      if (rounding<0) rounding=0;
+    }
+    if (ZivCheck(ctx,result1,rounding,scale+whole))
+    {
+      if ((op!=ZivTan)||(ZivCheck(ctx,result2,places,scale))) done=true;
+    }
+    guard*=2;
+    if (op==ZivExp)
+    {
+      //Enough places for the digits lost to the whole number part on the next try. If
+      //that is more than the tables have, more places can't make the rounding certain.
+      guard+=whole;
+      if (places+whole+ZIV_GUARD_PLACES>max_places) done=true;
     }
   }
-}
 
-static void PowBCD(unsigned char *result, unsigned char *base, unsigned char *exp)
-{
-  LnBCD(p3,base);
-  MultBCD(p4,p3,exp);
-  ExpBCD(result,p4);
+  if (ctx->Settings.DecPlaces!=places)
+  {
+    ctx->Settings.DecPlaces=places;
+    SetDecPlaces(ctx);
+    if (success)
+    {
+      ZivRound(ctx,result1,rounding);
+      if (op==ZivTan) ZivRound(ctx,result2,places);
+    }
+  }
+  ctx->ziv_guard=-1;
+  return success;
 }
 
-static void TanBCD(unsigned char *sine_result,unsigned char *cos_result,unsigned char *arg)
+static int ZivDigits(struct CalcContext *ctx, const unsigned char *n1)
 {
-  #pragma MM_VAR sine_result
-  #pragma MM_VAR cos_result
-
-  CopyBCD(p2,perm_zero);
-  CopyBCD(sine_result,perm_zero);
-  CopyBCD(cos_result,perm_K);
+  #pragma MM_VAR n1
 
-  CalcTanBCD(sine_result,cos_result,p2,arg,0);
-  sine_result[BCD_LEN]=Settings.DecPlaces;
-  cos_result[BCD_LEN]=Settings.DecPlaces;
+  int whole=n1[BCD_DEC]-LeadDigit(ctx,n1);
+  if (whole>0) return whole;
+  return FracZeros(ctx,n1,0)+1;
 }
 
-static void AcosBCD(unsigned char *result,unsigned char *arg)
+static bool ZivCheck(struct CalcContext *ctx, const unsigned char *n1, int places, int scale)
 {
-  CopyBCD(p0,arg);
-  MultBCD(p1,p0,arg);
-  ImmedBCD("1",p0);
-  SubBCD(p5,p0,p1);
-  ImmedBCD("0.5",p6);
-  PowBCD(p7,p5,p6);
-  DivBCD(p6,p7,arg);
-  AtanBCD(result,p6);
-}
+  #pragma MM_VAR n1
 
-static void AsinBCD(unsigned char *result,unsigned char *arg)
-{
-  CopyBCD(p0,arg);
-  MultBCD(p1,p0,arg);
-  ImmedBCD("1",p0);
-  SubBCD(p5,p0,p1);
-  ImmedBCD("0.5",p6);
-  PowBCD(p7,p5,p6);
-  DivBCD(p6,arg,p7);
-  AtanBCD(result,p6);
+  int i,extra,digits;
+  long guard=0,half=5,error=ZIV_ERROR;
+
+  //Numbers with no digits past places have nothing to round
+  extra=n1[BCD_LEN]-n1[BCD_DEC];
+  if (extra>ctx->Settings.DecPlaces) extra=ctx->Settings.DecPlaces;
+  extra-=places;
+  if (extra<=0) return true;
+
+  //Only the first digits past places are looked at. The error is scaled to them and one
+  //more is added for the digits left off.
+  digits=extra;
+  if (digits>9) digits=9;
+  for (i=scale+digits;i<extra;i++) error/=10;
+  for (i=extra;i<scale+digits;i++)
+  {
+    error*=10;
+    if (error>=500000000L) return false;
+  }
+  error++;
+
+  for (i=0;i<digits;i++)
+  {
+    guard=guard*10+GetDigit(ctx,n1,n1[BCD_DEC]+places+i);
+    if (i) half*=10;
+  }
+  return labs(guard-half)>error;
 }
 
-static void AtanBCD(unsigned char *result,unsigned char *arg)
+static void ZivRound(struct CalcContext *ctx, unsigned char *n1, int places)
 {
-  #pragma MM_VAR result
+  #pragma MM_VAR n1
 
-  CopyBCD(result,perm_zero);
-  ImmedBCD("1",p2);
-  CopyBCD(p3,arg);
-  CalcTanBCD(p2,p3,result,arg,1);
-  if ((result[BCD_DEC]<=Settings.DecPlaces)&&(result[BCD_LEN]>Settings.DecPlaces)) result[BCD_LEN]=Settings.DecPlaces;
+  if (n1[BCD_LEN]-n1[BCD_DEC]<=places) return;
+  //Room for a carry out of the first digit
+  PadBCD(ctx,n1,1);
+  FixBCD(ctx,n1,n1,n1[BCD_DEC],n1[BCD_DEC]+places);
+  FullShrinkBCD(ctx,n1);
 }
+#endif
 
-static void CalcTanBCD(unsigned char *result1,unsigned char *result2,unsigned char *result3,unsigned char *arg,int flag)
+static void CalcTanBCD(struct CalcContext *ctx, unsigned char *result1,unsigned char *result2,unsigned char *result3,unsigned char *arg,int flag)
 {
+  #pragma MM_VAR result1
   #pragma MM_VAR result2
+  #pragma MM_VAR x
+  #pragma MM_VAR y
+  #pragma MM_VAR next_x
+  #pragma MM_VAR next_y
+  #pragma MM_VAR temp
 
   unsigned int i;
   unsigned int trig_ptr=0;
+  bool up;
+  //x and y are worked out into the spare buffer and the pointers swapped instead of copying back
+  unsigned char *x=result1,*y=result2,*next_x=p1,*next_y=p0,*temp;
 
-  for (i=0;i<Settings.TrigTableSize;i++)
+  for (i=0;i<ctx->Settings.TrigTableSize;i++)
   {
-    if (flag==0) SubBCD(p1,arg,result3);
-
-    if (((flag==0)&&(p1[BCD_SIGN]==0))||((flag==1)&&(result2[BCD_SIGN]==0)))
+    if (flag==0)
     {
-      RorBCD(p0,result2,i);
-      AddBCD(p1,result1,p0);
-      RorBCD(p0,result1,i);
-      CopyBCD(result1,p1);
-      SubBCD(p1,result2,p0);
-      CopyBCD(result2,p1);
-      AddBCD(p0,result3,trig+trig_ptr);
+      SubBCD(ctx,next_x,arg,result3);
+      #ifdef CORDIC_TAIL
+        //An angle small enough for the linear step is done by it alone. This can only
+        //happen before the first rotation since perm_K is only right for a full run.
+        if ((i==0)&&(FracZeros(ctx,next_x,0)*2>=ctx->Settings.DecPlaces+2))
+        {
+          CopyBCD(ctx,y,perm_one);
+          break;
+        }
+      #endif
+      up=(next_x[BCD_SIGN]==0);
     }
     else
     {
-      RorBCD(p0,result2,i);
-      SubBCD(p1,result1,p0);
-      RorBCD(p0,result1,i);
-      CopyBCD(result1,p1);
-      AddBCD(p1,result2,p0);
-      CopyBCD(result2,p1);
-      SubBCD(p0,result3,trig+trig_ptr);
+      #ifdef CORDIC_TAIL
+        //x is never below 1, so y/x is below 10^-zeros and atan(y/x) is within
+        //10^-(3*zeros)/3 of it
+        if (FracZeros(ctx,y,0)*3>=ctx->Settings.DecPlaces+3) break;
+      #endif
+      up=(y[BCD_SIGN]==0);
     }
-    CopyBCD(result3,p0);
+
+    ShiftAddBCD(ctx,next_x,x,y,i,!up);
+    ShiftAddBCD(ctx,next_y,y,x,i,up);
+    if (up) AddBCD(ctx,result3,result3,trig+trig_ptr);
+    else SubBCD(ctx,result3,result3,trig+trig_ptr);
+
+    temp=x;
+    x=next_x;
+    next_x=temp;
+    temp=y;
+    y=next_y;
+    next_y=temp;
     trig_ptr+=MATH_ENTRY_SIZE;
   }
 
+  #ifdef CORDIC_TAIL
+    if (flag==0)
+    {
+      //Rotate by the rest of the angle in radians, t, with x+y*t and y-x*t
+      SubBCD(ctx,next_x,arg,result3);
+      DivBCD(ctx,result3,next_x,perm_deg);
+      MultBCD(ctx,next_x,y,result3);
+      MultBCD(ctx,next_y,x,result3);
+      AddBCD(ctx,x,x,next_x);
+      SubBCD(ctx,y,y,next_y);
+      CopyBCD(ctx,result3,arg);
+    }
+    else
+    {
+      //The rest of the angle is atan(y/x), or y/x radians
+      MultBCD(ctx,next_y,y,perm_deg);
+      DivBCD(ctx,next_x,next_y,x);
+      AddBCD(ctx,result3,result3,next_x);
+    }
+  #endif
+
+  if (x!=result1) CopyBCD(ctx,result1,x);
+  if (y!=result2) CopyBCD(ctx,result2,y);
 }
 
-static int CompBCD(const char *num, unsigned char *var)
+static int CompBCD(struct CalcContext *ctx, const char *num, unsigned char *var)
 {
-  ImmedBCD(num,p0);
-  return CompVarBCD(p0,var);
+  ImmedBCD(ctx,num,p0);
+  return CompVarBCD(ctx,p0,var);
 }
 
-static int CompVarBCD(unsigned char *var1, unsigned char *var2)
+static int CompVarBCD(struct CalcContext *ctx, unsigned char *var1, unsigned char *var2)
 {
-  SubBCD(p1,var1,var2);
-  if (IsZero(p1)) return COMP_EQ;
-  else if (p1[BCD_SIGN]==0) return COMP_GT;
-  else return COMP_LT;
+  #pragma MM_VAR var1
+  #pragma MM_VAR var2
+
+  int i,w,w_end,len1,len2,dec1,dec2,lead1,lead2;
+  int cached1=-1,cached2=-1;
+  unsigned char sign,d1,d2,byte1=0,byte2=0;
+
+  sign=var1[BCD_SIGN];
+  if (sign!=var2[BCD_SIGN])
+  {
+    if (IsZero(ctx,var1)&&IsZero(ctx,var2)) return COMP_EQ;
+    else if (sign==0) return COMP_GT;
+    else return COMP_LT;
+  }
+
+  len1=var1[BCD_LEN];
+  dec1=var1[BCD_DEC];
+  len2=var2[BCD_LEN];
+  dec2=var2[BCD_DEC];
+
+  //The one with more whole digits is bigger. Zero has no first digit so it is compared
+  //digit by digit below.
+  lead1=LeadDigit(ctx,var1);
+  lead2=LeadDigit(ctx,var2);
+  if ((lead1<len1)&&(lead2<len2)&&((dec1-lead1)!=(dec2-lead2)))
+  {
+    if (((dec1-lead1)>(dec2-lead2))==(sign==0)) return COMP_GT;
+    else return COMP_LT;
+  }
+
+  //Line up the decimal places and compare from the highest place down. Leading and
+  //trailing zeroes are compared like any other digit.
+  w=dec1;
+  if (dec2>w) w=dec2;
+  w_end=dec1-len1;
+  if ((dec2-len2)<w_end) w_end=dec2-len2;
+  for (w--;w>=w_end;w--)
+  {
+    d1=0;
+    i=dec1-1-w;
+    if ((i>=0)&&(i<len1))
+    {
+      if ((i>>1)!=cached1)
+      {
+        cached1=i>>1;
+        byte1=var1[cached1+3];
+      }
+      if (i&1) d1=byte1&0xF;
+      else d1=byte1>>4;
+    }
+    d2=0;
+    i=dec2-1-w;
+    if ((i>=0)&&(i<len2))
+    {
+      if ((i>>1)!=cached2)
+      {
+        cached2=i>>1;
+        byte2=var2[cached2+3];
+      }
+      if (i&1) d2=byte2&0xF;
+      else d2=byte2>>4;
+    }
+    if (d1!=d2)
+    {
+      if ((d1>d2)==(sign==0)) return COMP_GT;
+      else return COMP_LT;
+    }
+  }
+  return COMP_EQ;
 }
 
-int TrigPrep(int *cosine)
+int TrigPrep(struct CalcContext *ctx, int *cosine)
 {
   int sine;
 
-  if (Settings.DegRad) CopyBCD(p3,BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE);
+  if (ctx->Settings.DegRad) CopyBCD(ctx,p3,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE);
   else
   {
-    ImmedBCD(deg_factor,p0);
-    MultBCD(p3,BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE,p0);
+    //Radians are reduced first so the multiply doesn't carry the whole turns
+    ModBCD(ctx,p2,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE,perm_2pi);
+    MultBCD(ctx,p3,p2,perm_deg);
   }
 
-  ImmedBCD("360",p2);
-  while(CompVarBCD(p3,p2)==COMP_GT) CopyBCD(p3,p1);
+  ModBCD(ctx,p3,p3,perm_360);
 
-  if (CompBCD("180",p3)==COMP_LT)
+  if (CompVarBCD(ctx,perm_180,p3)==COMP_LT)
   {
-    SubBCD(stack_buffer,p2,p3);
+    SubBCD(ctx,stack_buffer,perm_360,p3);
     sine=1;
   }
   else
   {
-    CopyBCD(stack_buffer,p3);
+    CopyBCD(ctx,stack_buffer,p3);
     sine=0;
   }
-  if (CompBCD("90",stack_buffer)==COMP_LT)
+  if (CompVarBCD(ctx,perm_90,stack_buffer)==COMP_LT)
   {
-    ImmedBCD("180",p2);
-    SubBCD(p3,p2,stack_buffer);
+    SubBCD(ctx,p3,perm_180,stack_buffer);
     *cosine=1;
   }
   else
   {
-    CopyBCD(p3,stack_buffer);
+    CopyBCD(ctx,p3,stack_buffer);
     *cosine=0;
   }
   return sine;
@@ -1514,7 +3980,8 @@ void ClrLCD()
   printf("|--------------------|\n");
 }
 
-void DrawStack(bool menu, bool input, int stack_ptr)
+#ifndef BATCH
+void DrawStack(struct CalcContext *ctx, bool menu, bool input, int stack_ptr)
 {
   int i,j=4,k,k_end,l,m;
   if (menu) j--;
@@ -1528,20 +3995,17 @@ void DrawStack(bool menu, bool input, int stack_ptr)
     {
       if (BCD_stack[(stack_ptr-j+i)*MATH_CELL_SIZE+BCD_DEC]==0)
       {
-        PadBCD(BCD_stack+(stack_ptr-j+i)*MATH_CELL_SIZE,1);
+        PadBCD(ctx,BCD_stack+(stack_ptr-j+i)*MATH_CELL_SIZE,1);
       }
-      CopyBCD(p1,BCD_stack+(stack_ptr-j+i)*MATH_CELL_SIZE);
+      CopyBCD(ctx,p1,BCD_stack+(stack_ptr-j+i)*MATH_CELL_SIZE);
 
-      if (Settings.SciNot)
+      if (ctx->Settings.SciNot)
       {
-        if (IsZero(p1)) LCD_Text("0.e0");
+        l=LeadDigit(ctx,p1);
+        if (l==p1[BCD_LEN]) LCD_Text("0.e0");
         else
         {
-          k=0;
-          for (l=0;l<p1[BCD_LEN];l++) if (p1[l+3]) k=l;
-          p1[BCD_LEN]=k+1;
-
-          for (l=0;l<p1[BCD_LEN];l++) if (p1[l+3]!=0) break;
+          p1[BCD_LEN]=TrailDigit(ctx,p1);
 
           m=0;
           k=(p1[BCD_DEC]-l-1);
@@ -1566,7 +4030,7 @@ void DrawStack(bool menu, bool input, int stack_ptr)
           if (p1[BCD_SIGN]) putchar('-');
           for (k=0;k<k_end;k++)
           {
-            putchar(p1[k+l+3]+'0');
+            putchar(GetDigit(ctx,p1,k+l)+'0');
             if (k==0) putchar('.');
           }
 
@@ -1585,13 +4049,10 @@ void DrawStack(bool menu, bool input, int stack_ptr)
       }
       else
       {
-        k=p1[BCD_LEN];
-
-        while ((p1[k+2]==0)&&(k!=p1[BCD_DEC]))
-        {
-          p1[BCD_LEN]-=1;
-          k--;
-        }
+        //Trailing zeroes after the decimal point aren't shown
+        k=TrailDigit(ctx,p1);
+        if (k<p1[BCD_DEC]) k=p1[BCD_DEC];
+        p1[BCD_LEN]=k;
         k_end=p1[BCD_LEN];
         if (k_end>=18)
         {
@@ -1625,7 +4086,7 @@ void DrawStack(bool menu, bool input, int stack_ptr)
         }
         for (l=3;l<k_end+3;l++)
         {
-          putchar(p1[l]+'0');
+          putchar(GetDigit(ctx,p1,l-3)+'0');
           if (p1[BCD_DEC]==l-2)
           {
             if (l+k<20) putchar('.');
@@ -1644,7 +4105,7 @@ void DrawStack(bool menu, bool input, int stack_ptr)
   #endif
 }
 
-void DrawInput(unsigned char *line, int input_ptr, int offset, bool menu)
+void DrawInput(struct CalcContext *ctx, unsigned char *line, int input_ptr, int offset, bool menu)
 {
   #pragma MM_VAR line
 
@@ -1682,10 +4143,17 @@ void DrawInput(unsigned char *line, int input_ptr, int offset, bool menu)
   refresh();
   #endif
 }
+#endif
 
-void ErrorMsg(const char *msg)
+void ErrorMsg(struct CalcContext *ctx, const char *msg)
 {
   int i,j=0,tx,char_max=5,height=1;
+
+  #ifdef BATCH
+  if (ctx->batch_error==NULL) ctx->batch_error=msg;
+  return;
+  #endif
+
   for (i=0;msg[i];i++)
   {
     if (msg[i]=='\n')
@@ -1738,7 +4206,7 @@ void ErrorMsg(const char *msg)
   refresh();
   #endif
 
-  while (GetKey()!=KEY_ENTER);
+  while (GetKey(ctx)!=KEY_ENTER);
 }
 
 static void Number2(int num)
@@ -1755,64 +4223,292 @@ static void Number2(int num)
   }
 }
 
-static void SetDecPlaces()
+static void SetDecPlaces(struct CalcContext *ctx)
 {
   int i,j=2;
 
-  for (i=0;i<MATH_TRIG_TABLE;i++)
+  if ((ctx->Settings.DecPlaces>MATH_TABLE_PLACES)&&(!ctx->tables_generated)) GenerateTables(ctx);
+
+  for (i=0;i<ctx->trig_count;i++)
+  {
+    trig[i*MATH_ENTRY_SIZE+BCD_LEN]=j+ctx->Settings.DecPlaces;
+    if (ctx->trig_lead[i]>=j+ctx->Settings.DecPlaces) break;
+  }
+
+  ctx->Settings.TrigTableSize=i;
+
+  for (i=0;i<ctx->log_count;i++)
+  {
+    logs[i*MATH_ENTRY_SIZE+BCD_LEN]=j+ctx->Settings.DecPlaces;
+    if (ctx->log_lead[i]>=j+ctx->Settings.DecPlaces) break;
+  }
+
+  ctx->Settings.LogTableSize=i;
+
+  #ifdef CORDIC_TAIL
+    //What is left after entry k is below 2^-k and the linear step is off by about its
+    //square. The first 8 log entries are powers of 2 times ln(2) so k starts after them.
+    if (ctx->Settings.TrigTableSize/2+CORDIC_TAIL_EXTRA<ctx->Settings.TrigTableSize)
+    {
+      ctx->Settings.TrigTableSize=ctx->Settings.TrigTableSize/2+CORDIC_TAIL_EXTRA;
+    }
+    if ((ctx->Settings.LogTableSize+8)/2+CORDIC_TAIL_EXTRA<ctx->Settings.LogTableSize)
+    {
+      ctx->Settings.LogTableSize=(ctx->Settings.LogTableSize+8)/2+CORDIC_TAIL_EXTRA;
+    }
+  #endif
+
+  perm_K[BCD_LEN]=1+ctx->Settings.DecPlaces;
+  perm_log10[BCD_LEN]=1+ctx->Settings.DecPlaces;
+  if (ctx->tables_generated)
+  {
+    //The built in constants are already this long
+    perm_deg[BCD_LEN]=2+ctx->Settings.DecPlaces;
+    perm_2pi[BCD_LEN]=2+ctx->Settings.DecPlaces;
+  }
+}
+
+static void CalcInit(struct CalcContext *ctx)
+{
+  int i;
+
+  ctx->stack_ptr=0;
+  ctx->counter1=0;
+  ctx->counter2=0;
+  ImmedBCD(ctx,"0",perm_zero);
+  ImmedBCD(ctx,K,perm_K);
+  ImmedBCD(ctx,log10_factor,perm_log10);
+  ImmedBCD(ctx,"1",perm_one);
+  ImmedBCD(ctx,"10",perm_ten);
+  ImmedBCD(ctx,"90",perm_90);
+  ImmedBCD(ctx,"180",perm_180);
+  ImmedBCD(ctx,"360",perm_360);
+  ImmedBCD(ctx,deg_factor,perm_deg);
+  ImmedBCD(ctx,two_pi,perm_2pi);
+  ImmedBCD(ctx,pi,perm_pi);
+
+  MakeTables(ctx);
+  ctx->log_count=MATH_LOG_TABLE;
+  ctx->trig_count=MATH_TRIG_TABLE;
+  FindLeads(ctx);
+  ctx->tables_generated=false;
+  #ifdef ZIV_ROUND
+  ctx->ziv_guard=-1;
+  #endif
+  #ifdef BATCH
+  ctx->batch_file=stdin;
+  ctx->batch_keys[0]=0;
+  ctx->batch_key_ptr=0;
+  ctx->batch_line=false;
+  ctx->batch_error=NULL;
+  #endif
+  #ifdef MEMO_CACHE
+  for (i=0;i<MEMO_ENTRIES;i++) ctx->memo[i].used=0;
+  ctx->memo_clock=0;
+  ctx->memo_hits=0;
+  ctx->memo_misses=0;
+  ctx->memo_busy=false;
+  #endif
+
+  ctx->Settings.ColorStack=true;
+  ctx->Settings.DecPlaces=32;
+  ctx->Settings.DegRad=true;
+  ctx->Settings.LogTableSize=MATH_LOG_TABLE;
+  ctx->Settings.SciNot=false;
+  ctx->Settings.TrigTableSize=MATH_TRIG_TABLE;
+  SetDecPlaces(ctx);
+}
+
+#ifdef BENCHMARK
+//Operations timed by the benchmark
+enum BenchOps {BenchAdd,BenchSub,BenchMult,BenchDiv,BenchLn,BenchExp,BenchPow,BenchCalcTan,BenchAtan,BenchCount};
+static const char *BenchNames[BenchCount]={"add","sub","mult","div","ln","exp","pow","calctan","atan"};
+
+//Decimal places to time at. The CORDIC routines from BenchLn on are only timed up to
+//BENCH_CORDIC_MAX places, where SetDecPlaces generates tables past MATH_TABLE_PLACES.
+//Arithmetic on more than 100 digits would overflow a MATH_CELL_SIZE result.
+static const int BenchPlaces[]={8,16,32,64,96};
+#define BENCH_LEVELS     5
+#define BENCH_CORDIC_MAX MATH_MAX_PLACES
+
+//Each operation runs on new random operands until both limits are reached
+#define BENCH_MIN_OPS 16
+#define BENCH_SECONDS 0.25
+
+static void BenchNumber(char *text, int whole, int decimals, bool negative)
+{
+  int i=0;
+
+  if (negative) text[i++]='-';
+  text[i++]='1'+rand()%9;
+  while (--whole>0) text[i++]='0'+rand()%10;
+  if (decimals) text[i++]='.';
+  while (decimals-->0) text[i++]='0'+rand()%10;
+  text[i]=0;
+}
+
+static void BenchSetup(struct CalcContext *ctx, int op)
+{
+  char text[MATH_CELL_SIZE*2];
+  unsigned char *x=BCD_stack, *y=BCD_stack+MATH_CELL_SIZE;
+
+  switch (op)
   {
-    trig[i*MATH_ENTRY_SIZE+BCD_LEN]=j+Settings.DecPlaces;
-    if (IsZero(trig+i*MATH_ENTRY_SIZE)) break;
+    case BenchAdd:
+    case BenchSub:
+    case BenchMult:
+    case BenchDiv:
+      BenchNumber(text,1+rand()%4,ctx->Settings.DecPlaces,rand()&1);
+      ImmedBCD(ctx,text,x);
+      BenchNumber(text,1+rand()%4,ctx->Settings.DecPlaces,rand()&1);
+      ImmedBCD(ctx,text,y);
+      break;
+    case BenchLn:
+      BenchNumber(text,1+rand()%3,ctx->Settings.DecPlaces,false);
+      ImmedBCD(ctx,text,x);
+      break;
+    case BenchExp:
+      BenchNumber(text,1+rand()%2,ctx->Settings.DecPlaces,rand()&1);
+      ImmedBCD(ctx,text,x);
+      break;
+    case BenchPow:
+      BenchNumber(text,1+rand()%2,ctx->Settings.DecPlaces,false);
+      ImmedBCD(ctx,text,x);
+      BenchNumber(text,1,ctx->Settings.DecPlaces,rand()&1);
+      ImmedBCD(ctx,text,y);
+      break;
+    case BenchCalcTan:
+      //Degrees between 0 and 90 as left by TrigPrep
+      BenchNumber(text,1+rand()%2,ctx->Settings.DecPlaces,false);
+      if (text[1]!='.') text[0]='1'+rand()%8;
+      ImmedBCD(ctx,text,x);
+      CopyBCD(ctx,p2,perm_zero);
+      CopyBCD(ctx,stack_buffer,perm_zero);
+      CopyBCD(ctx,y,perm_K);
+      break;
+    case BenchAtan:
+      BenchNumber(text,1+rand()%3,ctx->Settings.DecPlaces,rand()&1);
+      ImmedBCD(ctx,text,x);
+      break;
   }
+}
 
-  Settings.TrigTableSize=i;
+static void BenchRun(struct CalcContext *ctx, int op)
+{
+  unsigned char *x=BCD_stack, *y=BCD_stack+MATH_CELL_SIZE;
 
-  for (i=0;i<MATH_LOG_TABLE;i++)
+  switch (op)
   {
-    logs[i*MATH_ENTRY_SIZE+BCD_LEN]=j+Settings.DecPlaces;
-    if (IsZero(logs+i*MATH_ENTRY_SIZE)) break;
+    case BenchAdd:
+      AddBCD(ctx,stack_buffer,x,y);
+      break;
+    case BenchSub:
+      SubBCD(ctx,stack_buffer,x,y);
+      break;
+    case BenchMult:
+      MultBCD(ctx,stack_buffer,x,y);
+      break;
+    case BenchDiv:
+      DivBCD(ctx,stack_buffer,x,y);
+      break;
+    case BenchLn:
+      LnBCD(ctx,stack_buffer,x);
+      break;
+    case BenchExp:
+      ExpBCD(ctx,stack_buffer,x);
+      break;
+    case BenchPow:
+      PowBCD(ctx,stack_buffer,x,y);
+      break;
+    case BenchCalcTan:
+      CalcTanBCD(ctx,stack_buffer,y,p2,x,0);
+      break;
+    case BenchAtan:
+      AtanBCD(ctx,stack_buffer,x);
+      break;
   }
+}
 
-  Settings.LogTableSize=i;
+static void Benchmark(struct CalcContext *ctx)
+{
+  int i,op;
+  long ops;
+  double start,elapsed;
+  unsigned long reads,writes;
+
+  fprintf(stdout,"op,dec_places,ops,seconds,ops_per_sec,reads_per_op,writes_per_op\n");
+  for (i=0;i<BENCH_LEVELS;i++)
+  {
+    ctx->Settings.DecPlaces=BenchPlaces[i];
+    if (ctx->Settings.DecPlaces<=BENCH_CORDIC_MAX) SetDecPlaces(ctx);
 
-  perm_K[BCD_LEN]=1+Settings.DecPlaces;
-  perm_log10[BCD_LEN]=1+Settings.DecPlaces;
+    for (op=0;op<BenchCount;op++)
+    {
+      if ((op>=BenchLn)&&(ctx->Settings.DecPlaces>BENCH_CORDIC_MAX)) continue;
+
+      //Same operands on every run
+      srand(op*1000+ctx->Settings.DecPlaces);
+      elapsed=0;
+      reads=0;
+      writes=0;
+      for (ops=0;(ops<BENCH_MIN_OPS)||(elapsed<BENCH_SECONDS);ops++)
+      {
+        BenchSetup(ctx,op);
+        ctx->counter1=0;
+        ctx->counter2=0;
+        start=BenchTime();
+        BenchRun(ctx,op);
+        elapsed+=BenchTime()-start;
+        reads+=ctx->counter1;
+        writes+=ctx->counter2;
+      }
+      fprintf(stdout,"%s,%d,%ld,%.6f,%.1f,%.1f,%.1f\n",BenchNames[op],ctx->Settings.DecPlaces,ops,elapsed,
+              ops/elapsed,(double)reads/ops,(double)writes/ops);
+    }
+  }
 }
+#endif
 
 
-int main()
+int main(int argc, char *argv[])
 {
   int key,i,j,k,x,y;
   #pragma MM_ASSIGN_GLOBALS
 
+  //The calculator run from the keyboard
+  static struct CalcContext calc;
+  struct CalcContext *ctx=&calc;
+  CalcInit(ctx);
+
+  #ifdef BENCHMARK
+  Benchmark(ctx);
+  return 0;
+  #endif
+
   bool shift=false, redraw=true, input=false;
-  bool menu=false, redraw_input=false, do_input=false;
+  bool redraw_input=false, do_input=false;
+  #ifndef BATCH
+  bool menu=false;
+  #endif
   int input_ptr=0, input_offset=0;
   int process_output;
   static const char StartInput[]="0123456789.";
 
-  #ifdef LINUX
+  #ifdef BATCH
+  if (argc>1) ctx->batch_file=fopen(argv[1],"r");
+  if (ctx->batch_file==NULL)
+  {
+    fprintf(stderr,"Can't open %s\n",argv[1]);
+    return 1;
+  }
+  #elif defined LINUX
   initscr();
   raw();
   noecho();
   keypad(stdscr, TRUE);
   #endif
 
-  stack_ptr=0;
-  ImmedBCD("0",perm_zero);
-  ImmedBCD(K,perm_K);
-  ImmedBCD(log10_factor,perm_log10);
-
-  MakeTables();
-
-  Settings.ColorStack=true;
-  Settings.DecPlaces=32;
-  Settings.DegRad=true;
-  Settings.LogTableSize=MATH_LOG_TABLE;
-  Settings.SciNot=false;
-  Settings.TrigTableSize=MATH_TRIG_TABLE;
-  SetDecPlaces();
-
+  #ifndef BATCH
   clrscr();
 
   SetColor(true);
@@ -1844,24 +4540,30 @@ int main()
     printf(" %s",legend[i]+j);
   }
   SetColor(true);
+  #endif
 
   int redraw_count=0;
 
   do
   {
+    //Nothing is drawn in batch mode but the keys still ask for it
     if (redraw)
     {
+      #ifndef BATCH
       ClrLCD();
-      DrawStack(menu,input,stack_ptr);
+      DrawStack(ctx,menu,input,ctx->stack_ptr);
+      #endif
       redraw=false;
     }
     if (redraw_input)
     {
-      DrawInput(p0,input_ptr,input_offset,menu);
+      #ifndef BATCH
+      DrawInput(ctx,p0,input_ptr,input_offset,menu);
+      #endif
       redraw_input=false;
     }
 
-    key=GetKey();
+    key=GetKey(ctx);
 
     j=0;
     do
@@ -1877,16 +4579,18 @@ int main()
     {
       if (input==false)
       {
-        if (stack_ptr==STACK_SIZE)
+        if (ctx->stack_ptr==STACK_SIZE)
         {
-          ErrorMsg("Stack full");
+          ErrorMsg(ctx,"Stack full");
           redraw=true;
         }
         else
         {
           input=true;
+          #ifndef BATCH
           ClrLCD();
-          DrawStack(menu,input,stack_ptr);
+          DrawStack(ctx,menu,input,ctx->stack_ptr);
+          #endif
           input_offset=0;
           input_ptr=1;
           p0[0]=key;
@@ -1897,7 +4601,7 @@ int main()
       }
       else
       {
-        if (input_ptr<255)
+        if (input_ptr<(MATH_CELL_SIZE-2))
         {
           k=0;
           for (j=input_ptr;p0[j];j++) k++;
@@ -2018,7 +4722,7 @@ int main()
         }
         if (x==2)
         {
-          ErrorMsg("Invalid input");
+          ErrorMsg(ctx,"Invalid input");
           redraw_input=true;
         }
         else if (p0[0]==0)
@@ -2031,10 +4735,10 @@ int main()
         else
         {
           SetBlink(false);
-          BufferBCD(p0,BCD_stack+stack_ptr*MATH_CELL_SIZE);
-          if (IsZero(BCD_stack+stack_ptr*MATH_CELL_SIZE)&&(BCD_stack[stack_ptr*MATH_CELL_SIZE+BCD_SIGN])) BCD_stack[stack_ptr*MATH_CELL_SIZE+BCD_SIGN]=0;
-          FullShrinkBCD(BCD_stack+stack_ptr*MATH_CELL_SIZE);
-          stack_ptr++;
+          BufferBCD(ctx,p0,BCD_stack+ctx->stack_ptr*MATH_CELL_SIZE);
+          if (IsZero(ctx,BCD_stack+ctx->stack_ptr*MATH_CELL_SIZE)&&(BCD_stack[ctx->stack_ptr*MATH_CELL_SIZE+BCD_SIGN])) BCD_stack[ctx->stack_ptr*MATH_CELL_SIZE+BCD_SIGN]=0;
+          FullShrinkBCD(ctx,BCD_stack+ctx->stack_ptr*MATH_CELL_SIZE);
+          ctx->stack_ptr++;
           input=false;
         }
         redraw=true;
@@ -2045,105 +4749,113 @@ int main()
       switch (key)
       {
         case '+':
-          if (stack_ptr>=2)
+          if (ctx->stack_ptr>=2)
           {
-            AddBCD(stack_buffer,BCD_stack+(stack_ptr-2)*MATH_CELL_SIZE,BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE);
+            AddBCD(ctx,stack_buffer,BCD_stack+(ctx->stack_ptr-2)*MATH_CELL_SIZE,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE);
             process_output=2;
             redraw=true;
           }
           break;
         case '-':
-          if (stack_ptr>=2)
+          if (ctx->stack_ptr>=2)
           {
-            SubBCD(stack_buffer,BCD_stack+(stack_ptr-2)*MATH_CELL_SIZE,BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE);
+            SubBCD(ctx,stack_buffer,BCD_stack+(ctx->stack_ptr-2)*MATH_CELL_SIZE,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE);
             process_output=2;
             redraw=true;
           }
           break;
         case '/':
-          if (stack_ptr>=2)
+          if (ctx->stack_ptr>=2)
           {
-            if (IsZero(BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE))
+            if (IsZero(ctx,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE))
             {
-              ErrorMsg("Divide by zero");
+              ErrorMsg(ctx,"Divide by zero");
             }
             else
             {
-              DivBCD(stack_buffer,BCD_stack+(stack_ptr-2)*MATH_CELL_SIZE,BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE);
+              DivBCD(ctx,stack_buffer,BCD_stack+(ctx->stack_ptr-2)*MATH_CELL_SIZE,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE);
               process_output=2;
             }
             redraw=true;
           }
           break;
         case '*':
-          if (stack_ptr>=2)
+          if (ctx->stack_ptr>=2)
           {
-            MultBCD(stack_buffer,BCD_stack+(stack_ptr-2)*MATH_CELL_SIZE,BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE);
-            process_output=2;
+            //The product has to fit in one cell
+            if (MultDigits(ctx,BCD_stack+(ctx->stack_ptr-2)*MATH_CELL_SIZE,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE)>MATH_MAX_DIGITS)
+            {
+              ErrorMsg(ctx,"Argument\ntoo large");
+            }
+            else
+            {
+              MultBCD(ctx,stack_buffer,BCD_stack+(ctx->stack_ptr-2)*MATH_CELL_SIZE,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE);
+              process_output=2;
+            }
             redraw=true;
           }
           break;
         case KEY_BACKSPACE:
         case KEY_DELETE:
-          if (stack_ptr>=1)
+          if (ctx->stack_ptr>=1)
           {
-            stack_ptr--;
+            ctx->stack_ptr--;
             redraw=true;
           }
           break;
         case KEY_ENTER:
         case 'd':
-          if (stack_ptr>=1)
+          if (ctx->stack_ptr>=1)
           {
-            if (stack_ptr==STACK_SIZE)
+            if (ctx->stack_ptr==STACK_SIZE)
             {
-              ErrorMsg("Stack full");
+              ErrorMsg(ctx,"Stack full");
             }
             else
             {
-              CopyBCD(BCD_stack+(stack_ptr)*MATH_CELL_SIZE,BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE);
-              stack_ptr++;
+              CopyBCD(ctx,BCD_stack+(ctx->stack_ptr)*MATH_CELL_SIZE,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE);
+              ctx->stack_ptr++;
             }
             redraw=true;
           }
           break;
         case KEY_LEFT:
-          if (stack_ptr>=1)
+          if (ctx->stack_ptr>=1)
           {
-            RolBCD(stack_buffer,BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE,1);
+            RolBCD(ctx,stack_buffer,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE,1);
             process_output=1;
             redraw=true;
           }
           break;
         case KEY_RIGHT:
-          if (stack_ptr>=1)
+          if (ctx->stack_ptr>=1)
           {
-            RorBCD(stack_buffer,BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE,1);
+            RorBCD(ctx,stack_buffer,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE,1);
             process_output=1;
             redraw=true;
           }
           break;
         case KEY_UP:
-          if (stack_ptr>=2)
+          if (ctx->stack_ptr>=2)
           {
-            CopyBCD(stack_buffer,BCD_stack);
-            for (i=0;i<(stack_ptr-1);i++)
+            CopyBCD(ctx,stack_buffer,BCD_stack);
+            for (i=0;i<(ctx->stack_ptr-1);i++)
             {
-              CopyBCD(BCD_stack+i*MATH_CELL_SIZE,BCD_stack+(i+1)*MATH_CELL_SIZE);
+              CopyBCD(ctx,BCD_stack+i*MATH_CELL_SIZE,BCD_stack+(i+1)*MATH_CELL_SIZE);
             }
-            CopyBCD(BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE,stack_buffer);
+            CopyBCD(ctx,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE,stack_buffer);
             redraw=true;
           }
           break;
         case KEY_DOWN:
-          if (stack_ptr>=2)
+          if (ctx->stack_ptr>=2)
           {
-            CopyBCD(stack_buffer,BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE);
-            for (i=(stack_ptr-1);i>0;i--)
+            CopyBCD(ctx,stack_buffer,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE);
+            for (i=(ctx->stack_ptr-1);i>0;i--)
             {
-              CopyBCD(BCD_stack+(i)*MATH_CELL_SIZE,BCD_stack+(i-1)*MATH_CELL_SIZE);
+              CopyBCD(ctx,BCD_stack+(i)*MATH_CELL_SIZE,BCD_stack+(i-1)*MATH_CELL_SIZE);
             }
-            CopyBCD(BCD_stack,stack_buffer);
+            CopyBCD(ctx,BCD_stack,stack_buffer);
             redraw=true;
           }
           break;
@@ -2151,13 +4863,13 @@ int main()
           shift=!shift;
           break;
         case 'a'://atan
-          if (stack_ptr>=1)
+          if (ctx->stack_ptr>=1)
           {
-            //counter1=0;
-            //counter2=0;
-            AtanBCD(stack_buffer,BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE);
+            //ctx->counter1=0;
+            //ctx->counter2=0;
+            AtanBCD(ctx,stack_buffer,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE);
 
-            //printf("*%ul %ul*",counter1,counter2);
+            //printf("*%ul %ul*",ctx->counter1,ctx->counter2);
             //getch();
 
             process_output=1;
@@ -2167,118 +4879,124 @@ int main()
         case 'b':
           break;
         case 'c'://cosine
-          if (stack_ptr>=1)
+          if (ctx->stack_ptr>=1)
           {
-            BCD_stack[(stack_ptr-1)*MATH_CELL_SIZE+BCD_SIGN]=0;
-            TrigPrep(&j);
-            if (IsZero(p3)) ImmedBCD("1",stack_buffer);
-            else TanBCD(p4,stack_buffer,p3);
+            BCD_stack[(ctx->stack_ptr-1)*MATH_CELL_SIZE+BCD_SIGN]=0;
+            TrigPrep(ctx,&j);
+            if (IsZero(ctx,p3)) CopyBCD(ctx,stack_buffer,perm_one);
+            else TanBCD(ctx,p4,stack_buffer,p3);
             if (j==1) stack_buffer[BCD_SIGN]=1;
             process_output=1;
             redraw=true;
           }
           break;
         case 'e'://e^x
-          if (stack_ptr>=1)
+          if (ctx->stack_ptr>=1)
           {
-            if (CompBCD("177",BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE)==COMP_LT)
+            if (CompBCD(ctx,"177",BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE)==COMP_LT)
             {
-              ErrorMsg("Argument\ntoo large");
+              ErrorMsg(ctx,"Argument\ntoo large");
             }
             else
             {
-              ExpBCD(stack_buffer,BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE);
+              ExpBCD(ctx,stack_buffer,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE);
               process_output=1;
             }
             redraw=true;
           }
           break;
         case 'g'://acos
-          if (stack_ptr>=1)
+          if (ctx->stack_ptr>=1)
           {
             process_output=1;
-            i=CompBCD("0",BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE);
-            j=CompBCD("1",BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE);
-            k=CompBCD("-1",BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE);
-            if (i==COMP_EQ) ImmedBCD("90",stack_buffer);
-            else if (j==COMP_EQ) ImmedBCD("0",stack_buffer);
-            else if (k==COMP_EQ) ImmedBCD("180",stack_buffer);
+            i=CompVarBCD(ctx,perm_zero,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE);
+            j=CompVarBCD(ctx,perm_one,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE);
+            k=CompBCD(ctx,"-1",BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE);
+            if (i==COMP_EQ) CopyBCD(ctx,stack_buffer,perm_90);
+            else if (j==COMP_EQ) CopyBCD(ctx,stack_buffer,perm_zero);
+            else if (k==COMP_EQ) CopyBCD(ctx,stack_buffer,perm_180);
             else if ((j==COMP_LT)||(k==COMP_GT))
             {
-              ErrorMsg("Invalid input");
+              ErrorMsg(ctx,"Invalid input");
               process_output=0;
             }
-            else AcosBCD(stack_buffer,BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE);
+            else AcosBCD(ctx,stack_buffer,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE);
             redraw=true;
           }
           break;
         case 'h'://asin
-          if (stack_ptr>=1)
+          if (ctx->stack_ptr>=1)
           {
             process_output=1;
-            i=CompBCD("0",BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE);
-            j=CompBCD("1",BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE);
-            k=CompBCD("-1",BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE);
-            if (i==COMP_EQ) ImmedBCD("0",stack_buffer);
-            else if (j==COMP_EQ) ImmedBCD("90",stack_buffer);
-            else if (k==COMP_EQ) ImmedBCD("-90",stack_buffer);
+            i=CompVarBCD(ctx,perm_zero,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE);
+            j=CompVarBCD(ctx,perm_one,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE);
+            k=CompBCD(ctx,"-1",BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE);
+            if (i==COMP_EQ) CopyBCD(ctx,stack_buffer,perm_zero);
+            else if (j==COMP_EQ) CopyBCD(ctx,stack_buffer,perm_90);
+            else if (k==COMP_EQ) ImmedBCD(ctx,"-90",stack_buffer);
             else if ((j==COMP_LT)||(k==COMP_GT))
             {
-              ErrorMsg("Invalid input");
+              ErrorMsg(ctx,"Invalid input");
               process_output=0;
             }
-            else AsinBCD(stack_buffer,BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE);
+            else AsinBCD(ctx,stack_buffer,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE);
             redraw=true;
           }
           break;
         case 'i'://pi
-          if (stack_ptr==STACK_SIZE)
+          if (ctx->stack_ptr==STACK_SIZE)
           {
-            ErrorMsg("Stack full");
+            ErrorMsg(ctx,"Stack full");
           }
           else
           {
-            stack_ptr++;
-            ImmedBCD(pi,BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE);
-            BCD_stack[(stack_ptr-1)*MATH_CELL_SIZE+BCD_LEN]=1+Settings.DecPlaces;
+            ctx->stack_ptr++;
+            CopyBCD(ctx,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE,perm_pi);
+            BCD_stack[(ctx->stack_ptr-1)*MATH_CELL_SIZE+BCD_LEN]=1+ctx->Settings.DecPlaces;
           }
           redraw=true;
           break;
         case 'j'://10^x
-          if (stack_ptr>=1)
+          if (ctx->stack_ptr>=1)
           {
             x=0;
-            j=CompVarBCD(perm_zero,BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE);
+            j=CompVarBCD(ctx,perm_zero,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE);
 
-            if (j==COMP_EQ) ImmedBCD("1",stack_buffer);
+            if (j==COMP_EQ) CopyBCD(ctx,stack_buffer,perm_one);
             else
             {
               if (j==COMP_GT) j=1;
               else j=0;
-              BCD_stack[(stack_ptr-1)*MATH_CELL_SIZE+BCD_SIGN]=0;
+              BCD_stack[(ctx->stack_ptr-1)*MATH_CELL_SIZE+BCD_SIGN]=0;
 
-              CopyBCD(p2,BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE);
+              CopyBCD(ctx,p2,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE);
               p2[BCD_LEN]=p2[BCD_DEC];
-              if (CompVarBCD(p2,BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE)==COMP_EQ)//x is an integer
+              if (CompVarBCD(ctx,p2,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE)==COMP_EQ)//x is an integer
               {
-                ImmedBCD("254",p2);
-                if (CompVarBCD(BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE,p2)==COMP_GT)
+                ImmedBCD(ctx,"254",p2);
+                if (CompVarBCD(ctx,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE,p2)==COMP_GT)
                 {
                   i=255;
                 }
                 else
                 {
-                  i=BCD_stack[(stack_ptr-1)*MATH_CELL_SIZE+3]*100;
-                  i+=BCD_stack[(stack_ptr-1)*MATH_CELL_SIZE+4]*10;
-                  i+=BCD_stack[(stack_ptr-1)*MATH_CELL_SIZE+5];
-                  if (BCD_stack[(stack_ptr-1)*MATH_CELL_SIZE+BCD_DEC]==2) i/=10;
-                  else if (BCD_stack[(stack_ptr-1)*MATH_CELL_SIZE+BCD_DEC]==1) i/=100;
+                  i=GetDigit(ctx,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE,0)*100;
+                  i+=GetDigit(ctx,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE,1)*10;
+                  i+=GetDigit(ctx,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE,2);
+                  if (BCD_stack[(ctx->stack_ptr-1)*MATH_CELL_SIZE+BCD_DEC]==2) i/=10;
+                  else if (BCD_stack[(ctx->stack_ptr-1)*MATH_CELL_SIZE+BCD_DEC]==1) i/=100;
                 }
 
-                if (i>254)
+                //A negative power too large to hold is too small to show
+                if ((i>254)&&(j))
+                {
+                  CopyBCD(ctx,stack_buffer,perm_zero);
+                  j=0;
+                }
+                else if (i>254)
                 {
-                  ErrorMsg("Invalid input");
-                  BCD_stack[(stack_ptr-1)*MATH_CELL_SIZE+BCD_SIGN]=j;
+                  ErrorMsg(ctx,"Invalid input");
+                  BCD_stack[(ctx->stack_ptr-1)*MATH_CELL_SIZE+BCD_SIGN]=j;
                   x=1;
                 }
                 else
@@ -2286,29 +5004,41 @@ int main()
                   stack_buffer[BCD_SIGN]=0;
                   stack_buffer[BCD_DEC]=i+1;
                   stack_buffer[BCD_LEN]=i+1;
-                  stack_buffer[3]=1;
-                  for (k=0;k<i;k++)
+                  stack_buffer[3]=0x10;
+                  for (k=1;k<BCD_BYTES(i+1);k++)
                   {
-                    stack_buffer[k+4]=0;
+                    stack_buffer[k+3]=0;
                   }
                 }
               }
               else
               {
-                ImmedBCD("10",p5);
-                PowBCD(stack_buffer,p5,BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE);
-                if (stack_buffer[BCD_DEC]>(Settings.DecPlaces)) stack_buffer[BCD_LEN]=stack_buffer[BCD_DEC];
-                else if (stack_buffer[BCD_LEN]>(Settings.DecPlaces))
+                CopyBCD(ctx,p5,perm_ten);
+                if (!PowBCD(ctx,stack_buffer,p5,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE))
+                {
+                  if (j)
+                  {
+                    CopyBCD(ctx,stack_buffer,perm_zero);
+                    j=0;
+                  }
+                  else
+                  {
+                    ErrorMsg(ctx,"Argument\ntoo large");
+                    BCD_stack[(ctx->stack_ptr-1)*MATH_CELL_SIZE+BCD_SIGN]=j;
+                    x=1;
+                  }
+                }
+                else if (stack_buffer[BCD_DEC]>(ctx->Settings.DecPlaces)) stack_buffer[BCD_LEN]=stack_buffer[BCD_DEC];
+                else if (stack_buffer[BCD_LEN]>(ctx->Settings.DecPlaces))
                 {
-                  stack_buffer[BCD_LEN]=Settings.DecPlaces;
+                  stack_buffer[BCD_LEN]=ctx->Settings.DecPlaces;
                 }
               }
 
               if ((j)&&(x==0))
               {
-                ImmedBCD("1",p2);
-                DivBCD(p3,p2,stack_buffer);
-                CopyBCD(stack_buffer,p3);
+                DivBCD(ctx,p3,perm_one,stack_buffer);
+                CopyBCD(ctx,stack_buffer,p3);
               }
             }
             if (x==0) process_output=1;
@@ -2316,24 +5046,24 @@ int main()
           }
           break;
         case 'k'://log
-          if (stack_ptr>=1)
+          if (ctx->stack_ptr>=1)
           {
-            if (CompVarBCD(perm_zero,BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE)!=COMP_LT)
+            if (CompVarBCD(ctx,perm_zero,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE)!=COMP_LT)
             {
-              ErrorMsg("Invalid input");
+              ErrorMsg(ctx,"Invalid input");
             }
             else
             {
               x=0;
-              if (BCD_stack[(stack_ptr-1)*MATH_CELL_SIZE+3]==1)
+              if (GetDigit(ctx,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE,0)==1)
               {
-                CopyBCD(p0,BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE);
+                CopyBCD(ctx,p0,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE);
 
                 j=p0[BCD_DEC];
                 k=p0[BCD_LEN];
                 for (i=k;i>j;i--)
                 {
-                  if (p0[i+2]==0) k--;
+                  if (GetDigit(ctx,p0,i-1)==0) k--;
                   else break;
                 }
 
@@ -2341,17 +5071,16 @@ int main()
 
                 if (p0[BCD_LEN]==p0[BCD_DEC])
                 {
-                  p0[3]=0;
-                  if (IsZero(p0))
+                  SetDigit(ctx,p0,0,0);
+                  if (IsZero(ctx,p0))
                   {
                     stack_buffer[BCD_LEN]=3;
                     stack_buffer[BCD_DEC]=3;
                     stack_buffer[BCD_SIGN]=0;
                     i=p0[BCD_LEN]-1;
-                    stack_buffer[3]=i/100;
-                    stack_buffer[4]=(i%100)/10;
-                    stack_buffer[5]=(i%10);
-                    FullShrinkBCD(stack_buffer);
+                    stack_buffer[3]=((i/100)<<4)|((i%100)/10);
+                    stack_buffer[4]=(i%10)<<4;
+                    FullShrinkBCD(ctx,stack_buffer);
                     process_output=1;
                     x=1;
                   }
@@ -2360,74 +5089,72 @@ int main()
 
               if (!x)
               {
-                if (LnBCD(p3,BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE))
+                if (LnBCD(ctx,p3,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE))
                 {
-                  DivBCD(stack_buffer,p3,perm_log10);
+                  DivBCD(ctx,stack_buffer,p3,perm_log10);
                   process_output=1;
                 }
-                else ErrorMsg("Argument\ntoo large");
+                else ErrorMsg(ctx,"Argument\ntoo large");
               }
             }
             redraw=true;
           }
           break;
         case 'l'://ln
-          if (stack_ptr>=1)
+          if (ctx->stack_ptr>=1)
           {
-            if (CompVarBCD(perm_zero,BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE)!=COMP_LT)
+            if (CompVarBCD(ctx,perm_zero,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE)!=COMP_LT)
             {
-              ErrorMsg("Invalid input");
+              ErrorMsg(ctx,"Invalid input");
             }
             else
             {
-              if (LnBCD(stack_buffer,BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE)) process_output=1;
-              else ErrorMsg("Argument\ntoo large");
+              if (LnBCD(ctx,stack_buffer,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE)) process_output=1;
+              else ErrorMsg(ctx,"Argument\ntoo large");
             }
             redraw=true;
           }
           break;
         case 'm':// +/-
-          if (stack_ptr>=1)
+          if (ctx->stack_ptr>=1)
           {
-            if (CompVarBCD(perm_zero,BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE)!=COMP_EQ)
+            if (CompVarBCD(ctx,perm_zero,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE)!=COMP_EQ)
             {
-              if (BCD_stack[(stack_ptr-1)*MATH_CELL_SIZE+BCD_SIGN]==0)
+              if (BCD_stack[(ctx->stack_ptr-1)*MATH_CELL_SIZE+BCD_SIGN]==0)
               {
-                BCD_stack[(stack_ptr-1)*MATH_CELL_SIZE+BCD_SIGN]=1;
+                BCD_stack[(ctx->stack_ptr-1)*MATH_CELL_SIZE+BCD_SIGN]=1;
               }
-              else BCD_stack[(stack_ptr-1)*MATH_CELL_SIZE+BCD_SIGN]=0;
+              else BCD_stack[(ctx->stack_ptr-1)*MATH_CELL_SIZE+BCD_SIGN]=0;
             }
             redraw=true;
           }
           break;
         case 'n':// 1/x
-          if (stack_ptr>=1)
+          if (ctx->stack_ptr>=1)
           {
-            if (IsZero(BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE))
+            if (IsZero(ctx,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE))
             {
-              ErrorMsg("Divide by zero");
+              ErrorMsg(ctx,"Divide by zero");
             }
             else
             {
-              ImmedBCD("1",p0);
-              DivBCD(stack_buffer,p0,BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE);
+              DivBCD(ctx,stack_buffer,perm_one,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE);
               process_output=1;
             }
             redraw=true;
           }
           break;
         case 'o'://round
-          if (stack_ptr>=1)
+          if (ctx->stack_ptr>=1)
           {
-            if (BCD_stack[(stack_ptr-1)*MATH_CELL_SIZE+BCD_LEN]>BCD_stack[(stack_ptr-1)*MATH_CELL_SIZE+BCD_DEC])
+            if (BCD_stack[(ctx->stack_ptr-1)*MATH_CELL_SIZE+BCD_LEN]>BCD_stack[(ctx->stack_ptr-1)*MATH_CELL_SIZE+BCD_DEC])
             {
-              BCD_stack[(stack_ptr-1)*MATH_CELL_SIZE+BCD_LEN]=BCD_stack[(stack_ptr-1)*MATH_CELL_SIZE+BCD_DEC];
-              if (BCD_stack[(stack_ptr-1)*MATH_CELL_SIZE+BCD_stack[(stack_ptr-1)*MATH_CELL_SIZE+BCD_LEN]+3]>4)
+              BCD_stack[(ctx->stack_ptr-1)*MATH_CELL_SIZE+BCD_LEN]=BCD_stack[(ctx->stack_ptr-1)*MATH_CELL_SIZE+BCD_DEC];
+              if (GetDigit(ctx,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE,BCD_stack[(ctx->stack_ptr-1)*MATH_CELL_SIZE+BCD_LEN])>4)
               {
-                ImmedBCD("1",p0);
-                AddBCD(stack_buffer,p0,BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE);
+                AddBCD(ctx,stack_buffer,perm_one,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE);
               }
-              else CopyBCD(stack_buffer,BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE);
+              else CopyBCD(ctx,stack_buffer,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE);
               process_output=1;
             }
             redraw=true;
@@ -2435,33 +5162,32 @@ int main()
           break;
         case 'p'://y^x
         case 'r'://x root y
-          if (stack_ptr>=2)
+          if (ctx->stack_ptr>=2)
           {
             x=0;
             if (key=='r')
             {
-              if (IsZero(BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE))
+              if (IsZero(ctx,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE))
               {
-                ErrorMsg("Invalid Input");
+                ErrorMsg(ctx,"Invalid Input");
                 x=1;
               }
               else
               {
-                ImmedBCD("1",p3);
-                DivBCD(p5,p3,BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE);
+                DivBCD(ctx,p5,perm_one,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE);
               }
             }
-            else CopyBCD(p5,BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE);
+            else CopyBCD(ctx,p5,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE);
 
             if (x==0)
             {
-              j=CompVarBCD(perm_zero,p5);
-              k=CompVarBCD(perm_zero,BCD_stack+(stack_ptr-2)*MATH_CELL_SIZE);
+              j=CompVarBCD(ctx,perm_zero,p5);
+              k=CompVarBCD(ctx,perm_zero,BCD_stack+(ctx->stack_ptr-2)*MATH_CELL_SIZE);
 
               if (k==COMP_GT)
               {
                 y=1;
-                BCD_stack[(stack_ptr-2)*MATH_CELL_SIZE+BCD_SIGN]=0;
+                BCD_stack[(ctx->stack_ptr-2)*MATH_CELL_SIZE+BCD_SIGN]=0;
               }
               else y=0;
 
@@ -2471,54 +5197,68 @@ int main()
                 p5[BCD_SIGN]=0;
               }
 
-              if (k==COMP_EQ) ImmedBCD("0",stack_buffer);
-              else if (j==COMP_EQ) ImmedBCD("1",stack_buffer);
+              if (k==COMP_EQ) CopyBCD(ctx,stack_buffer,perm_zero);
+              else if (j==COMP_EQ) CopyBCD(ctx,stack_buffer,perm_one);
               else
               {
-                CopyBCD(p2,BCD_stack+(stack_ptr-2)*MATH_CELL_SIZE);
+                CopyBCD(ctx,p2,BCD_stack+(ctx->stack_ptr-2)*MATH_CELL_SIZE);
                 p2[BCD_LEN]=p2[BCD_DEC];
-                if (CompVarBCD(p2,BCD_stack+(stack_ptr-2)*MATH_CELL_SIZE)==COMP_EQ) j=1;
+                if (CompVarBCD(ctx,p2,BCD_stack+(ctx->stack_ptr-2)*MATH_CELL_SIZE)==COMP_EQ) j=1;
                 else j=0;
-                CopyBCD(p2,p5);
+                CopyBCD(ctx,p2,p5);
                 p2[BCD_LEN]=p2[BCD_DEC];
-                if (CompVarBCD(p2,p5)==COMP_EQ) j+=2;
+                if (CompVarBCD(ctx,p2,p5)==COMP_EQ) j+=2;
 
                 if (y&1)//y is negative
                 {
                   if (j&2)//x is an integer
                   {
-                    ///BCD_stack[(stack_ptr-2)*MATH_CELL_SIZE+BCD_SIGN]=0;
+                    ///BCD_stack[(ctx->stack_ptr-2)*MATH_CELL_SIZE+BCD_SIGN]=0;
+                  }
+                  else
+                  {
+                    ErrorMsg(ctx,"Invalid input");
+                    BCD_stack[(ctx->stack_ptr-2)*MATH_CELL_SIZE+BCD_SIGN]=(y&1);
+                    x=1;
+                  }
+                }
+
+                if ((x==0)&&(!PowBCD(ctx,stack_buffer,BCD_stack+(ctx->stack_ptr-2)*MATH_CELL_SIZE,p5)))
+                {
+                  //A negative power too large to hold is too small to show
+                  if (y&2)
+                  {
+                    CopyBCD(ctx,stack_buffer,perm_zero);
+                    y=0;
                   }
                   else
                   {
-                    ErrorMsg("Invalid input");
-                    BCD_stack[(stack_ptr-2)*MATH_CELL_SIZE+BCD_SIGN]=(y&1);
+                    ErrorMsg(ctx,"Argument\ntoo large");
+                    BCD_stack[(ctx->stack_ptr-2)*MATH_CELL_SIZE+BCD_SIGN]=(y&1);
                     x=1;
                   }
                 }
 
                 if (x==0)
                 {
-                  PowBCD(stack_buffer,BCD_stack+(stack_ptr-2)*MATH_CELL_SIZE,p5);
-                  if (stack_buffer[BCD_DEC]>(Settings.DecPlaces))
+                  if (stack_buffer[BCD_DEC]>(ctx->Settings.DecPlaces))
                   {
                     stack_buffer[BCD_LEN]=stack_buffer[BCD_DEC];
                   }
-                  else if (stack_buffer[BCD_LEN]>(Settings.DecPlaces))
+                  else if (stack_buffer[BCD_LEN]>(ctx->Settings.DecPlaces))
                   {
-                    stack_buffer[BCD_LEN]=Settings.DecPlaces;
+                    stack_buffer[BCD_LEN]=ctx->Settings.DecPlaces;
                   }
 
                   if (y&2)
                   {
-                    ImmedBCD("1",p2);
-                    DivBCD(p3,p2,stack_buffer);
-                    CopyBCD(stack_buffer,p3);
+                    DivBCD(ctx,p3,perm_one,stack_buffer);
+                    CopyBCD(ctx,stack_buffer,p3);
                   }
 
                   if (y&1)
                   {
-                    if (p5[p5[BCD_DEC]+2]%2==1)
+                    if (GetDigit(ctx,p5,p5[BCD_DEC]-1)%2==1)
                     {
                       stack_buffer[BCD_SIGN]=(y&1);
                     }
@@ -2531,25 +5271,24 @@ int main()
           }
           break;
         case 'q'://sqrt
-          if (stack_ptr>=1)
+          if (ctx->stack_ptr>=1)
           {
-            if (IsZero(BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE))
+            if (IsZero(ctx,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE))
             {
-              ImmedBCD("0",stack_buffer);
+              CopyBCD(ctx,stack_buffer,perm_zero);
               process_output=1;
             }
-            else if (BCD_stack[(stack_ptr-1)*MATH_CELL_SIZE+BCD_SIGN]==1)
+            else if (BCD_stack[(ctx->stack_ptr-1)*MATH_CELL_SIZE+BCD_SIGN]==1)
             {
-              ErrorMsg("Invalid input");
+              ErrorMsg(ctx,"Invalid input");
             }
             else
             {
-              ImmedBCD("0.5",p5);
-              PowBCD(stack_buffer,BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE,p5);
-              if (stack_buffer[BCD_DEC]>(Settings.DecPlaces)) stack_buffer[BCD_LEN]=stack_buffer[BCD_DEC];
-              else if (stack_buffer[BCD_LEN]>(Settings.DecPlaces))
+              SqrtBCD(ctx,stack_buffer,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE);
+              if (stack_buffer[BCD_DEC]>(ctx->Settings.DecPlaces)) stack_buffer[BCD_LEN]=stack_buffer[BCD_DEC];
+              else if (stack_buffer[BCD_LEN]>(ctx->Settings.DecPlaces))
               {
-                stack_buffer[BCD_LEN]=Settings.DecPlaces;
+                stack_buffer[BCD_LEN]=ctx->Settings.DecPlaces;
               }
               process_output=1;
             }
@@ -2558,31 +5297,31 @@ int main()
           break;
         case 's'://sin
         case 't'://tan
-          if (stack_ptr>=1)
+          if (ctx->stack_ptr>=1)
           {
-            if (BCD_stack[(stack_ptr-1)*MATH_CELL_SIZE+BCD_SIGN]==1)
+            if (BCD_stack[(ctx->stack_ptr-1)*MATH_CELL_SIZE+BCD_SIGN]==1)
             {
-              BCD_stack[(stack_ptr-1)*MATH_CELL_SIZE+BCD_SIGN]=0;
+              BCD_stack[(ctx->stack_ptr-1)*MATH_CELL_SIZE+BCD_SIGN]=0;
               j=1;
             }
             else j=0;
-            j+=TrigPrep(&k);
+            j+=TrigPrep(ctx,&k);
 
-            if ((key=='t')&&(CompBCD("90",p3)==COMP_EQ))
+            if ((key=='t')&&(CompVarBCD(ctx,perm_90,p3)==COMP_EQ))
             {
-              ErrorMsg("Invalid input");
+              ErrorMsg(ctx,"Invalid input");
             }
             else
             {
-              TanBCD(stack_buffer,p4,p3);
-              if (CompBCD("90",p3)==COMP_EQ) ImmedBCD("1",stack_buffer);
+              TanBCD(ctx,stack_buffer,p4,p3);
+              if (CompVarBCD(ctx,perm_90,p3)==COMP_EQ) CopyBCD(ctx,stack_buffer,perm_one);
               if (j==1) stack_buffer[BCD_SIGN]=1;
               if (k==1) p4[BCD_SIGN]=1;
 
               if (key=='t')
               {
-                DivBCD(p3,stack_buffer,p4);
-                CopyBCD(stack_buffer,p3);
+                DivBCD(ctx,p3,stack_buffer,p4);
+                CopyBCD(ctx,stack_buffer,p3);
               }
               process_output=1;
             }
@@ -2600,12 +5339,12 @@ int main()
           gotoxy(1,3);
           LCD_Text("Color stack:");
 
-          i=Settings.DecPlaces;
+          i=ctx->Settings.DecPlaces;
           x=5;
           y=0;
           do
           {
-            if (x!=5) key=GetKey();
+            if (x!=5) key=GetKey(ctx);
 
             if ((key==KEY_DOWN)||(key==KEY_UP))
             {
@@ -2622,9 +5361,9 @@ int main()
             {
               if (y==0)
               {
-                if (Settings.DecPlaces<32)
+                if (ctx->Settings.DecPlaces<MATH_MAX_PLACES)
                 {
-                  Settings.DecPlaces++;
+                  ctx->Settings.DecPlaces++;
                   x=1;
                 }
               }
@@ -2633,9 +5372,9 @@ int main()
             {
               if (y==0)
               {
-                if (Settings.DecPlaces>6)
+                if (ctx->Settings.DecPlaces>6)
                 {
-                  Settings.DecPlaces--;
+                  ctx->Settings.DecPlaces--;
                   x=1;
                 }
               }
@@ -2645,17 +5384,17 @@ int main()
             {
               if (y==1)
               {
-                Settings.DegRad=!Settings.DegRad;
+                ctx->Settings.DegRad=!ctx->Settings.DegRad;
                 x=2;
               }
               else if (y==2)
               {
-                Settings.SciNot=!Settings.SciNot;
+                ctx->Settings.SciNot=!ctx->Settings.SciNot;
                 x=3;
               }
               else if (y==3)
               {
-                Settings.ColorStack=!Settings.ColorStack;
+                ctx->Settings.ColorStack=!ctx->Settings.ColorStack;
                 x=4;
               }
             }
@@ -2663,81 +5402,70 @@ int main()
             if ((x==1)||(x==5))
             {
               gotoxy(16,0);
-              Number2(Settings.DecPlaces);
+              Number2(ctx->Settings.DecPlaces);
             }
             if ((x==2)||(x==5))
             {
               gotoxy(15,1);
-              if (Settings.DegRad) LCD_Text("Deg");
+              if (ctx->Settings.DegRad) LCD_Text("Deg");
               else LCD_Text("Rad");
             }
             if ((x==3)||(x==5))
             {
               gotoxy(15,2);
-              if (Settings.SciNot) LCD_Text(" On");
+              if (ctx->Settings.SciNot) LCD_Text(" On");
               else LCD_Text("Off");
             }
             if ((x==4)||(x==5))
             {
               gotoxy(15,3);
-              if (Settings.ColorStack) LCD_Text(" On");
+              if (ctx->Settings.ColorStack) LCD_Text(" On");
               else LCD_Text("Off");
             }
             x=0;
           } while ((key!=KEY_ESCAPE)&&(key!=KEY_ENTER));
 
-          if (i!=Settings.DecPlaces) SetDecPlaces();
+          if (i!=ctx->Settings.DecPlaces) SetDecPlaces(ctx);
           key=0;
           redraw=true;
           break;
         case 'v'://mod
-          if (stack_ptr>=2)
+          if (ctx->stack_ptr>=2)
           {
-            if (IsZero(BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE))
+            if (IsZero(ctx,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE))
             {
-              ErrorMsg("Invalid Input");
+              ErrorMsg(ctx,"Invalid Input");
             }
             else
             {
-              CopyBCD(p3,BCD_stack+(stack_ptr-2)*MATH_CELL_SIZE);
-              CopyBCD(p2,BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE);
-
-              if (p3[BCD_SIGN]==1) j=1;
-              else j=0;
-              p3[BCD_SIGN]=0;
-              p2[BCD_SIGN]=0;
-
-              while(1)
-              {
-                SubBCD(p0,p3,p2);
-                if (p0[BCD_SIGN])
-                {
-                  CopyBCD(stack_buffer,p3);
-                  break;
-                }
-                else CopyBCD(p3,p0);
-              }
-              stack_buffer[BCD_SIGN]=j;
+              ModBCD(ctx,stack_buffer,BCD_stack+(ctx->stack_ptr-2)*MATH_CELL_SIZE,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE);
               process_output=2;
             }
             redraw=true;
           }
           break;
         case 'w'://swap
-          if (stack_ptr>=2)
+          if (ctx->stack_ptr>=2)
           {
-            CopyBCD(stack_buffer,BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE);
-            CopyBCD(BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE,BCD_stack+(stack_ptr-2)*MATH_CELL_SIZE);
-            CopyBCD(BCD_stack+(stack_ptr-2)*MATH_CELL_SIZE,stack_buffer);
+            CopyBCD(ctx,stack_buffer,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE);
+            CopyBCD(ctx,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE,BCD_stack+(ctx->stack_ptr-2)*MATH_CELL_SIZE);
+            CopyBCD(ctx,BCD_stack+(ctx->stack_ptr-2)*MATH_CELL_SIZE,stack_buffer);
             redraw=true;
           }
           break;
         case 'x'://x^2
-          if (stack_ptr>=1)
+          if (ctx->stack_ptr>=1)
           {
-            CopyBCD(p0,BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE);
-            MultBCD(stack_buffer,p0,BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE);
-            process_output=1;
+            if (MultDigits(ctx,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE)>MATH_MAX_DIGITS)
+            {
+              ErrorMsg(ctx,"Argument\ntoo large");
+            }
+            else
+            {
+              CopyBCD(ctx,p0,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE);
+              MultBCD(ctx,stack_buffer,p0,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE);
+              process_output=1;
+            }
             redraw=true;
           }
           break;
@@ -2745,9 +5473,9 @@ int main()
           key=KEY_ESCAPE;
           break;
         case 'z'://clear
-          if (stack_ptr>=1)
+          if (ctx->stack_ptr>=1)
           {
-            stack_ptr=0;
+            ctx->stack_ptr=0;
             redraw=true;
           }
           break;
@@ -2755,33 +5483,35 @@ int main()
           process_output=0;
       }
 
-      if (Settings.DegRad==false)
+      if (ctx->Settings.DegRad==false)
       {
         if ((key=='a')||(key=='g')||(key=='h'))
         {
           if (process_output>0)
           {
-            CopyBCD(p0,stack_buffer);
-            ImmedBCD(deg_factor,p1);
-            DivBCD(stack_buffer,p0,p1);
+            CopyBCD(ctx,p0,stack_buffer);
+            DivBCD(ctx,stack_buffer,p0,perm_deg);
           }
         }
       }
 
-      if (process_output==2) stack_ptr--;
+      if (process_output==2) ctx->stack_ptr--;
       if (process_output>0)
       {
-        FullShrinkBCD(stack_buffer);
-        if (IsZero(stack_buffer)&&(stack_buffer[BCD_SIGN])) stack_buffer[BCD_SIGN]=0;
-        CopyBCD(BCD_stack+(stack_ptr-1)*MATH_CELL_SIZE,stack_buffer);
+        FullShrinkBCD(ctx,stack_buffer);
+        if (IsZero(ctx,stack_buffer)&&(stack_buffer[BCD_SIGN])) stack_buffer[BCD_SIGN]=0;
+        CopyBCD(ctx,BCD_stack+(ctx->stack_ptr-1)*MATH_CELL_SIZE,stack_buffer);
       }
     }
   } while (key!=KEY_ESCAPE);
   gotoxy(-1,19);
   SetColor(true);
   SetBlink(true);
-  #ifdef LINUX
+  #if defined LINUX && !defined BATCH
   endwin();
   #endif
-  return;
+  #if defined BATCH && defined MEMO_CACHE
+  fprintf(stderr,"Memo cache: %lu hits, %lu misses\n",ctx->memo_hits,ctx->memo_misses);
+  #endif
+  return 0;
 }
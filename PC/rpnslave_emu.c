@@ -0,0 +1,549 @@
+/**   RPN Scientific Calculator for MSP430
+ *    Copyright (C) 2014 Joey Shepard
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+//Linux build of the MSP430 slave. The dispatch loop in rpnslave.c runs
+//unchanged on top of the register stand-ins in emu/msp430.h, so the
+//bytes on the wire are exactly what the real slave sends and expects.
+//The SRAM is simulated behind RAM_Read/RAM_Write (one bank only, since
+//the bank pin belongs to the master).
+//
+//Build from the top of the tree:
+//  gcc -o memmap preprocessor/memmap.c
+//  ./memmap MSP430/rpnslave.c rpnslave_mm.c
+//  gcc -IPC/emu -IMSP430 -I. -o rpnslave_emu PC/rpnslave_emu.c
+//
+//Usage:
+//  rpnslave_emu            opens a pseudo-terminal and prints its name
+//  rpnslave_emu -f FD      talks over an inherited descriptor, such as
+//                          one end of a socketpair
+//  rpnslave_emu -t         runs a short master session over a socketpair
+//                          and exits with 1 if any of its checks fail
+//  -s FILE                 writes the per-command counts to FILE
+//
+//When the other side hangs up (or on Ctrl+C) the slave prints one line
+//per command: calls, bytes from the master, bytes to the master and
+//round trips, counted as each time the slave answers after receiving.
+
+//cfmakeraw is a BSD extension that _XOPEN_SOURCE alone hides
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#ifndef SLAVE_SOURCE
+  #define SLAVE_SOURCE "rpnslave_mm.c"
+#endif
+
+#define main SlaveMain
+#include SLAVE_SOURCE
+#undef main
+
+//Keep in the same order as enum SlaveCommands in common.h
+static const char *CommandNames[]={"RAM_Read","RAM_Write","Sync","Answer","MakeTables",
+                                   "Add","Subtract","Buffer","Multiply","Divide","Shrink",
+                                   "FullShrink","Pad","IsZero","Copy","Ln","Exp","Rol",
+                                   "Ror","Pow","Tan","Acos","Asin","Atan","CalcTan",
+                                   "CompVar","TrigPrep","Settings","SetDecPlaces","Sqrt",
+                                   "RAM_ReadBlock","RAM_WriteBlock","RAM_Copy","unknown"};
+
+#define SLAVE_COMMANDS (SlaveRAM_Copy+1)
+
+struct CommandStats
+{
+  unsigned long calls;
+  unsigned long bytes_in;
+  unsigned long bytes_out;
+  unsigned long round_trips;
+};
+
+static void EmuCommandEnd();
+static void EmuExit();
+static void EmuQuit(int sig);
+static void EmuLayout();
+static int EmuSession(int fd);
+
+unsigned int WDTCTL;
+unsigned char BCSCTL1, DCOCTL, CALBC1_16MHZ, CALDCO_16MHZ;
+unsigned char UCA0CTL0, UCA0CTL1, UCA0MCTL, UCA0BR0, UCA0BR1;
+unsigned char UCB0CTL0, UCB0CTL1, UCB0BR0, UCB0BR1;
+unsigned char P1SEL, P1SEL2, P1DIR, P2SEL, P2SEL2, P2DIR, P2OUT;
+
+static int emu_fd=-1;
+static FILE *emu_stats_file;
+static jmp_buf emu_layout;
+static volatile sig_atomic_t emu_quit=0;
+
+static unsigned char emu_sram[65536];
+static unsigned char emu_p1out=RAM_OE|RAM_WE|ADDRESS_LATCH;
+static unsigned char emu_spi;
+static bool emu_spi_pending=false;
+static unsigned int emu_shift=0, emu_address=0;
+
+static unsigned char emu_txbuf, emu_rxbuf;
+static bool emu_tx_pending=false, emu_rx_valid=false;
+static int emu_idle=0;
+
+//Totals so far and where they stood when the current command arrived
+static struct CommandStats emu_total, emu_mark;
+static struct CommandStats emu_stats[SLAVE_COMMANDS+1];
+static int emu_command=-1;
+static bool emu_last_in=false;
+
+int main(int argc, char *argv[])
+{
+  int i, sv[2], slave_fd, failed;
+  bool test=false;
+  pid_t pid;
+  struct termios tio;
+
+  emu_stats_file=stderr;
+  for (i=1;i<argc;i++)
+  {
+    if ((!strcmp(argv[i],"-f"))&&(i+1<argc)) emu_fd=atoi(argv[++i]);
+    else if ((!strcmp(argv[i],"-s"))&&(i+1<argc))
+    {
+      emu_stats_file=fopen(argv[++i],"w");
+      if (!emu_stats_file)
+      {
+        fprintf(stderr,"Can't write \"%s\".\n",argv[i]);
+        return 1;
+      }
+    }
+    else if (!strcmp(argv[i],"-t")) test=true;
+    else
+    {
+      fprintf(stderr,"Usage: rpnslave_emu [-f FD] [-t] [-s FILE]\n");
+      return 1;
+    }
+  }
+
+  signal(SIGINT,EmuQuit);
+  signal(SIGTERM,EmuQuit);
+  signal(SIGPIPE,SIG_IGN);
+
+  if (test)
+  {
+    if (socketpair(AF_UNIX,SOCK_STREAM,0,sv))
+    {
+      perror("socketpair");
+      return 1;
+    }
+    pid=fork();
+    if (pid<0)
+    {
+      perror("fork");
+      return 1;
+    }
+    if (pid==0)
+    {
+      close(sv[0]);
+      emu_fd=sv[1];
+      SlaveMain();
+    }
+    close(sv[1]);
+    EmuLayout();
+    failed=EmuSession(sv[0]);
+    close(sv[0]);
+    waitpid(pid,NULL,0);
+    return failed!=0;
+  }
+
+  if (emu_fd<0)
+  {
+    emu_fd=posix_openpt(O_RDWR|O_NOCTTY);
+    if ((emu_fd<0)||grantpt(emu_fd)||unlockpt(emu_fd))
+    {
+      perror("posix_openpt");
+      return 1;
+    }
+    //Hold the other end open in raw mode so bytes pass through untouched
+    slave_fd=open(ptsname(emu_fd),O_RDWR|O_NOCTTY);
+    if (slave_fd<0)
+    {
+      perror("open");
+      return 1;
+    }
+    tcgetattr(slave_fd,&tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave_fd,TCSANOW,&tio);
+    printf("%s\n",ptsname(emu_fd));
+    fflush(stdout);
+  }
+
+  SlaveMain();
+  return 0;
+}
+
+unsigned char EmuIFG()
+{
+  struct pollfd pfd;
+  int status;
+
+  if (emu_quit) EmuExit();
+  if (emu_fd<0) longjmp(emu_layout,1);
+
+  if (emu_tx_pending)
+  {
+    if (write(emu_fd,&emu_txbuf,1)!=1) EmuExit();
+    emu_tx_pending=false;
+  }
+
+  if (!emu_rx_valid)
+  {
+    //Spin while traffic is flowing, then back off to 1ms polls when idle
+    pfd.fd=emu_fd;
+    pfd.events=POLLIN;
+    status=poll(&pfd,1,emu_idle>1000?1:0);
+    if (status>0)
+    {
+      if (read(emu_fd,&emu_rxbuf,1)!=1) EmuExit();
+      emu_rx_valid=true;
+      emu_idle=0;
+
+      //The slave only waits for a byte with the LED off between commands
+      if (!(emu_p1out&LED))
+      {
+        EmuCommandEnd();
+        emu_command=emu_rxbuf;
+        emu_mark=emu_total;
+      }
+      emu_total.bytes_in++;
+      emu_last_in=true;
+    }
+    else emu_idle++;
+  }
+
+  if (emu_rx_valid) return UCA0TXIFG|UCA0RXIFG;
+  return UCA0TXIFG;
+}
+
+unsigned char *EmuTXBUF()
+{
+  EmuIFG();
+  emu_tx_pending=true;
+  emu_total.bytes_out++;
+  if (emu_last_in) emu_total.round_trips++;
+  emu_last_in=false;
+  return &emu_txbuf;
+}
+
+unsigned char EmuRXBUF()
+{
+  while (!emu_rx_valid) EmuIFG();
+  emu_rx_valid=false;
+  return emu_rxbuf;
+}
+
+//Each write to UCB0TXBUF shifts a byte into the 595s holding the address
+unsigned char *EmuSPI()
+{
+  if (emu_spi_pending) emu_shift=(emu_shift<<8)|emu_spi;
+  emu_spi_pending=true;
+  return &emu_spi;
+}
+
+//Called before every change to P1OUT, so this sees the pins as the last
+//statement left them. A low latch passes the shifted address through and
+//a low #WE stores P2OUT.
+unsigned char *EmuP1OUT()
+{
+  if (emu_spi_pending)
+  {
+    emu_shift=(emu_shift<<8)|emu_spi;
+    emu_spi_pending=false;
+  }
+  if (!(emu_p1out&ADDRESS_LATCH)) emu_address=emu_shift&0xFFFF;
+  if (!(emu_p1out&RAM_WE)) emu_sram[emu_address]=P2OUT;
+  return &emu_p1out;
+}
+
+unsigned char EmuP2IN()
+{
+  return emu_sram[emu_address];
+}
+
+static void EmuCommandEnd()
+{
+  int i;
+
+  if (emu_command<0) return;
+  if (emu_command<SLAVE_COMMANDS) i=emu_command;
+  else i=SLAVE_COMMANDS;
+  emu_stats[i].calls++;
+  emu_stats[i].bytes_in+=emu_total.bytes_in-emu_mark.bytes_in;
+  emu_stats[i].bytes_out+=emu_total.bytes_out-emu_mark.bytes_out;
+  emu_stats[i].round_trips+=emu_total.round_trips-emu_mark.round_trips;
+  emu_command=-1;
+}
+
+static void EmuExit()
+{
+  int i;
+
+  EmuCommandEnd();
+  fprintf(emu_stats_file,"%-16s %8s %10s %10s %12s\n","command","calls","bytes_in","bytes_out","round_trips");
+  for (i=0;i<=SLAVE_COMMANDS;i++)
+  {
+    if (emu_stats[i].calls==0) continue;
+    fprintf(emu_stats_file,"%-16s %8lu %10lu %10lu %12lu\n",CommandNames[i],emu_stats[i].calls,
+            emu_stats[i].bytes_in,emu_stats[i].bytes_out,emu_stats[i].round_trips);
+  }
+  fprintf(emu_stats_file,"%-16s %8s %10lu %10lu %12lu\n","total","-",emu_total.bytes_in,
+          emu_total.bytes_out,emu_total.round_trips);
+  fflush(emu_stats_file);
+  exit(0);
+}
+
+static void EmuQuit(int sig)
+{
+  (void)sig;
+  emu_quit=1;
+}
+
+//Runs the slave's start up until it first polls the UART, which assigns
+//the MM globals so the session below can use the same addresses
+static void EmuLayout()
+{
+  emu_fd=-1;
+  if (!setjmp(emu_layout)) SlaveMain();
+}
+
+//Host side of the protocol, following the helpers in common.h
+static unsigned char HostReceive(int fd, bool wait)
+{
+  unsigned char data=0;
+  if (read(fd,&data,1)!=1) exit(1);
+  if (!wait)
+  {
+    if (write(fd,"",1)!=1) exit(1);
+  }
+  return data;
+}
+
+static void HostSend(int fd, unsigned char data, bool wait)
+{
+  if (write(fd,&data,1)!=1) exit(1);
+  if (wait) HostReceive(fd,true);
+}
+
+static void HostSendWord(int fd, unsigned int data, bool wait)
+{
+  HostSend(fd,data>>8,true);
+  HostSend(fd,data&0xFF,wait);
+}
+
+#define MM(x) ((unsigned int)(uintptr_t)(x))
+
+static void HostCommand(int fd, unsigned char command, const unsigned char *a0, const unsigned char *a1, const unsigned char *a2)
+{
+  HostSend(fd,command,true);
+  HostSendWord(fd,MM(a0),true);
+  if (a1) HostSendWord(fd,MM(a1),true);
+  if (a2) HostSendWord(fd,MM(a2),true);
+}
+
+static void HostWriteBlock(int fd, const unsigned char *dest, const void *src, unsigned int count)
+{
+  unsigned int i;
+  HostSend(fd,SlaveRAM_WriteBlock,true);
+  HostSendWord(fd,MM(dest),true);
+  HostSendWord(fd,count,true);
+  for (i=0;i<count;i++) HostSend(fd,((const unsigned char *)src)[i],true);
+}
+
+static void HostReadBlock(int fd, unsigned char *dest, const unsigned char *src, unsigned int count)
+{
+  unsigned int i;
+  HostSend(fd,SlaveRAM_ReadBlock,true);
+  HostSendWord(fd,MM(src),true);
+  HostSendWord(fd,count,true);
+  for (i=0;i<count;i++) dest[i]=HostReceive(fd,false);
+}
+
+static void HostRAM_Write(int fd, const unsigned char *dest, unsigned char byte)
+{
+  HostSend(fd,SlaveRAM_Write,true);
+  HostSendWord(fd,MM(dest),true);
+  HostSend(fd,byte,true);
+}
+
+static void HostImmed(int fd, const char *text, unsigned char *dest)
+{
+  HostWriteBlock(fd,perm_buff2,text,strlen(text)+1);
+  HostCommand(fd,SlaveBuffer,perm_buff2,dest,NULL);
+}
+
+//Shrink n1 on the slave and read it back as text
+static void HostText(int fd, char *text, const unsigned char *n1)
+{
+  unsigned char cell[MATH_CELL_SIZE];
+  int i;
+
+  HostSend(fd,SlaveFullShrink,true);
+  HostSendWord(fd,MM(n1),true);
+  HostReadBlock(fd,cell,n1,3);
+  HostReadBlock(fd,cell+3,n1+3,BCD_BYTES(cell[BCD_LEN]));
+  if (cell[BCD_SIGN]) *text++='-';
+  for (i=0;i<cell[BCD_LEN];i++)
+  {
+    if (i==cell[BCD_DEC]) *text++='.';
+    if (i&1) *text++='0'+(cell[(i>>1)+3]&0xF);
+    else *text++='0'+(cell[(i>>1)+3]>>4);
+  }
+  *text=0;
+}
+
+static void HostPrint(int fd, const char *label, const unsigned char *n1)
+{
+  char text[MATH_MAX_DIGITS+3];
+
+  HostText(fd,text,n1);
+  printf("%s %s\n",label,text);
+}
+
+//Set the precision the way SetDecPlaces in rpnmain.c does, finding where the tables
+//run out from log_lead and trig_lead in common.h
+static void HostSettings(int fd, int dec_places)
+{
+  int i,j;
+
+  for (i=0;i<MATH_TRIG_TABLE;i++)
+  {
+    HostRAM_Write(fd,trig+i*MATH_ENTRY_SIZE+BCD_LEN,2+dec_places);
+    if (trig_lead[i]>=2+dec_places) break;
+  }
+  for (j=0;j<MATH_LOG_TABLE;j++)
+  {
+    HostRAM_Write(fd,logs+j*MATH_ENTRY_SIZE+BCD_LEN,2+dec_places);
+    if (log_lead[j]>=2+dec_places) break;
+  }
+  i++;
+  j++;
+
+  #ifdef CORDIC_TAIL
+    if (i/2+CORDIC_TAIL_EXTRA<i) i=i/2+CORDIC_TAIL_EXTRA;
+    if ((j+8)/2+CORDIC_TAIL_EXTRA<j) j=(j+8)/2+CORDIC_TAIL_EXTRA;
+  #endif
+
+  HostRAM_Write(fd,perm_K+BCD_LEN,1+dec_places);
+  HostRAM_Write(fd,perm_log10+BCD_LEN,1+dec_places);
+
+  HostSend(fd,SlaveSettings,true);
+  HostSend(fd,dec_places,true);
+  HostSend(fd,true,true);
+  HostSend(fd,j,true);
+  HostSend(fd,i,true);
+}
+
+//Work out base^exp on the slave. The answer should start with lead and have whole
+//digits before the point, or be too large for the slave to hold if lead is NULL.
+//Returns 1 if it doesn't.
+static int HostCheckPow(int fd, const char *base, const char *exp, const char *lead, int whole)
+{
+  char text[MATH_MAX_DIGITS+3];
+  bool success;
+
+  HostImmed(fd,base,BCD_stack);
+  HostImmed(fd,exp,BCD_stack+MATH_CELL_SIZE);
+  HostCommand(fd,SlavePow,stack_buffer,BCD_stack,BCD_stack+MATH_CELL_SIZE);
+  success=HostReceive(fd,false)!=0;
+  if (success) HostText(fd,text,stack_buffer);
+  else strcpy(text,"too large");
+
+  printf("%s^%s = %.40s%s\n",base,exp,text,(strlen(text)>40)?"...":"");
+  if (lead==NULL)
+  {
+    if (!success) return 0;
+  }
+  else if ((success)&&(!strncmp(text,lead,strlen(lead))))
+  {
+    if ((int)strcspn(text,".")==whole) return 0;
+  }
+  printf("  FAILED\n");
+  return 1;
+}
+
+//Start up as rpnmain.c does it for one bank, then a few keystrokes' worth
+//of work
+static int EmuSession(int fd)
+{
+  int failed=0,dec_places=12;
+
+  //The slave acknowledges the command byte before it answers
+  HostSend(fd,SlaveSync,false);
+  HostReceive(fd,true);
+  if (HostReceive(fd,true)!=SlaveAnswer)
+  {
+    fprintf(stderr,"Sync failed\n");
+    exit(1);
+  }
+  HostSend(fd,0,false);
+
+  HostImmed(fd,"0",perm_zero);
+  HostImmed(fd,K,perm_K);
+  HostImmed(fd,log10_factor,perm_log10);
+  HostImmed(fd,"1",perm_one);
+  HostImmed(fd,"10",perm_ten);
+  HostImmed(fd,"90",perm_90);
+  HostImmed(fd,"180",perm_180);
+  HostImmed(fd,"360",perm_360);
+  HostImmed(fd,deg_factor,perm_deg);
+  HostImmed(fd,two_pi,perm_2pi);
+  HostSend(fd,SlaveMakeTables,true);
+  HostReceive(fd,true);
+
+  HostSettings(fd,dec_places);
+
+  HostWriteBlock(fd,p0,"2",2);
+  HostCommand(fd,SlaveBuffer,p0,BCD_stack,NULL);
+  HostWriteBlock(fd,p0,"3",2);
+  HostCommand(fd,SlaveBuffer,p0,BCD_stack+MATH_CELL_SIZE,NULL);
+
+  HostCommand(fd,SlaveDivide,stack_buffer,BCD_stack,BCD_stack+MATH_CELL_SIZE);
+  HostPrint(fd,"2/3 =",stack_buffer);
+  HostCommand(fd,SlaveMultiply,stack_buffer,BCD_stack,BCD_stack+MATH_CELL_SIZE);
+  HostPrint(fd,"2*3 =",stack_buffer);
+  HostCommand(fd,SlaveSqrt,stack_buffer,BCD_stack,NULL);
+  HostPrint(fd,"sqrt 2 =",stack_buffer);
+  HostCommand(fd,SlaveLn,stack_buffer,BCD_stack,NULL);
+  HostReceive(fd,false);
+  HostPrint(fd,"ln 2 =",stack_buffer);
+
+  //Squaring has room for these at 12 places but not at 32
+  failed+=HostCheckPow(fd,"9.9","225","1042122528298756519873",225);
+  failed+=HostCheckPow(fd,"99.5","112","5704072587541461339760",224);
+  HostSettings(fd,32);
+  failed+=HostCheckPow(fd,"9.9","225",NULL,0);
+  failed+=HostCheckPow(fd,"99.5","112",NULL,0);
+  failed+=HostCheckPow(fd,"2","100","1267650600228229401496703205376",31);
+  //A base with decimal places is squared with guard places
+  HostSettings(fd,8);
+  failed+=HostCheckPow(fd,"1.0000001","1000000","1.10517091",1);
+  fflush(stdout);
+  return failed;
+}
@@ -0,0 +1,392 @@
+/**   RPN Scientific Calculator for MSP430
+ *    Copyright (C) 2014 Joey Shepard
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**/
+
+//Port of MemMap.bas for building the MSP430 sources on Linux
+//Usage: memmap IN_FILE OUT_FILE
+//Rules are the same as the Basic version line for line, so the output
+//should match it apart from CRLF line endings
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdbool.h>
+
+#define LINE_MAX_LEN  4096
+#define VARS_MAX      256
+#define ASSIGN_MAX    16384
+
+static const char charset[]="abcdefghijklmnopqrstuvwxyz_1234567890";
+
+struct variable
+{
+  char name[64];
+  int level;
+};
+
+static bool InCharset(char c);
+static bool Ignore(const char *buff);
+static void StripInput(const char *buff, char *rebuff);
+static void Append(char *dest, const char *src, int len);
+
+int main(int argc, char *argv[])
+{
+  char MM_READ[64]="", MM_WRITE[64]="";
+  bool MM_ON=false, MM_DECLARE=false, MM_GLOBALS=false;
+  int MM_LEVEL=1, MM_COUNT=0;
+  long MM_COUNTER=0;
+  static struct variable MM_VARS[VARS_MAX];
+  static char MM_ASSIGN_LIST[ASSIGN_MAX];
+  bool CommentOn=false, Quote1On=false, Quote2On=false;
+  char CommentBuff[3];
+
+  static char inbuff[LINE_MAX_LEN], newbuff[LINE_MAX_LEN];
+  static char linebuff[LINE_MAX_LEN], linebuff2[LINE_MAX_LEN];
+  static char buff1[LINE_MAX_LEN*2], buff2[LINE_MAX_LEN];
+  char arraybuff[LINE_MAX_LEN];
+  int i,j,k,len,depth;
+  bool foundend;
+  char *ptr;
+  FILE *in,*out;
+
+  if (argc!=3)
+  {
+    fprintf(stderr,"Usage: memmap IN_FILE OUT_FILE\n");
+    return 1;
+  }
+
+  in=fopen(argv[1],"r");
+  if (!in)
+  {
+    fprintf(stderr,"\"%s\" not found.\n",argv[1]);
+    return 1;
+  }
+  out=fopen(argv[2],"w");
+  if (!out)
+  {
+    fprintf(stderr,"Can't write \"%s\".\n",argv[2]);
+    return 1;
+  }
+
+  linebuff[0]=0;
+  while (fgets(inbuff,LINE_MAX_LEN,in))
+  {
+    len=strlen(inbuff);
+    while (len&&((inbuff[len-1]=='\n')||(inbuff[len-1]=='\r'))) inbuff[--len]=0;
+
+    StripInput(inbuff,newbuff);
+
+    if (strncmp(newbuff,"//",2))
+    {
+      //CommentBuff holds the last two characters seen
+      strcpy(CommentBuff," ");
+      len=strlen(newbuff);
+      for (i=0;i<len;i++)
+      {
+        k=strlen(CommentBuff);
+        CommentBuff[k]=newbuff[i];
+        CommentBuff[k+1]=0;
+
+        if (!CommentOn) Append(linebuff,newbuff+i,1);
+
+        if ((!Quote1On)&&(!Quote2On))
+        {
+          if (!CommentOn)
+          {
+            if ((!strcmp(CommentBuff,"/*"))||(!strcmp(CommentBuff,"//")))
+            {
+              linebuff[strlen(linebuff)-2]=0;
+            }
+            if (!strcmp(CommentBuff,"//")) break;
+            if (newbuff[i]=='{') MM_LEVEL++;
+            else if (newbuff[i]=='}')
+            {
+              for (j=0;j<=MM_COUNT;j++)
+              {
+                if (MM_VARS[j].level==MM_LEVEL) MM_VARS[j].level=0;
+              }
+              MM_LEVEL--;
+            }
+            else if (newbuff[i]=='\'') Quote1On=true;
+            else if (newbuff[i]=='"') Quote2On=true;
+
+            if (!strcmp(CommentBuff,"/*"))
+            {
+              CommentBuff[0]=0;
+              CommentOn=true;
+            }
+          }
+          else
+          {
+            if (!strcmp(CommentBuff,"*/")) CommentOn=false;
+          }
+        }
+        else if (Quote1On)
+        {
+          if (newbuff[i]=='\'') Quote1On=false;
+        }
+        else if (Quote2On)
+        {
+          if (newbuff[i]=='"') Quote2On=false;
+        }
+        if (CommentBuff[0])
+        {
+          CommentBuff[0]=newbuff[i];
+          CommentBuff[1]=0;
+        }
+      }
+    }
+    else if ((ptr=strstr(newbuff,"*/")))
+    {
+      strcpy(linebuff,ptr+2);
+      CommentOn=false;
+    }
+
+    if (!Ignore(linebuff))
+    {
+      if (!strncmp(linebuff,"#pragma MM_READ ",16)) strcpy(MM_READ,linebuff+16);
+      else if (!strncmp(linebuff,"#pragma MM_WRITE ",17)) strcpy(MM_WRITE,linebuff+17);
+      else if (!strcmp(linebuff,"#pragma MM_ON")) MM_ON=true;
+      else if (!strcmp(linebuff,"#pragma MM_OFF")) MM_ON=false;
+      else if (!strcmp(linebuff,"#pragma MM_DECLARE")) MM_DECLARE=true;
+      else if (!strcmp(linebuff,"#pragma MM_GLOBALS")) MM_GLOBALS=true;
+      else if (!strcmp(linebuff,"#pragma MM_END"))
+      {
+        MM_DECLARE=false;
+        MM_GLOBALS=false;
+      }
+      else if (!strcmp(linebuff,"#pragma MM_ASSIGN_GLOBALS")) Append(linebuff,MM_ASSIGN_LIST,-1);
+      else if (!strncmp(linebuff,"#pragma MM_VAR ",15))
+      {
+        MM_VARS[MM_COUNT].level=MM_LEVEL;
+        strcpy(MM_VARS[MM_COUNT].name,linebuff+15);
+        MM_COUNT++;
+      }
+      else if (!strncmp(linebuff,"#pragma MM_OFFSET ",18)) MM_COUNTER=atol(linebuff+18);
+      else if (MM_ON==false);
+      else if ((MM_DECLARE||MM_GLOBALS)&&linebuff[0])
+      {
+        strcpy(linebuff2,linebuff);
+        ptr=strrchr(linebuff,' ');
+        k=ptr?(ptr-linebuff+1):0;
+        memcpy(buff1,linebuff,k);
+        buff1[k]=0;
+        ptr=strchr(linebuff,'[');
+        if (ptr)
+        {
+          strcat(buff1,"*");
+          Append(buff1,linebuff+k,ptr-linebuff-k);
+          sprintf(buff1+strlen(buff1),"=(unsigned char*)%ld;",MM_COUNTER);
+          strcpy(buff2,ptr+1);
+          MM_COUNTER+=atol(buff2);
+          Append(MM_VARS[MM_COUNT].name,linebuff+k,ptr-linebuff-k);
+        }
+        else
+        {
+          strcat(buff1,"*");
+          Append(buff1,linebuff+k,strlen(linebuff)-k-1);
+          sprintf(buff1+strlen(buff1),"=(unsigned char*)%ld;",MM_COUNTER);
+          MM_COUNTER++;
+          Append(MM_VARS[MM_COUNT].name,linebuff+k,strlen(linebuff)-k-1);
+        }
+        MM_VARS[MM_COUNT].level=MM_LEVEL;
+        MM_COUNT++;
+
+        strcpy(linebuff,buff1);
+
+        if (MM_GLOBALS)
+        {
+          strcat(MM_ASSIGN_LIST,"\n");
+          strcat(MM_ASSIGN_LIST,strchr(linebuff,'*')+1);
+          ptr=strchr(linebuff2,'[');
+          if (ptr) *ptr=0;
+          ptr=strrchr(linebuff2,' ');
+          k=ptr?(ptr-linebuff2+1):0;
+          memcpy(linebuff,linebuff2,k);
+          linebuff[k]=0;
+          strcat(linebuff,"*");
+          strcat(linebuff,linebuff2+k);
+          strcat(linebuff,";");
+        }
+      }
+      else
+      {
+        //Rewrite every access to an MM variable, rescanning until none are left
+        arraybuff[0]=0;
+        do
+        {
+          foundend=true;
+          len=strlen(linebuff);
+          for (i=0;i<len;i++)
+          {
+            if (i>=(int)strlen(linebuff)) continue;
+            if (InCharset(linebuff[i])) Append(arraybuff,linebuff+i,1);
+            else if (linebuff[i]=='[')
+            {
+              for (j=0;j<MM_COUNT;j++)
+              {
+                if ((MM_VARS[j].level!=0)&&(!strcmp(MM_VARS[j].name,arraybuff)))
+                {
+                  depth=0;
+                  buff1[0]=0;
+                  for (k=i+1;linebuff[k];k++)
+                  {
+                    if (linebuff[k]=='[') depth++;
+                    else if (linebuff[k]==']')
+                    {
+                      if (depth==0)
+                      {
+                        int start=i-strlen(arraybuff);
+                        buff1[0]=0;
+                        Append(buff1,linebuff,start);
+                        if ((linebuff[k+1]=='=')&&(linebuff[k+2]!='='))
+                        {
+                          strcat(buff1,MM_WRITE);
+                          strcat(buff1,"(");
+                          strcat(buff1,arraybuff);
+                          strcat(buff1,"+");
+                          Append(buff1,linebuff+i+1,k-i-1);
+                          strcat(buff1,",");
+                          strcat(buff1,linebuff+k+2);
+                          buff1[strlen(buff1)-1]=0;
+                          strcat(buff1,");");
+                        }
+                        else if ((linebuff[k+1])&&(strchr("+-*/%&|^",linebuff[k+1]))&&(linebuff[k+2]=='='))
+                        {
+                          strcat(buff1,MM_WRITE);
+                          strcat(buff1,"(");
+                          strcat(buff1,arraybuff);
+                          strcat(buff1,"+");
+                          Append(buff1,linebuff+i+1,k-i-1);
+                          strcat(buff1,",");
+                          strcat(buff1,MM_READ);
+                          strcat(buff1,"(");
+                          strcat(buff1,arraybuff);
+                          strcat(buff1,"+");
+                          Append(buff1,linebuff+i+1,k-i-1);
+                          strcat(buff1,")");
+                          Append(buff1,linebuff+k+1,1);
+                          strcat(buff1,"(");
+                          strcat(buff1,linebuff+k+3);
+                          buff1[strlen(buff1)-1]=0;
+                          strcat(buff1,"));");
+                        }
+                        else
+                        {
+                          strcat(buff1,MM_READ);
+                          strcat(buff1,"(");
+                          strcat(buff1,arraybuff);
+                          strcat(buff1,"+");
+                          Append(buff1,linebuff+i+1,k-i-1);
+                          strcat(buff1,")");
+                          strcat(buff1,linebuff+k+1);
+                        }
+                        break;
+                      }
+                      depth--;
+                    }
+                  }
+                  if (buff1[0])
+                  {
+                    strcpy(linebuff,buff1);
+                    foundend=false;
+                  }
+                  break;
+                }
+              }
+              arraybuff[0]=0;
+            }
+            else arraybuff[0]=0;
+          }
+        } while (foundend==false);
+      }
+    }
+    fprintf(out,"%s\n",linebuff);
+    linebuff[0]=0;
+  }
+  fprintf(out,"\n");
+  fclose(in);
+  fclose(out);
+  return 0;
+}
+
+static bool InCharset(char c)
+{
+  return strchr(charset,tolower((unsigned char)c))!=NULL&&c!=0;
+}
+
+static bool Ignore(const char *buff)
+{
+  if (!strncmp(buff,"//",2)) return true;
+  if (!strncmp(buff,"#include ",9)) return true;
+  if (!strncmp(buff,"#define ",8)) return true;
+  return false;
+}
+
+//Collapses whitespace outside of quotes, keeping one space between words
+static void StripInput(const char *buff, char *rebuff)
+{
+  bool quote1=false, quote2=false, space=false;
+  char lastadded=' ';
+  int i,len=0;
+  const char *hash;
+
+  hash=strchr(buff,'#');
+  if (hash&&(strstr(buff,"#define")==hash))
+  {
+    strcpy(rebuff,buff);
+    return;
+  }
+
+  for (i=0;buff[i];i++)
+  {
+    if ((!quote1)&&(!quote2))
+    {
+      if (buff[i]=='"') quote1=true;
+      else if (buff[i]=='\'') quote2=true;
+    }
+    else if (quote1&&(buff[i]=='"')) quote1=false;
+    else if (quote2&&(buff[i]=='\'')) quote2=false;
+
+    if (quote1||quote2)
+    {
+      rebuff[len++]=buff[i];
+      lastadded=buff[i];
+    }
+    else
+    {
+      if (buff[i]!=' ')
+      {
+        if (InCharset(lastadded)&&InCharset(buff[i])&&space) rebuff[len++]=' ';
+        rebuff[len++]=buff[i];
+        lastadded=buff[i];
+        space=false;
+      }
+      else space=true;
+    }
+  }
+  if (len&&(rebuff[len-1]==' ')) len--;
+  rebuff[len]=0;
+}
+
+static void Append(char *dest, const char *src, int len)
+{
+  int dest_len=strlen(dest);
+  if (len<0) len=strlen(src);
+  memcpy(dest+dest_len,src,len);
+  dest[dest_len+len]=0;
+}